@@ -42,6 +42,13 @@
 
 #include <QtCore>
 #include <QtConcurrentRun>
+#include <QCryptographicHash>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 /*
  * Getting the libarchive headers for the
@@ -52,10 +59,27 @@ extern "C" {
 #include <sys/stat.h>
 #include <archive.h>
 #include <archive_entry.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 }
+#if defined(Q_OS_UNIX)
+#include <fnmatch.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+ * io_uring is optional , define QARCHIVE_USE_IO_URING and link
+ * liburing (>= 2.2) to get the IO_URING_WRITE flag.
+*/
+#if defined(QARCHIVE_USE_IO_URING) && !defined(Q_OS_LINUX)
+#undef QARCHIVE_USE_IO_URING
+#endif
+#if defined(QARCHIVE_USE_IO_URING)
+#include <liburing.h>
+#endif
 
 namespace QArchive   // QArchive Namespace Start
 {
@@ -72,232 +96,1548 @@ enum {
     INVALID_DEST_PATH,
     DISK_OPEN_ERROR,
     DISK_READ_ERROR,
-    FILE_NOT_EXIST
+    FILE_NOT_EXIST,
+    ARCHIVE_PATH_CONFLICT
 };
 
-
 /*
- * Class Extractor <- Inherits QObject.
- * ---------------
- *
- *  Takes care of extraction of archives with the help
- *  of libarchive.
+ * QArchive write flags for the Extractor
+ * --------------------------------------
  *
- *  Constructors:
- *  	Extractor(QObject *parent = NULL)
+ *  PREALLOCATE_WRITE     - Large files are allocated in one go before they are written ,
+ *			    not with SPARSE_WRITE since that would fill the holes.
+ *  SPARSE_WRITE          - Blocks of zeros are not written , they stay holes.
+ *  SKIP_METADATA_WRITE   - Only the file mode is restored , no times.
+ *  BATCH_DIRECTORY_WRITE - Every directory is created once per archive , from a cache ,
+ *			    instead of beign probed for every file in it.
+ *  SYNC_WRITE            - A single syncfs() on the destination when all archives are done.
+ *  IO_URING_WRITE        - Small files are written in batches through io_uring , only with
+ *			    QARCHIVE_USE_IO_URING. Without io_uring in the kernel it is ignored.
+ *  UNLINK_WRITE          - A existing file is unlinked and created again , never written in
+ *			    place. Needed when the destination holds hard links into another tree.
  *
- *  	Extractor(const QString&) 	- Simply extract a single archive , any format
- *  			      	  , Most likely will be used for 7zip.
- *  	Extractor(const QStringList&)	- Extract all archives from the QStringList in
- *  				  order.
+ *  Everything but SYNC_WRITE makes regular files go through QArchive's own writer
+ *  instead of archive_write_disk. Only Unix has it , elsewhere the flags are ignored.
+*/
+enum {
+    DEFAULT_WRITE = 0,
+    PREALLOCATE_WRITE = 1,
+    SPARSE_WRITE = 2,
+    SKIP_METADATA_WRITE = 4,
+    BATCH_DIRECTORY_WRITE = 8,
+    SYNC_WRITE = 16,
+    FAST_WRITE = 31,
+    IO_URING_WRITE = 32,
+    UNLINK_WRITE = 64
+};
+
+/*
+ * Structure ManifestEntry
+ * -----------------------
+ *  A regular file written by the Extractor , see Extractor::setCollectManifest().
+ *  The path is relative to the destination , mtime is in nanoseconds since the
+ *  epoch (0 if not known) and digest is the raw SHA1 of the content.
+*/
+struct ManifestEntry {
+    QString path;
+    qint64 size = 0;
+    qint64 mtime = 0;
+    QByteArray digest;
+};
+
+/*
+ * Structure ArchiveIndexEntry
+ * ---------------------------
+ *  A entry of the table of contents built by the Reader. type is the file type
+ *  (AE_IFREG , AE_IFDIR , ...) and offset is where the entry starts in the archive
+ *  file for zip and uncompressed tar , -1 for everything else.
+*/
+struct ArchiveIndexEntry {
+    QString path;
+    qint64 size = 0;
+    int type = 0;
+    qint64 offset = -1;
+};
+
+/*
+ * Metrics of the Extractor
+ * ------------------------
  *
- *  Methods:
- *	void addArchive(const QString&)     - Add a archive to the queue.
- *	void addArchive(const QStringList&) - Add a set of archives to the queue
- *	void removeArchive(const QString&)  - Removes a archive from the queue matching
- *					the QString.
+ *  EXTRACTED_FILES_METRIC - Regular files taken out of a archive , unchanged ones included.
+ *  EXTRACTED_BYTES_METRIC - Their bytes.
+ *  UNCHANGED_BYTES_METRIC - Bytes of files with the same content , not written again.
+ *  EXTRACT_PHASE_METRIC   - The time a archive took.
+*/
+enum MetricCounter {
+    EXTRACTED_FILES_METRIC,
+    EXTRACTED_BYTES_METRIC,
+    UNCHANGED_BYTES_METRIC
+};
+
+enum MetricPhase {
+    EXTRACT_PHASE_METRIC
+};
+
+/*
+ * Structure Instrumentation
+ * -------------------------
+ *  Hooks the Extractor reports the span and the metrics of every archive to ,
+ *  QArchive itself only needs QtCore. QInstallerBridge points them at
+ *  QInstallerBridgeTrace and QInstallerBridgeMetrics. Without hooks a report
+ *  costs one atomic load.
  *
- *  Slots:
- *	void start(void)	      - starts the extractor.
- *	void stop(void)		      - stops the extractor.
- *  Signals:
- *	void finished()		        - emitted when all extraction job is done.
- *	void extracting(const QString&) - emitted with the filename beign extracted.
- *	void extracted(const QString&)  - emitted with the filename that has been extracted.
- *	void status(const QString& , const QString&) - emitted with the entry and the filename on extraction.
- *	void error(short , const QString&) - emitted when something goes wrong!
+ *	qint64 traceBegin()			- Begins a span , 0 if it is not recorded.
+ *	void traceEnd(const char *phase ,
+ *		      const QString &subject ,
+ *		      qint64 begin , qint64 bytes) - Ends a span , only called for a begin
+ *						  other than 0.
+ *	qint64 metricNow()			- Begins a timed phase , 0 if it is not timed.
+ *	void metricAdd(MetricCounter , qint64)	- Adds to a counter.
+ *	void metricObserve(MetricPhase ,
+ *			   qint64 begin)	- The time since metricNow() , only called for a
+ *						  begin other than 0.
  *
+ *  Functions:
+ *	void setInstrumentation(const Instrumentation*) - Sets the hooks for the process , NULL
+ *						  for none. They have to outlive every Extractor.
 */
-class Extractor  : public QObject
+struct Instrumentation {
+    qint64 (*traceBegin)();
+    void (*traceEnd)(const char *phase, const QString& subject, qint64 begin, qint64 bytes);
+    qint64 (*metricNow)();
+    void (*metricAdd)(MetricCounter counter, qint64 value);
+    void (*metricObserve)(MetricPhase phase, qint64 begin);
+};
+
+inline std::atomic<const Instrumentation*> &instrumentation()
 {
-    Q_OBJECT
+    static std::atomic<const Instrumentation*> Hooks(nullptr);
+    return Hooks;
+}
+
+inline void setInstrumentation(const Instrumentation *hooks)
+{
+    instrumentation().store(hooks, std::memory_order_release);
+    return;
+}
+
+inline qint64 traceBegin()
+{
+    const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+    return (Hooks != NULL && Hooks->traceBegin != NULL) ? Hooks->traceBegin() : 0;
+}
+
+inline void traceEnd(const char *phase, const QString& subject, qint64 begin, qint64 bytes)
+{
+    const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+    if(begin != 0 && Hooks != NULL && Hooks->traceEnd != NULL) {
+        Hooks->traceEnd(phase, subject, begin, bytes);
+    }
+    return;
+}
 
+inline qint64 metricNow()
+{
+    const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+    return (Hooks != NULL && Hooks->metricNow != NULL) ? Hooks->metricNow() : 0;
+}
+
+inline void metricAdd(MetricCounter counter, qint64 value)
+{
+    const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+    if(Hooks != NULL && Hooks->metricAdd != NULL) {
+        Hooks->metricAdd(counter, value);
+    }
+    return;
+}
+
+inline void metricObserve(MetricPhase phase, qint64 begin)
+{
+    const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+    if(begin != 0 && Hooks != NULL && Hooks->metricObserve != NULL) {
+        Hooks->metricObserve(phase, begin);
+    }
+    return;
+}
+
+/*
+ * Class EntryFilter
+ * -----------------
+ *
+ *  Decides which entries of a archive are extracted , see Extractor::setEntryFilter().
+ *  Paths are matched as they are in the archive , without a leading "./" or "/".
+ *  A entry is kept if it matches a include (or there are none) , matches no
+ *  exclude and the predicate (if any) returns true. Globs are shell like , a
+ *  '*' also matches '/'.
+ *
+ *  Methods:
+ *	void include(const QString&)	     - Adds a include glob , like "lib*" or "*.so".
+ *	void exclude(const QString&)	     - Adds a exclude glob , like "*.debug".
+ *	void includePrefix(const QString&)  - Adds a include prefix , like "share/doc/".
+ *	void excludePrefix(const QString&)  - Adds a exclude prefix , like "share/locale/".
+ *	void setPredicate(std::function<bool(const char*)>) - Called with the UTF-8 path of every
+ *					       entry the lists did not drop , from the extracting thread.
+ *	bool isEmpty()			     - True if everything is kept.
+ *	bool accepts(const char*)	     - True if the entry with the path is kept.
+*/
+class EntryFilter
+{
 public:
-    explicit Extractor(QObject *parent = NULL)
-        : QObject(parent)
+    void include(const QString& glob)
     {
+        includeGlobs.push_back(glob.toUtf8().toStdString());
         return;
     }
 
-    explicit Extractor(const QString& filename)
-        : QObject(NULL)
+    void exclude(const QString& glob)
     {
-        addArchive(filename);
+        excludeGlobs.push_back(glob.toUtf8().toStdString());
         return;
     }
 
-    explicit Extractor(const QStringList& filenames)
-        : QObject(NULL)
+    void includePrefix(const QString& prefix)
     {
-        addArchive(filenames);
+        includePrefixes.push_back(prefix.toUtf8().toStdString());
         return;
     }
 
-    explicit Extractor(const QString& filename, const QString& destination)
-        : QObject(NULL), dest(cleanDestPath(destination))
+    void excludePrefix(const QString& prefix)
     {
-        addArchive(filename);
+        excludePrefixes.push_back(prefix.toUtf8().toStdString());
         return;
     }
 
-    explicit Extractor(const QStringList& filenames, const QString& destination)
-        : QObject(NULL), dest(cleanDestPath(destination))
+    void setPredicate(std::function<bool(const char*)> function)
     {
-        addArchive(filenames);
+        predicate = function;
         return;
     }
 
-    void addArchive(const QString& filename)
+    bool isEmpty() const
     {
-        if(mutex.tryLock()) {
-            queue << filename;
-            queue.removeDuplicates();
-            mutex.unlock();
+        return (includeGlobs.empty() && excludeGlobs.empty() &&
+                includePrefixes.empty() && excludePrefixes.empty() && !predicate);
+    }
+
+    bool accepts(const char *path) const
+    {
+        while(path[0] == '/' || (path[0] == '.' && path[1] == '/')) {
+            path += (path[0] == '/') ? 1 : 2;
         }
-        return;
+
+        if((!includeGlobs.empty() || !includePrefixes.empty()) &&
+           !matchesGlob(includeGlobs, path) && !matchesPrefix(includePrefixes, path)) {
+            return false;
+        }
+        if(matchesGlob(excludeGlobs, path) || matchesPrefix(excludePrefixes, path)) {
+            return false;
+        }
+        return (!predicate || predicate(path));
     }
 
-    void addArchive(const QStringList& filenames)
+private:
+    static bool matchesGlob(const std::vector<std::string>& globs, const char *path)
     {
+        for(size_t glob = 0; glob < globs.size() ; ++glob) {
+#if defined(Q_OS_UNIX)
+            if(fnmatch(globs[glob].c_str(), path, 0) == 0) {
+                return true;
+            }
+#else
+            QRegExp Glob(QString::fromStdString(globs[glob]), Qt::CaseSensitive, QRegExp::Wildcard);
+            if(Glob.exactMatch(QString::fromUtf8(path))) {
+                return true;
+            }
+#endif
+        }
+        return false;
+    }
 
-        /*
-         * No need to extract the same archive twice!
-        */
-        if(mutex.tryLock()) {
-            queue << filenames;
-            queue.removeDuplicates();
-            mutex.unlock();
+    static bool matchesPrefix(const std::vector<std::string>& prefixes, const char *path)
+    {
+        for(size_t prefix = 0; prefix < prefixes.size() ; ++prefix) {
+            if(!strncmp(path, prefixes[prefix].c_str(), prefixes[prefix].size())) {
+                return true;
+            }
         }
+        return false;
+    }
+
+    std::vector<std::string> includeGlobs,
+        excludeGlobs,
+        includePrefixes,
+        excludePrefixes;
+    std::function<bool(const char*)> predicate;
+}; // EntryFilter Class Ends
+
+/*
+ * Class EntryDigest
+ * -----------------
+ *  SHA1 of a entry as its blocks pass by. Holes between the blocks
+ *  of a sparse entry are hashed as the zeros they are on the disk.
+*/
+class EntryDigest
+{
+public:
+    EntryDigest()
+        : hash(QCryptographicHash::Sha1)
+    {
         return;
     }
 
-    void removeArchive(const QString& filename)
+    void reset()
     {
-        if(mutex.tryLock()) {
-            queue.removeAll(filename);
-            mutex.unlock();
-        }
+        hash.reset();
+        hashed = 0;
+        known.clear();
         return;
     }
 
-    void setDestination(const QString& destination)
+    void add(const void *data, size_t length, qint64 offset)
     {
-        if(mutex.tryLock()) {
-            dest = cleanDestPath(destination);
-            mutex.unlock();
-        }
+        pad(offset);
+        hash.addData(static_cast<const char*>(data), length);
+        hashed = offset + length;
         return;
     }
 
-    ~Extractor()
+    // When the caller hashed the whole content already.
+    void setResult(const QByteArray& digest)
     {
-        if(Promise != nullptr) {
-            stop();
-        }
+        known = digest;
         return;
     }
 
-public slots:
-    bool isRunning() const
+    QByteArray result(qint64 size)
     {
-        return Promise->isRunning();
+        if(!known.isEmpty()) {
+            return known;
+        }
+        pad(size);
+        return hash.result();
     }
 
-    void start(void)
+private:
+    void pad(qint64 offset)
     {
-        if(!mutex.tryLock()) {
-            return;
+        static const QByteArray Zeros(65536, '\0');
+        while(hashed < offset) {
+            int length = qMin<qint64>(Zeros.size(), offset - hashed);
+            hash.addData(Zeros.constData(), length);
+            hashed += length;
         }
-        Promise = new QFuture<void>;
-        *Promise = QtConcurrent::run(this, &Extractor::startExtraction);
         return;
     }
 
-    void stop(void)
-    {
-        /*
-         * If mutex is not locked then that means
-         * there is no start called or the operation is
-         * finished , so doing stop is useless.
-         */
-        if(mutex.tryLock() && !Promise->isRunning()) {
-            mutex.unlock();
-            return;
+    QCryptographicHash hash;
+    QByteArray known;
+    qint64 hashed = 0;
+}; // EntryDigest Class Ends
+
+/*
+ * Opens a archive from the disk for reading.
+ * ------------------------------------------
+ *
+ *  The file is memory mapped when possible , so libarchive reads straight
+ *  from the page cache without a read() per block. Otherwise the file is
+ *  read in blocks of the given size. The mapping lives as long as the QFile.
+*/
+inline int openArchiveFile(struct archive *arch, QFile *file, int blockSize, bool useMapping)
+{
+    if(useMapping && file->open(QIODevice::ReadOnly) && file->size() > 0) {
+        uchar *mapped = file->map(0, file->size());
+        if(mapped != NULL) {
+#if defined(Q_OS_UNIX)
+            madvise(mapped, file->size(), MADV_SEQUENTIAL);
+#endif
+            return archive_read_open_memory(arch, mapped, file->size());
         }
-        stopExtraction = true;
+    }
+    return archive_read_open_filename(arch, QFile::encodeName(file->fileName()).constData(), blockSize);
+}
+
+/*
+ * Reads a archive file from where it was seeked to , so libarchive
+ * starts right at a entry. See Reader::extractEntries().
+*/
+struct ArchiveWindow {
+    QFile *file;
+    QByteArray buffer;
+};
+
+inline la_ssize_t readArchiveWindow(struct archive *arch, void *client, const void **buffer)
+{
+    (void)arch;
+    ArchiveWindow *Window = static_cast<ArchiveWindow*>(client);
+    qint64 got = Window->file->read(Window->buffer.data(), Window->buffer.size());
+    *buffer = Window->buffer.constData();
+    return (got < 0) ? ARCHIVE_FATAL : got;
+}
+
+/*
+ * Class ArchiveStream <- Inherits QIODevice.
+ * -------------------
+ *
+ *  A bounded pipe which lets a archive be extracted while it is still beign
+ *  written , like straight from the network. The producer writes with
+ *  QIODevice::write() and calls close() at the end , the Extractor reads it
+ *  from its own thread. write() blocks while the pipe is full , until the
+ *  Extractor catches up , so never write from the GUI thread.
+ *  The SHA1 of everything written is computed on the way.
+ *
+ *  Only formats that can be read front to back can be streamed , (i.e) tar
+ *  and cpio with any filter. 7z needs to seek and cannot be streamed.
+ *
+ *  Methods:
+ *	void setCapacity(qint64)   - Sets how many bytes can wait in the pipe , default is 8 MiB.
+ *	void abort()		   - Makes the reader fail , used when the producer fails.
+ *	QByteArray digest()	   - SHA1 of everything written , use after close().
+ *	qint64 takeBlock(const void**) - Used by the Extractor , waits for the next block.
+ *				     Returns 0 at the end and -1 when aborted.
+ *	void closeReader()	   - Used by the Extractor when it is done , further writes
+ *				     are only hashed.
+ *
+ *  Signals:
+ *	void readyRead()	   - Emitted once , on the first write.
+ *
+ *  The objectName() is used as the archive name in the signals of the Extractor.
+*/
+class ArchiveStream : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit ArchiveStream(QObject *parent = NULL)
+        : QIODevice(parent),
+          hash(QCryptographicHash::Sha1)
+    {
+        QIODevice::open(QIODevice::WriteOnly | QIODevice::Unbuffered);
         return;
     }
 
-signals:
-    void stopped();
-    void finished();
-    void extracted(const QString&);
-    void extracting(const QString&);
-    void status(const QString&, const QString&);
-    void error(short, const QString&);
+    bool isSequential() const
+    {
+        return true;
+    }
 
-private slots:
-    QString cleanDestPath(const QString& input)
+    void setCapacity(qint64 bytes)
     {
-        QString ret = QDir::cleanPath(QDir::toNativeSeparators(input));
-        if(ret.at(ret.count() - 1) != QDir::separator()) {
-            ret += QDir::separator();
-        }
-        return ret;
+        QMutexLocker locker(&pipeMutex);
+        capacity = (bytes < 1) ? 1 : bytes;
+        return;
     }
 
-    int extract(const char* filename, const char* dest)
+    void close()
     {
+        pipeMutex.lock();
+        ended = true;
+        canRead.wakeAll();
+        pipeMutex.unlock();
+        QIODevice::close();
+        return;
+    }
 
-        struct archive *arch,*ext;
-        struct archive_entry *entry;
-        int ret = 0;
+    void abort()
+    {
+        QMutexLocker locker(&pipeMutex);
+        aborted = true;
+        canRead.wakeAll();
+        canWrite.wakeAll();
+        return;
+    }
 
-        arch = archive_read_new();
-        ext = archive_write_disk_new();
-        archive_write_disk_set_options(ext, ARCHIVE_EXTRACT_TIME);
-        archive_read_support_format_all(arch);
-        archive_read_support_filter_all(arch);
+    QByteArray digest()
+    {
+        return hash.result();
+    }
 
-        if((ret = archive_read_open_filename(arch, filename, 10240))) {
-            return ARCHIVE_READ_ERROR;
+    qint64 takeBlock(const void **block)
+    {
+        QMutexLocker locker(&pipeMutex);
+        while(blocks.isEmpty() && !ended && !aborted) {
+            canRead.wait(&pipeMutex);
+        }
+        if(aborted) {
+            return -1;
+        }
+        if(blocks.isEmpty()) {
+            return 0;
         }
-        for (; !stopExtraction;) {
-            ret = archive_read_next_header(arch, &entry);
-            if (ret == ARCHIVE_EOF) {
-                break;
-            }
-            if (ret != ARCHIVE_OK) {
-                return ARCHIVE_QUALITY_ERROR;
-            }
 
-            if(dest != NULL) {
-                char* new_entry = concat( dest, archive_entry_pathname(entry));
-                archive_entry_set_pathname(entry, new_entry);
-                emit status(QString(filename), QString(new_entry));
-                free(new_entry);
-            } else {
-                emit status(QString(filename), QString(archive_entry_pathname(entry)));
-            }
+        // Kept until the next call , libarchive reads from it till then.
+        readerBlock = blocks.dequeue();
+        buffered -= readerBlock.size();
+        canWrite.wakeAll();
+        *block = readerBlock.constData();
+        return readerBlock.size();
+    }
 
-            ret = archive_write_header(ext, entry);
-            if (ret == ARCHIVE_OK) {
-                copy_data(arch, ext);
-                ret = archive_write_finish_entry(ext);
-                if (ret != ARCHIVE_OK) {
-                    return ARCHIVE_UNCAUGHT_ERROR;
-                }
-            }
+    void closeReader()
+    {
+        QMutexLocker locker(&pipeMutex);
+        readerClosed = true;
+        blocks.clear();
+        buffered = 0;
+        canWrite.wakeAll();
+        return;
+    }
 
-        }
-        archive_read_close(arch);
-        archive_read_free(arch);
-        archive_write_close(ext);
-        archive_write_free(ext);
-        return NO_ARCHIVE_ERROR;
+protected:
+    qint64 readData(char *data, qint64 maxSize)
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1; // Only the Extractor reads , through takeBlock().
     }
 
-    int copy_data(struct archive *arch, struct archive *ext)
+    qint64 writeData(const char *data, qint64 size)
+    {
+        hash.addData(data, size);
+
+        pipeMutex.lock();
+        while(buffered >= capacity && !aborted && !readerClosed) {
+            canWrite.wait(&pipeMutex);
+        }
+        if(aborted) {
+            pipeMutex.unlock();
+            return -1;
+        }
+        if(!readerClosed) {
+            blocks.enqueue(QByteArray(data, size));
+            buffered += size;
+            canRead.wakeAll();
+        }
+        bool first = !written;
+        written = true;
+        pipeMutex.unlock();
+
+        if(first) {
+            emit readyRead();
+        }
+        return size;
+    }
+
+private:
+    QMutex pipeMutex;
+    QWaitCondition canRead,
+                   canWrite;
+    QQueue<QByteArray> blocks;
+    QByteArray readerBlock;
+    QCryptographicHash hash;
+    qint64 buffered = 0,
+           capacity = 8388608; // 8 MiB
+    bool ended = false,
+         aborted = false,
+         readerClosed = false,
+         written = false;
+}; // ArchiveStream Class Ends
+
+inline la_ssize_t readArchiveStream(struct archive *arch, void *client, const void **buffer)
+{
+    la_ssize_t size = static_cast<ArchiveStream*>(client)->takeBlock(buffer);
+    if(size < 0) {
+        archive_set_error(arch, EIO, "The archive stream was aborted");
+    }
+    return size;
+}
+
+inline int openArchiveStream(struct archive *arch, ArchiveStream *stream)
+{
+    return archive_read_open(arch, stream, NULL, readArchiveStream, NULL);
+}
+
+#if defined(QARCHIVE_USE_IO_URING)
+/*
+ * Class UringWriter
+ * -----------------
+ *
+ *  Writes whole small files through io_uring. Every file is a linked openat ,
+ *  write and close on a direct descriptor , so a batch of files costs one
+ *  io_uring_enter() instead of three syscalls per file , while the caller
+ *  goes on decompressing the next entries.
+ *  A file whose chain fails , like a old symlink in the way , is written
+ *  again with plain syscalls. isValid() is false if the kernel has no
+ *  io_uring or no direct descriptors , the Extractor then uses its other writers.
+ *
+ *  Methods:
+ *	bool isValid()			  - True if io_uring can be used.
+ *	bool write(const QByteArray& path ,
+ *		   const QByteArray& data ,
+ *		   mode_t , const timespec*) - Queues a file , the times may be NULL.
+ *	bool drain()			  - Waits for every queued file.
+ *	bool isQueued(const char*)	  - True if the path is queued and not written yet.
+ *
+ *  write() and drain() return false if a file could not be written at all.
+*/
+class UringWriter
+{
+public:
+    explicit UringWriter(unsigned files = 64)
+        : fileSlots(files)
+    {
+        if(files == 0 || io_uring_queue_init(files * 3, &ring, 0) != 0) {
+            return;
+        }
+        if(io_uring_register_files_sparse(&ring, files) != 0) {
+            io_uring_queue_exit(&ring);
+            return;
+        }
+        for(unsigned slot = 0; slot < files ; ++slot) {
+            freeSlots.push_back(slot);
+        }
+        valid = true;
+        return;
+    }
+
+    ~UringWriter()
+    {
+        if(valid) {
+            drain();
+            io_uring_queue_exit(&ring);
+        }
+        return;
+    }
+
+    bool isValid() const
+    {
+        return valid;
+    }
+
+    bool write(const QByteArray& path, const QByteArray& data, mode_t mode, const struct timespec *times)
+    {
+        while(freeSlots.isEmpty()) {
+            reap(true);
+        }
+
+        unsigned slot = freeSlots.takeLast();
+        Slot &File = fileSlots[slot];
+        File.path = path;
+        queuedPaths.insert(path);
+        File.data = data;
+        File.mode = mode;
+        File.pending = 3;
+        File.failed = false;
+        File.setTimes = (times != NULL);
+        if(times != NULL) {
+            File.times[0] = times[0];
+            File.times[1] = times[1];
+        }
+
+        // The ring has room for three entries of every slot.
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_openat_direct(sqe, AT_FDCWD, File.path.constData(),
+                                    O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, mode, slot);
+        io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+        io_uring_sqe_set_data64(sqe, slot);
+
+        sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_write(sqe, slot, File.data.constData(), File.data.size(), 0);
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE | IOSQE_IO_LINK);
+        io_uring_sqe_set_data64(sqe, slot | WriteTag);
+
+        sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_close_direct(sqe, slot);
+        io_uring_sqe_set_data64(sqe, slot);
+
+        if(++unsubmitted >= SubmitBatch) {
+            io_uring_submit(&ring);
+            unsubmitted = 0;
+        }
+        reap(false);
+        return ok;
+    }
+
+    bool drain()
+    {
+        while(valid && freeSlots.size() < fileSlots.size()) {
+            reap(true);
+        }
+        return ok;
+    }
+
+    bool isQueued(const char *path) const
+    {
+        return (valid && !queuedPaths.isEmpty() && queuedPaths.contains(QByteArray::fromRawData(path, strlen(path))));
+    }
+
+private:
+    struct Slot {
+        QByteArray path,
+                   data;
+        mode_t mode = 0;
+        int pending = 0;
+        bool failed = false,
+             setTimes = false;
+        struct timespec times[2];
+    };
+
+    void reap(bool wait)
+    {
+        struct io_uring_cqe *cqe;
+        if(wait) {
+            io_uring_submit_and_wait(&ring, 1);
+            unsubmitted = 0;
+        }
+
+        while(io_uring_peek_cqe(&ring, &cqe) == 0) {
+            quint64 data = io_uring_cqe_get_data64(cqe);
+            unsigned slot = data & ~WriteTag;
+            Slot &File = fileSlots[slot];
+            if(cqe->res < 0 || ((data & WriteTag) && cqe->res != File.data.size())) {
+                File.failed = true;
+            }
+            io_uring_cqe_seen(&ring, cqe);
+            if(--File.pending == 0) {
+                finish(slot);
+            }
+        }
+        return;
+    }
+
+    void finish(unsigned slot)
+    {
+        Slot &File = fileSlots[slot];
+        if(File.failed) {
+            if(!writeDirect(File)) {
+                ok = false;
+            }
+        } else {
+            // The open has no descriptor to fchmod() , the path is no symlink.
+            fchmodat(AT_FDCWD, File.path.constData(), File.mode, 0);
+        }
+        if(File.setTimes) {
+            utimensat(AT_FDCWD, File.path.constData(), File.times, AT_SYMLINK_NOFOLLOW);
+        }
+        queuedPaths.remove(File.path);
+        File.path.clear();
+        File.data.clear();
+        freeSlots.push_back(slot);
+        return;
+    }
+
+    bool writeDirect(const Slot &File)
+    {
+        unlink(File.path.constData());
+        int fd = open(File.path.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, File.mode);
+        if(fd < 0) {
+            return false;
+        }
+        fchmod(fd, File.mode);
+        const char *data = File.data.constData();
+        qint64 left = File.data.size();
+        while(left > 0) {
+            ssize_t written = ::write(fd, data, left);
+            if(written < 0 && errno == EINTR) {
+                continue;
+            }
+            if(written < 0) {
+                close(fd);
+                return false;
+            }
+            data += written;
+            left -= written;
+        }
+        return (close(fd) == 0);
+    }
+
+    static const quint64 WriteTag = Q_UINT64_C(1) << 32;
+    static const int SubmitBatch = 16; // Files per io_uring_enter().
+    struct io_uring ring;
+    QVector<Slot> fileSlots;
+    QVector<unsigned> freeSlots;
+    QSet<QByteArray> queuedPaths;
+    int unsubmitted = 0;
+    bool valid = false,
+         ok = true;
+}; // UringWriter Class Ends
+#endif
+
+/*
+ * Class PathClaims
+ * ----------------
+ *
+ *  Remembers which archive of a run wrote a path. A open addressing table
+ *  of hashes and offsets into a single arena of paths , so a claim costs
+ *  no allocation once the table and the arena have grown to the run.
+ *  Not thread safe , the Extractor locks around it.
+ *
+ *  Methods:
+ *	bool claim(const char* , int) - claims the path for the index , returns false if
+ *					another index has it already.
+ *	void clear()		      - forgets all paths and frees the memory.
+*/
+class PathClaims
+{
+public:
+    bool claim(const char *path, int index)
+    {
+        const size_t length = strlen(path);
+        const quint64 hash = hashPath(path, length);
+        if((used + 1) * 4 > table.size() * 3) {
+            grow();
+        }
+
+        const size_t mask = table.size() - 1;
+        for(size_t at = hash & mask; ; at = (at + 1) & mask) {
+            Slot &Claim = table[at];
+            if(Claim.length == Empty) {
+                Claim.hash = hash;
+                Claim.offset = arena.size();
+                Claim.length = length;
+                Claim.index = index;
+                arena.insert(arena.end(), path, path + length);
+                ++used;
+                return true;
+            }
+            if(Claim.hash == hash && Claim.length == length &&
+               !memcmp(arena.data() + Claim.offset, path, length)) {
+                return (Claim.index == index);
+            }
+        }
+    }
+
+    void clear()
+    {
+        std::vector<char>().swap(arena);
+        std::vector<Slot>().swap(table);
+        used = 0;
+        return;
+    }
+
+private:
+    static const size_t Empty = ~size_t(0);
+
+    struct Slot {
+        quint64 hash = 0;
+        size_t offset = 0,
+               length = Empty;
+        int index = -1;
+    };
+
+    // FNV-1a , paths differ in their last bytes so all of them count.
+    static quint64 hashPath(const char *path, size_t length)
+    {
+        quint64 hash = Q_UINT64_C(14695981039346656037);
+        for(size_t byte = 0; byte < length ; ++byte) {
+            hash ^= static_cast<unsigned char>(path[byte]);
+            hash *= Q_UINT64_C(1099511628211);
+        }
+        return hash;
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old;
+        old.swap(table);
+        table.resize(qMax<size_t>(1024, old.size() * 2));
+
+        const size_t mask = table.size() - 1;
+        for(size_t item = 0; item < old.size() ; ++item) {
+            if(old[item].length == Empty) {
+                continue;
+            }
+            size_t at = old[item].hash & mask;
+            while(table[at].length != Empty) {
+                at = (at + 1) & mask;
+            }
+            table[at] = old[item];
+        }
+        return;
+    }
+
+    std::vector<Slot> table;
+    std::vector<char> arena;
+    size_t used = 0;
+}; // PathClaims Class Ends
+
+/*
+ * Class Extractor <- Inherits QObject.
+ * ---------------
+ *
+ *  Takes care of extraction of archives with the help
+ *  of libarchive.
+ *
+ *  Constructors:
+ *  	Extractor(QObject *parent = NULL)
+ *
+ *  	Extractor(const QString&) 	- Simply extract a single archive , any format
+ *  			      	  , Most likely will be used for 7zip.
+ *  	Extractor(const QStringList&)	- Extract all archives from the QStringList in
+ *  				  order.
+ *
+ *  Methods:
+ *	void addArchive(const QString&)     - Add a archive to the queue.
+ *	void addArchive(const QStringList&) - Add a set of archives to the queue
+ *	void removeArchive(const QString&)  - Removes a archive from the queue matching
+ *					the QString.
+ *	void addStream(ArchiveStream*)	    - Add a archive that is still beign written to the queue ,
+ *					it is known by its objectName().
+ *	void setMaxThreads(int)		    - Sets how many archives are extracted at the same time ,
+ *					default is QThread::idealThreadCount().
+ *	int  getMaxThreads()		    - Gets how many archives are extracted at the same time.
+ *	void setBlockSize(int)		    - Sets the size of a single read from a archive , default is 1 MiB.
+ *	void setMemoryMapping(bool)	    - Memory map the archives instead of reading them , default is true.
+ *	void setWriteFlags(int)		    - Sets how the files are written , a OR of the write flags.
+ *					default is DEFAULT_WRITE.
+ *	int  getWriteFlags()		    - Gets the write flags.
+ *	void setSkipUnchanged(bool)	    - If true , a file which is already installed with the same
+ *					content is not written again. Default is false.
+ *	void setReferenceDigests(const QHash<QString, QByteArray>&)
+ *					    - SHA1 digests of the installed files , by path relative to the
+ *					destination. Such a file is not read to compare it.
+ *	void setReferenceManifest(const QVector<ManifestEntry>&)
+ *					    - The same from a earlier manifest , a digest is only trusted
+ *					while the file has the size and mtime of its entry.
+ *	qint64 getBytesWritten()	    - Bytes of regular files written by the last run.
+ *	qint64 getBytesSkipped()	    - Bytes of regular files skipped as unchanged by the last run.
+ *	void setCollectManifest(bool)	    - If true , a ManifestEntry is kept for every regular file
+ *					written or skipped. Default is false.
+ *	QVector<ManifestEntry> takeManifest() - Returns and forgets the entries of the last run.
+ *	void setStatusInterval(int)	    - Sets the least msecs between two progress() signals , default
+ *					is 100.
+ *	void setStatusPaths(int)	    - Sets how many of the latest paths a progress() carries ,
+ *					default is 8.
+ *	void setEntryStatus(bool)	    - If true , status() is emitted for every entry too. That is a
+ *					queued signal per file , default is false.
+ *	void setEntryFilter(const EntryFilter&) - Only the entries the filter accepts are extracted , the
+ *					others are skipped in the archive and never written.
+ *	qint64 getEntriesFiltered()	    - Entries dropped by the filter in the last run.
+ *
+ *  Note: Two archives of the same run must not write the same file , that is reported
+ *	  as ARCHIVE_PATH_CONFLICT. With setMaxThreads(1) the archives are extracted one
+ *	  after another and a later archive simply overwrites the file.
+ *
+ *  Note: Every filter libarchive has is read , zstd (.tar.zst) and lz4 (.tar.lz4)
+ *	  included. A archive is decompressed by a single thread , a zstd frame cannot
+ *	  be split , so many archives decompress faster than a big one.
+ *
+ *  Slots:
+ *	void start(void)	      - starts the extractor.
+ *	void stop(void)		      - stops the extractor.
+ *  Signals:
+ *	void finished()		        - emitted when all extraction job is done.
+ *	void extracting(const QString&) - emitted with the filename when its extraction begins , from the
+ *					  thread extracting it.
+ *	void extracted(const QString&)  - emitted with the filename that has been extracted , in queue order.
+ *	void status(const QString& , const QString&) - emitted with the entry and the filename on extraction ,
+ *					      only with setEntryStatus(true).
+ *	void progress(qint64 , qint64 , const QStringList&) - emitted at most every status interval with the
+ *					      entries and the bytes of regular files done so far and
+ *					      the latest paths , oldest first. Once more before finished().
+ *	void error(short , const QString&) - emitted when something goes wrong!
+ *	void statistics(qint64 , qint64) - emitted with the bytes written and skipped before finished().
+ *
+*/
+class Extractor  : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Extractor(QObject *parent = NULL)
+        : QObject(parent)
+    {
+        return;
+    }
+
+    explicit Extractor(const QString& filename)
+        : QObject(NULL)
+    {
+        addArchive(filename);
+        return;
+    }
+
+    explicit Extractor(const QStringList& filenames)
+        : QObject(NULL)
+    {
+        addArchive(filenames);
+        return;
+    }
+
+    explicit Extractor(const QString& filename, const QString& destination)
+        : QObject(NULL), dest(cleanDestPath(destination))
+    {
+        addArchive(filename);
+        return;
+    }
+
+    explicit Extractor(const QStringList& filenames, const QString& destination)
+        : QObject(NULL), dest(cleanDestPath(destination))
+    {
+        addArchive(filenames);
+        return;
+    }
+
+    void addArchive(const QString& filename)
+    {
+        if(mutex.tryLock()) {
+            queue << filename;
+            queue.removeDuplicates();
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void addArchive(const QStringList& filenames)
+    {
+
+        /*
+         * No need to extract the same archive twice!
+        */
+        if(mutex.tryLock()) {
+            queue << filenames;
+            queue.removeDuplicates();
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void removeArchive(const QString& filename)
+    {
+        if(mutex.tryLock()) {
+            queue.removeAll(filename);
+            streams.remove(filename);
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void addStream(ArchiveStream *stream)
+    {
+        if(mutex.tryLock()) {
+            queue << stream->objectName();
+            queue.removeDuplicates();
+            streams.insert(stream->objectName(), stream);
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setDestination(const QString& destination)
+    {
+        if(mutex.tryLock()) {
+            dest = cleanDestPath(destination);
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setMaxThreads(int count)
+    {
+        if(mutex.tryLock()) {
+            pool.setMaxThreadCount((count < 1) ? 1 : count);
+            mutex.unlock();
+        }
+        return;
+    }
+
+    int getMaxThreads() const
+    {
+        return pool.maxThreadCount();
+    }
+
+    void setBlockSize(int size)
+    {
+        if(mutex.tryLock()) {
+            blockSize = (size < 1024) ? 1024 : size;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setMemoryMapping(bool ch)
+    {
+        if(mutex.tryLock()) {
+            memoryMapping = ch;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setWriteFlags(int flags)
+    {
+        if(mutex.tryLock()) {
+            writeFlags = flags;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    int getWriteFlags() const
+    {
+        return writeFlags;
+    }
+
+    void setSkipUnchanged(bool ch)
+    {
+        if(mutex.tryLock()) {
+            skipUnchanged = ch;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setReferenceDigests(const QHash<QString, QByteArray>& digests)
+    {
+        if(mutex.tryLock()) {
+            referenceFiles.clear();
+            for(auto Digest = digests.constBegin(); Digest != digests.constEnd() ; ++Digest) {
+                ManifestEntry &Reference = referenceFiles[Digest.key()];
+                Reference.size = Reference.mtime = -1; // Trusted as they are.
+                Reference.digest = Digest.value();
+            }
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setReferenceManifest(const QVector<ManifestEntry>& entries)
+    {
+        if(mutex.tryLock()) {
+            referenceFiles.clear();
+            for(int entry = 0; entry < entries.size() ; ++entry) {
+                if(entries.at(entry).mtime != 0) {
+                    referenceFiles.insert(entries.at(entry).path, entries.at(entry));
+                }
+            }
+            mutex.unlock();
+        }
+        return;
+    }
+
+    qint64 getBytesWritten() const
+    {
+        return bytesWritten.load();
+    }
+
+    qint64 getBytesSkipped() const
+    {
+        return bytesSkipped.load();
+    }
+
+    void setCollectManifest(bool ch)
+    {
+        if(mutex.tryLock()) {
+            collectManifest = ch;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    QVector<ManifestEntry> takeManifest()
+    {
+        QMutexLocker locker(&manifestMutex);
+        QVector<ManifestEntry> Entries;
+        Entries.swap(manifestEntries);
+        return Entries;
+    }
+
+    void setStatusInterval(int msecs)
+    {
+        if(mutex.tryLock()) {
+            statusInterval = (msecs < 0) ? 0 : msecs;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setStatusPaths(int count)
+    {
+        if(mutex.tryLock()) {
+            statusPathCount = (count < 0) ? 0 : count;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setEntryStatus(bool ch)
+    {
+        if(mutex.tryLock()) {
+            entryStatus = ch;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setEntryFilter(const EntryFilter& filter)
+    {
+        if(mutex.tryLock()) {
+            entryFilter = filter;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    qint64 getEntriesFiltered() const
+    {
+        return entriesFiltered.load();
+    }
+
+    ~Extractor()
+    {
+        stop();
+        Promise.waitForFinished(); // The workers use us till the end.
+        return;
+    }
+
+public slots:
+    bool isRunning() const
+    {
+        return Promise.isRunning();
+    }
+
+    void start(void)
+    {
+        if(!mutex.tryLock()) {
+            return;
+        }
+        stopExtraction.store(0);
+        failExtraction.store(0);
+        bytesWritten.store(0);
+        bytesSkipped.store(0);
+        entriesFiltered.store(0);
+        manifestMutex.lock();
+        manifestEntries.clear();
+        manifestMutex.unlock();
+        statusMutex.lock();
+        statusEntries = statusBytes = 0;
+        statusPaths.clear();
+        statusTimer.invalidate();
+        statusMutex.unlock();
+        Promise = QtConcurrent::run(this, &Extractor::startExtraction);
+        return;
+    }
+
+    void stop(void)
+    {
+        /*
+         * If mutex is not locked then that means
+         * there is no start called or the operation is
+         * finished , so doing stop is useless.
+         */
+        if(mutex.tryLock()) {
+            mutex.unlock();
+            return;
+        }
+        stopExtraction.store(1);
+        return;
+    }
+
+signals:
+    void stopped();
+    void finished();
+    void extracted(const QString&);
+    void extracting(const QString&);
+    void status(const QString&, const QString&);
+    void progress(qint64, qint64, const QStringList&);
+    void error(short, const QString&);
+    void statistics(qint64, qint64);
+
+private:
+    /*
+     * Every archive counts on its own and only takes the status mutex
+     * once per interval , the latest paths are kept in a ring of reused
+     * strings so a entry costs no allocation.
+    */
+    struct StatusBatch {
+        explicit StatusBatch(int count)
+            : paths(count)
+        {
+            timer.start();
+            return;
+        }
+
+        qint64 entries = 0,
+               bytes = 0;
+        std::vector<std::string> paths;
+        size_t next = 0,
+               filled = 0;
+        QElapsedTimer timer;
+    };
+
+private slots:
+    QString cleanDestPath(const QString& input)
+    {
+        QString ret = QDir::cleanPath(QDir::toNativeSeparators(input));
+        if(ret.at(ret.count() - 1) != QDir::separator()) {
+            ret += QDir::separator();
+        }
+        return ret;
+    }
+
+    bool isCancelled() const
+    {
+        return (stopExtraction.load() || failExtraction.load());
+    }
+
+    /*
+     * Two archives of the same run must not write the same file ,
+     * the result would depend on which thread is faster.
+    */
+    bool claimPath(const char *path, int index)
+    {
+        QMutexLocker locker(&claimMutex);
+        return claimedPaths.claim(path, index);
+    }
+
+    short extractArchive(int index, const QString& filename, const QString& destination, bool checkConflicts)
+    {
+        emit extracting(filename);
+        std::string filename_str = filename.toStdString(),
+                    dest_str = destination.toStdString();
+        ArchiveStream *stream = streams.value(filename);
+        short result = extract(filename_str.c_str(),
+                               (destination.isEmpty()) ? NULL : dest_str.c_str(),
+                               (checkConflicts) ? index : -1,
+                               stream);
+        if(stream != NULL) {
+            stream->closeReader(); // Never leave the writer waiting on us.
+        }
+        return result;
+    }
+
+    short extract(const char* filename, const char* dest, int index, ArchiveStream *stream)
+    {
+
+        struct archive *arch,*ext;
+        struct archive_entry *entry;
+        short result = NO_ARCHIVE_ERROR;
+        int ret = 0;
+        const qint64 TraceBegin = traceBegin(),
+                     MetricBegin = metricNow();
+        qint64 ExtractedFiles = 0,
+               ExtractedBytes = 0;
+
+        arch = archive_read_new();
+        ext = archive_write_disk_new();
+        archive_write_disk_set_options(ext, ((writeFlags & SKIP_METADATA_WRITE) ? 0 : ARCHIVE_EXTRACT_TIME) |
+                                            ((writeFlags & UNLINK_WRITE) ? ARCHIVE_EXTRACT_UNLINK : 0));
+        archive_read_support_format_all(arch);
+        archive_read_support_filter_all(arch);
+
+        QSet<QByteArray> CreatedDirectories;
+        EntryDigest Digest;
+        StatusBatch Batch(statusPathCount);
+        /*
+         * Reused for every entry , they only grow to the longest path
+         * so the loop does not allocate once it runs.
+        */
+        std::string EntryPath,
+                    LinkPath;
+        const QString ArchiveName = QString::fromUtf8(filename);
+        const bool filterEntries = !entryFilter.isEmpty();
+#if defined(QARCHIVE_USE_IO_URING)
+        UringWriter Uring((writeFlags & IO_URING_WRITE) ? 64 : 0);
+#endif
+        QScopedPointer<QFile> ArchiveFile(stream == NULL ? new QFile(ArchiveName) : NULL);
+        ret = (stream != NULL) ? openArchiveStream(arch, stream)
+                               : openArchiveFile(arch, ArchiveFile.data(), blockSize, memoryMapping);
+        if(ret) {
+            archive_read_free(arch);
+            archive_write_free(ext);
+            return ARCHIVE_READ_ERROR;
+        }
+        while(!isCancelled()) {
+            ret = archive_read_next_header(arch, &entry);
+            if (ret == ARCHIVE_EOF) {
+                break;
+            }
+            if (ret != ARCHIVE_OK) {
+                result = ARCHIVE_QUALITY_ERROR;
+                break;
+            }
+
+            /*
+             * Before anything is written. A hard link is only kept
+             * with its target , else it would point to nothing.
+            */
+            if(filterEntries &&
+               (!entryFilter.accepts(archive_entry_pathname(entry)) ||
+                (archive_entry_hardlink(entry) != NULL && !entryFilter.accepts(archive_entry_hardlink(entry))))) {
+                entriesFiltered.fetchAndAddRelaxed(1);
+                if(archive_read_data_skip(arch) != ARCHIVE_OK) {
+                    result = ARCHIVE_QUALITY_ERROR;
+                    break;
+                }
+                continue;
+            }
+
+            if(dest != NULL) {
+                EntryPath.assign(dest);
+                EntryPath.append(archive_entry_pathname(entry));
+                archive_entry_set_pathname(entry, EntryPath.c_str());
+
+                // Hard links point inside the archive , so they move along.
+                if(archive_entry_hardlink(entry) != NULL) {
+                    LinkPath.assign(dest);
+                    LinkPath.append(archive_entry_hardlink(entry));
+                    archive_entry_set_hardlink(entry, LinkPath.c_str());
+                }
+            }
+
+            if(index >= 0 &&
+               archive_entry_filetype(entry) != AE_IFDIR &&
+               !claimPath(archive_entry_pathname(entry), index)) {
+                result = ARCHIVE_PATH_CONFLICT;
+                break;
+            }
+            if(entryStatus) {
+                emit status(ArchiveName, QString(archive_entry_pathname(entry)));
+            }
+            noteStatus(&Batch, entry);
+            if(archive_entry_filetype(entry) == AE_IFREG) {
+                ++ExtractedFiles;
+                ExtractedBytes += archive_entry_size(entry);
+            }
+
+            EntryDigest *digest = NULL;
+            if(collectManifest &&
+               archive_entry_filetype(entry) == AE_IFREG &&
+               archive_entry_hardlink(entry) == NULL) {
+                Digest.reset();
+                digest = &Digest;
+            }
+
+#if defined(Q_OS_UNIX)
+            if(skipUnchangedEntry(arch, entry, digest, &result)) {
+                if(result != NO_ARCHIVE_ERROR) {
+                    break;
+                }
+                recordManifest(entry, digest, true);
+                continue;
+            }
+#endif
+
+#if defined(QARCHIVE_USE_IO_URING)
+            /*
+             * Only a hard link to a queued file or a entry which writes
+             * a queued path again has to wait for the queued files.
+            */
+            if((archive_entry_hardlink(entry) != NULL || Uring.isQueued(archive_entry_pathname(entry))) &&
+               !Uring.drain()) {
+                result = ARCHIVE_UNCAUGHT_ERROR;
+                break;
+            }
+
+            if(Uring.isValid() &&
+               archive_entry_filetype(entry) == AE_IFREG &&
+               archive_entry_hardlink(entry) == NULL &&
+               archive_entry_size(entry) <= UringFileLimit &&
+               archive_entry_sparse_count(entry) == 0) {
+                result = queueUringFile(arch, entry, &Uring, &CreatedDirectories, digest);
+                if(result != NO_ARCHIVE_ERROR) {
+                    break;
+                }
+                recordManifest(entry, digest, false); // Not on the disk yet.
+                continue;
+            }
+#endif
+
+#if defined(Q_OS_UNIX)
+            if((writeFlags & ~SYNC_WRITE) &&
+               archive_entry_filetype(entry) == AE_IFREG &&
+               archive_entry_hardlink(entry) == NULL) {
+                result = writeRegularFile(arch, entry, &CreatedDirectories, digest);
+                if(result != NO_ARCHIVE_ERROR) {
+                    break;
+                }
+                recordManifest(entry, digest, true);
+                continue;
+            }
+
+            // Nothing but the directory itself is wanted , the cache does it.
+            if((writeFlags & BATCH_DIRECTORY_WRITE) &&
+               (writeFlags & SKIP_METADATA_WRITE) &&
+               archive_entry_filetype(entry) == AE_IFDIR) {
+                const char *directory = archive_entry_pathname(entry);
+                if(!makeDirectories(directory, strlen(directory), &CreatedDirectories)) {
+                    result = DISK_OPEN_ERROR;
+                    break;
+                }
+                continue;
+            }
+#endif
+
+            ret = archive_write_header(ext, entry);
+            if (ret == ARCHIVE_OK) {
+                copy_data(arch, ext, digest);
+                ret = archive_write_finish_entry(ext);
+                if (ret != ARCHIVE_OK) {
+                    result = ARCHIVE_UNCAUGHT_ERROR;
+                    break;
+                }
+                if(archive_entry_filetype(entry) == AE_IFREG) {
+                    bytesWritten.fetchAndAddRelaxed(archive_entry_size(entry));
+                }
+                recordManifest(entry, digest, true);
+            }
+
+        }
+#if defined(QARCHIVE_USE_IO_URING)
+        // archive_write_close() sets the directory times , after the files in them.
+        if(!Uring.drain() && result == NO_ARCHIVE_ERROR) {
+            result = ARCHIVE_UNCAUGHT_ERROR;
+        }
+#endif
+        flushStatus(&Batch, false); // The last one comes from startExtraction().
+        if(TraceBegin != 0) {
+            traceEnd("extract", QFileInfo(ArchiveName).fileName(), TraceBegin, archive_filter_bytes(arch, -1));
+        }
+        metricAdd(EXTRACTED_FILES_METRIC, ExtractedFiles);
+        metricAdd(EXTRACTED_BYTES_METRIC, ExtractedBytes);
+        metricObserve(EXTRACT_PHASE_METRIC, MetricBegin);
+        archive_read_close(arch);
+        archive_read_free(arch);
+        archive_write_close(ext);
+        archive_write_free(ext);
+        return result;
+    }
+
+    void noteStatus(StatusBatch *batch, struct archive_entry *entry)
+    {
+        batch->entries += 1;
+        if(archive_entry_filetype(entry) == AE_IFREG) {
+            batch->bytes += archive_entry_size(entry);
+        }
+        if(!batch->paths.empty()) {
+            batch->paths[batch->next].assign(archive_entry_pathname(entry));
+            batch->next = (batch->next + 1) % batch->paths.size();
+            batch->filled = qMin(batch->filled + 1, batch->paths.size());
+        }
+        if(batch->timer.hasExpired(statusInterval)) {
+            flushStatus(batch, true);
+            batch->timer.restart();
+        }
+        return;
+    }
+
+    void flushStatus(StatusBatch *batch, bool emitProgress)
+    {
+        QMutexLocker locker(&statusMutex);
+        statusEntries += batch->entries;
+        statusBytes += batch->bytes;
+        batch->entries = batch->bytes = 0;
+
+        const size_t Size = batch->paths.size();
+        for(size_t path = Size + batch->next - batch->filled; batch->filled > 0 ; ++path, --batch->filled) {
+            statusPaths.append(QString::fromStdString(batch->paths[path % Size]));
+        }
+        while(statusPaths.size() > statusPathCount) {
+            statusPaths.removeFirst();
+        }
+
+        // Other archives flush too , the interval holds for all of them.
+        if(!emitProgress || (statusTimer.isValid() && !statusTimer.hasExpired(statusInterval))) {
+            return;
+        }
+        statusTimer.start();
+        qint64 Entries = statusEntries,
+               Bytes = statusBytes;
+        QStringList Paths = statusPaths;
+        locker.unlock();
+        emit progress(Entries, Bytes, Paths);
+        return;
+    }
+
+    int copy_data(struct archive *arch, struct archive *ext, EntryDigest *digest = NULL)
     {
         const void *buff;
         size_t size;
@@ -306,12 +1646,15 @@ private slots:
 #else
         off_t offset;
 #endif
-        for (int ret = 0; !stopExtraction;) {
+        for (int ret = 0; !isCancelled();) {
             ret = archive_read_data_block(arch, &buff, &size, &offset);
             if (ret == ARCHIVE_EOF)
                 return (ARCHIVE_OK);
             if (ret != ARCHIVE_OK)
                 return (ret);
+            if(digest != NULL) {
+                digest->add(buff, size, offset);
+            }
             ret = archive_write_data_block(ext, buff, size, offset);
             if (ret != ARCHIVE_OK) {
                 return (ret);
@@ -320,62 +1663,736 @@ private slots:
         return NO_ARCHIVE_ERROR;
     }
 
-    char *concat(const char *dest, const char *src)
+#if defined(Q_OS_UNIX)
+    /*
+     * Creates every missing directory of the path. The ones created or seen
+     * in this run are remembered , so a directory costs a single mkdir()
+     * no matter how many files it holds.
+    */
+    bool makeDirectories(const char *directory, int length, QSet<QByteArray> *created)
+    {
+        while(length > 1 && directory[length - 1] == '/') {
+            --length;
+        }
+        // A raw view for the lookup , only a directory not seen yet is copied.
+        if(created->contains(QByteArray::fromRawData(directory, length))) {
+            return true;
+        }
+
+        const QByteArray path(directory, length);
+
+        for(int at = 1; at <= path.size() ; ++at) {
+            if(at != path.size() && path.at(at) != '/') {
+                continue;
+            }
+            QByteArray part = path.left(at);
+            if(created->contains(part)) {
+                continue;
+            }
+            if(mkdir(part.constData(), 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+            created->insert(part);
+        }
+        return true;
+    }
+
+    bool isZeroBlock(const void *block, size_t size)
+    {
+        const char *data = static_cast<const char*>(block);
+        return (size > 0 && data[0] == 0 && !memcmp(data, data + 1, size - 1));
+    }
+
+    bool writeBlock(int fd, const char *data, size_t size, int64_t offset)
+    {
+        while(size > 0) {
+            ssize_t written = pwrite(fd, data, size, offset);
+            if(written < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    /*
+     * Writes a regular file with plain syscalls , archive_write_disk does
+     * a lot more than that for every single entry.
+    */
+    short writeRegularFile(struct archive *arch, struct archive_entry *entry,
+                           QSet<QByteArray> *created, EntryDigest *digest)
+    {
+        const char *path = archive_entry_pathname(entry);
+        const char *last = strrchr(path, '/');
+        const int slash = (last != NULL) ? int(last - path) : -1;
+        if((writeFlags & BATCH_DIRECTORY_WRITE) && slash > 0 &&
+           !makeDirectories(path, slash, created)) {
+            return DISK_OPEN_ERROR;
+        }
+
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC;
+        const mode_t mode = archive_entry_perm(entry) & 0777;
+        if(writeFlags & UNLINK_WRITE) {
+            unlink(path);
+        }
+        int fd = open(path, flags, mode);
+        if(fd < 0 && errno == ENOENT && slash > 0 && makeDirectories(path, slash, created)) {
+            fd = open(path, flags, mode);
+        }
+        if(fd < 0 && errno == ELOOP) {
+            // Never write through a old symlink , replace it.
+            unlink(path);
+            fd = open(path, flags, mode);
+        }
+        if(fd < 0) {
+            return DISK_OPEN_ERROR;
+        }
+        // open() leaves the mode of a existing file and applies the umask.
+        fchmod(fd, mode);
+
+        const int64_t size = archive_entry_size(entry);
+#if defined(Q_OS_LINUX)
+        if((writeFlags & PREALLOCATE_WRITE) &&
+           !(writeFlags & SPARSE_WRITE) &&
+           size >= PreallocateThreshold &&
+           archive_entry_sparse_count(entry) == 0) {
+            posix_fallocate(fd, 0, size); // Only a hint , the writes below still decide.
+        }
+#endif
+
+        short result = NO_ARCHIVE_ERROR;
+        const void *buff;
+        size_t length;
+        int64_t offset;
+        while(!isCancelled()) {
+            int ret = archive_read_data_block(arch, &buff, &length, &offset);
+            if(ret == ARCHIVE_EOF) {
+                break;
+            }
+            if(ret != ARCHIVE_OK && ret != ARCHIVE_WARN) {
+                result = ARCHIVE_QUALITY_ERROR;
+                break;
+            }
+            if(digest != NULL) {
+                digest->add(buff, length, offset);
+            }
+            if((writeFlags & SPARSE_WRITE) && isZeroBlock(buff, length)) {
+                continue;
+            }
+            if(!writeBlock(fd, static_cast<const char*>(buff), length, offset)) {
+                result = ARCHIVE_UNCAUGHT_ERROR;
+                break;
+            }
+        }
+
+        // Holes at the end of the file are not written by anyone.
+        if(result == NO_ARCHIVE_ERROR && ftruncate(fd, size) != 0) {
+            result = ARCHIVE_UNCAUGHT_ERROR;
+        }
+
+        struct timespec times[2];
+        if(result == NO_ARCHIVE_ERROR && entryTimes(entry, times)) {
+            futimens(fd, times);
+        }
+
+        if(close(fd) != 0 && result == NO_ARCHIVE_ERROR) {
+            result = ARCHIVE_UNCAUGHT_ERROR;
+        }
+        if(result == NO_ARCHIVE_ERROR) {
+            bytesWritten.fetchAndAddRelaxed(size);
+        }
+        return result;
+    }
+
+    /*
+     * The times of the entry as futimens() wants them ,
+     * false if they should not be restored.
+    */
+    bool entryTimes(struct archive_entry *entry, struct timespec *times)
+    {
+        if((writeFlags & SKIP_METADATA_WRITE) || !archive_entry_mtime_is_set(entry)) {
+            return false;
+        }
+        times[1].tv_sec = archive_entry_mtime(entry);
+        times[1].tv_nsec = archive_entry_mtime_nsec(entry);
+        if(archive_entry_atime_is_set(entry)) {
+            times[0].tv_sec = archive_entry_atime(entry);
+            times[0].tv_nsec = archive_entry_atime_nsec(entry);
+        } else {
+            times[0] = times[1];
+        }
+        return true;
+    }
+
+    bool readEntry(struct archive *arch, struct archive_entry *entry, QByteArray *data, EntryDigest *digest)
+    {
+        const int64_t size = archive_entry_size(entry);
+        data->reserve(size);
+
+        const void *buff;
+        size_t length;
+        int64_t offset;
+        for(;;) {
+            int ret = archive_read_data_block(arch, &buff, &length, &offset);
+            if(ret == ARCHIVE_EOF) {
+                break;
+            }
+            if(ret != ARCHIVE_OK && ret != ARCHIVE_WARN) {
+                return false;
+            }
+            if(digest != NULL) {
+                digest->add(buff, length, offset);
+            }
+            if(offset > data->size()) {
+                data->append(QByteArray(offset - data->size(), '\0'));
+            }
+            data->append(static_cast<const char*>(buff), length);
+        }
+        if(data->size() < size) {
+            data->append(QByteArray(size - data->size(), '\0'));
+        }
+        return true;
+    }
+
+    /*
+     * Copies the first bytes of a file , the part a changed file
+     * has in common with the installed one.
+    */
+    bool copyPrefix(int from, int to, int64_t length)
+    {
+        QByteArray buffer(qMin<int64_t>(length, 1048576), Qt::Uninitialized);
+        for(int64_t offset = 0; offset < length ;) {
+            ssize_t got = pread(from, buffer.data(), qMin<int64_t>(buffer.size(), length - offset), offset);
+            if(got < 0 && errno == EINTR) {
+                continue;
+            }
+            if(got <= 0 || !writeBlock(to, buffer.constData(), got, offset)) {
+                return false;
+            }
+            offset += got;
+        }
+        return true;
+    }
+
+    bool readExisting(int fd, char *data, size_t size, int64_t offset)
+    {
+        while(size > 0) {
+            ssize_t got = pread(fd, data, size, offset);
+            if(got < 0 && errno == EINTR) {
+                continue;
+            }
+            if(got <= 0) {
+                return false;
+            }
+            data += got;
+            size -= got;
+            offset += got;
+        }
+        return true;
+    }
+
+    /*
+     * Writes a new file next to the old one and renames it over , the
+     * old file (maybe a hard link into another tree) is never modified.
+    */
+    int openReplacement(const QByteArray& path, mode_t mode)
+    {
+        int fd = open((path + ".qarchive-part").constData(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, mode);
+        if(fd >= 0) {
+            fchmod(fd, mode); // A left over part keeps its mode.
+        }
+        return fd;
+    }
+
+    short finishReplacement(const QByteArray& path, int fd, struct archive_entry *entry, short result)
+    {
+        const QByteArray part = path + ".qarchive-part";
+        struct timespec times[2];
+        if(result == NO_ARCHIVE_ERROR && ftruncate(fd, archive_entry_size(entry)) != 0) {
+            result = ARCHIVE_UNCAUGHT_ERROR;
+        }
+        if(result == NO_ARCHIVE_ERROR && entryTimes(entry, times)) {
+            futimens(fd, times);
+        }
+        if(close(fd) != 0 && result == NO_ARCHIVE_ERROR) {
+            result = ARCHIVE_UNCAUGHT_ERROR;
+        }
+        if(result == NO_ARCHIVE_ERROR && rename(part.constData(), path.constData()) != 0) {
+            result = ARCHIVE_UNCAUGHT_ERROR;
+        }
+        if(result != NO_ARCHIVE_ERROR) {
+            unlink(part.constData());
+            return result;
+        }
+        bytesWritten.fetchAndAddRelaxed(archive_entry_size(entry));
+        return result;
+    }
+
+    /*
+     * Compares the entry with the installed file of the same size while
+     * reading it. Nothing is written as long as they are equal , on the
+     * first difference the new file is built from the equal prefix of
+     * the old one and the rest of the entry.
+    */
+    short writeIfChanged(struct archive *arch, struct archive_entry *entry, int existing, EntryDigest *digest)
+    {
+        const QByteArray path(archive_entry_pathname(entry));
+        const mode_t mode = archive_entry_perm(entry) & 0777;
+        QByteArray current;
+        short result = NO_ARCHIVE_ERROR;
+        int fd = -1;
+
+        const void *buff;
+        size_t length;
+        int64_t offset;
+        while(!isCancelled()) {
+            int ret = archive_read_data_block(arch, &buff, &length, &offset);
+            if(ret == ARCHIVE_EOF) {
+                break;
+            }
+            if(ret != ARCHIVE_OK && ret != ARCHIVE_WARN) {
+                result = ARCHIVE_QUALITY_ERROR;
+                break;
+            }
+            if(digest != NULL) {
+                digest->add(buff, length, offset);
+            }
+
+            if(fd < 0) {
+                current.resize(length);
+                if(readExisting(existing, current.data(), length, offset) &&
+                   !memcmp(current.constData(), buff, length)) {
+                    continue;
+                }
+                fd = openReplacement(path, mode);
+                if(fd < 0) {
+                    result = DISK_OPEN_ERROR;
+                    break;
+                }
+                if(!copyPrefix(existing, fd, offset)) {
+                    result = ARCHIVE_UNCAUGHT_ERROR;
+                    break;
+                }
+            }
+            if(!writeBlock(fd, static_cast<const char*>(buff), length, offset)) {
+                result = ARCHIVE_UNCAUGHT_ERROR;
+                break;
+            }
+        }
+        close(existing);
+
+        if(fd < 0) {
+            if(result == NO_ARCHIVE_ERROR && !isCancelled()) {
+                bytesSkipped.fetchAndAddRelaxed(archive_entry_size(entry));
+                metricAdd(UNCHANGED_BYTES_METRIC, archive_entry_size(entry));
+            }
+            return result;
+        }
+        return finishReplacement(path, fd, entry, result);
+    }
+
+    /*
+     * With a digest of the installed file only the entry is read ,
+     * it is kept in memory until its own digest is known.
+    */
+    short writeIfDigestChanged(struct archive *arch, struct archive_entry *entry,
+                               const QByteArray& reference, EntryDigest *digest)
+    {
+        QByteArray data;
+        if(!readEntry(arch, entry, &data, NULL)) {
+            return ARCHIVE_QUALITY_ERROR;
+        }
+        QByteArray sum = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+        if(digest != NULL) {
+            digest->setResult(sum);
+        }
+        if(sum == reference) {
+            bytesSkipped.fetchAndAddRelaxed(data.size());
+            metricAdd(UNCHANGED_BYTES_METRIC, data.size());
+            return NO_ARCHIVE_ERROR;
+        }
+
+        const QByteArray path(archive_entry_pathname(entry));
+        int fd = openReplacement(path, archive_entry_perm(entry) & 0777);
+        if(fd < 0) {
+            return DISK_OPEN_ERROR;
+        }
+        short result = writeBlock(fd, data.constData(), data.size(), 0) ? NO_ARCHIVE_ERROR : ARCHIVE_UNCAUGHT_ERROR;
+        return finishReplacement(path, fd, entry, result);
+    }
+
+    /*
+     * Returns true if the entry was handled , compared and maybe written.
+    */
+    bool skipUnchangedEntry(struct archive *arch, struct archive_entry *entry, EntryDigest *entryDigest, short *result)
+    {
+        if(!skipUnchanged ||
+           archive_entry_filetype(entry) != AE_IFREG ||
+           archive_entry_hardlink(entry) != NULL ||
+           archive_entry_sparse_count(entry) != 0) {
+            return false;
+        }
+
+        // Only a installed file of the same size and executable bits can be equal.
+        const char *path = archive_entry_pathname(entry);
+        struct stat info;
+        if(lstat(path, &info) != 0 ||
+           !S_ISREG(info.st_mode) ||
+           info.st_size != archive_entry_size(entry) ||
+           (info.st_mode & 0111) != (archive_entry_perm(entry) & 0111)) {
+            return false;
+        }
+
+        if(!referenceFiles.isEmpty() && info.st_size <= DigestBufferLimit) {
+            auto Reference = referenceFiles.constFind(QString::fromUtf8(path).mid(dest.size()));
+            // A file changed since its manifest was written is compared.
+            if(Reference != referenceFiles.constEnd() &&
+               (Reference->mtime < 0 || (Reference->size == info.st_size && Reference->mtime == statMTime(info)))) {
+                *result = writeIfDigestChanged(arch, entry, Reference->digest, entryDigest);
+                return true;
+            }
+        }
+
+        int existing = open(path, O_RDONLY | O_CLOEXEC);
+        if(existing < 0) {
+            return false;
+        }
+        *result = writeIfChanged(arch, entry, existing, entryDigest);
+        return true;
+    }
+#endif
+
+#if defined(QARCHIVE_USE_IO_URING)
+    /*
+     * Reads a small file into memory and hands it to io_uring.
+     * The open happens later in the kernel and cannot create the
+     * directories on a failure , so they are always made first.
+    */
+    short queueUringFile(struct archive *arch, struct archive_entry *entry,
+                         UringWriter *uring, QSet<QByteArray> *created, EntryDigest *digest)
+    {
+        QByteArray path(archive_entry_pathname(entry));
+        int slash = path.lastIndexOf('/');
+        if(slash > 0 && !makeDirectories(path.constData(), slash, created)) {
+            return DISK_OPEN_ERROR;
+        }
+        if(writeFlags & UNLINK_WRITE) {
+            unlink(path.constData());
+        }
+
+        QByteArray data;
+        if(!readEntry(arch, entry, &data, digest)) {
+            return ARCHIVE_QUALITY_ERROR;
+        }
+
+        struct timespec times[2];
+        bool setTimes = entryTimes(entry, times);
+        if(!uring->write(path, data, archive_entry_perm(entry) & 0777, setTimes ? times : NULL)) {
+            return ARCHIVE_UNCAUGHT_ERROR;
+        }
+        bytesWritten.fetchAndAddRelaxed(data.size());
+        return NO_ARCHIVE_ERROR;
+    }
+#endif
+
+#if defined(Q_OS_UNIX)
+    static qint64 statMTime(const struct stat& info)
+    {
+#if defined(Q_OS_DARWIN)
+        return info.st_mtimespec.tv_sec * Q_INT64_C(1000000000) + info.st_mtimespec.tv_nsec;
+#else
+        return info.st_mtim.tv_sec * Q_INT64_C(1000000000) + info.st_mtim.tv_nsec;
+#endif
+    }
+#endif
+
+    qint64 fileMTime(const char *path)
+    {
+#if defined(Q_OS_UNIX)
+        struct stat info;
+        if(lstat(path, &info) == 0) {
+            return statMTime(info);
+        }
+        return 0;
+#else
+        QFileInfo Info(QString::fromUtf8(path));
+        return Info.exists() ? Info.lastModified().toMSecsSinceEpoch() * Q_INT64_C(1000000) : 0;
+#endif
+    }
+
+    void recordManifest(struct archive_entry *entry, EntryDigest *digest, bool onDisk)
+    {
+        if(digest == NULL) {
+            return;
+        }
+
+        ManifestEntry Record;
+        Record.path = QString::fromUtf8(archive_entry_pathname(entry)).mid(dest.size());
+        Record.size = archive_entry_size(entry);
+        Record.mtime = onDisk ? fileMTime(archive_entry_pathname(entry)) : 0;
+        Record.digest = digest->result(Record.size);
+
+        QMutexLocker locker(&manifestMutex);
+        manifestEntries.append(Record);
+        return;
+    }
+
+    /*
+     * One flush for the whole filesystem instead of one per file.
+    */
+    void syncDestination()
+    {
+#if defined(Q_OS_LINUX)
+        int fd = open(dest.isEmpty() ? "." : QFile::encodeName(dest).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(fd >= 0) {
+            syncfs(fd);
+            close(fd);
+        }
+#elif defined(Q_OS_UNIX)
+        sync();
+#endif
+        return;
+    }
+
+    void startExtraction()
+    {
+        short error_code = NO_ARCHIVE_ERROR;
+        QString failed;
+
+        if(!dest.isEmpty()) {
+            /*
+             * Check if the directory exist!
+             */
+            if(!QDir(dest).exists()) {
+                queue.clear();
+                streams.clear();
+                mutex.unlock();
+                emit error(INVALID_DEST_PATH, dest);
+                return;
+            }
+        }
+
+        /*
+         * Every archive goes to the pool , a single archive or a single
+         * thread can never conflict with itself.
+        */
+        bool checkConflicts = (queue.size() > 1 && pool.maxThreadCount() > 1);
+        QVector<QFuture<short>> jobs;
+        claimedPaths.clear();
+        for(auto i = 0; i < queue.size(); ++i) {
+            jobs.push_back(QtConcurrent::run(&pool, this, &Extractor::extractArchive,
+                                             i, queue.at(i), dest, checkConflicts));
+        }
+
+        // Collect in queue order , so extracted() is emitted in that order too.
+        for(auto i = 0; i < jobs.size(); ++i) {
+            short code = jobs[i].result();
+            if(code != NO_ARCHIVE_ERROR && error_code == NO_ARCHIVE_ERROR) {
+                error_code = code;
+                failed = queue.at(i);
+                failExtraction.store(1); // Stop the others.
+            }
+            if(error_code == NO_ARCHIVE_ERROR && !stopExtraction.load()) {
+                emit extracted(queue.at(i));
+            }
+        }
+        claimedPaths.clear();
+        queue.clear();
+        streams.clear();
+
+        if(error_code == NO_ARCHIVE_ERROR && !stopExtraction.load() && (writeFlags & SYNC_WRITE)) {
+            syncDestination();
+        }
+        mutex.unlock();
+
+        if(error_code != NO_ARCHIVE_ERROR) {
+            emit error(error_code, failed);
+            return;
+        }
+        if(stopExtraction.load()) {
+            emit(stopped());
+            return;
+        }
+        statusMutex.lock();
+        qint64 Entries = statusEntries,
+               Bytes = statusBytes;
+        QStringList Paths = statusPaths;
+        statusMutex.unlock();
+        emit progress(Entries, Bytes, Paths);
+        emit statistics(bytesWritten.load(), bytesSkipped.load());
+        emit finished();
+        return;
+    }
+
+private:
+    QAtomicInt stopExtraction, // stop flag!
+               failExtraction; // one of the archives failed.
+    QAtomicInteger<qint64> bytesWritten,
+                           bytesSkipped,
+                           entriesFiltered;
+    EntryFilter entryFilter;
+    QHash<QString, ManifestEntry> referenceFiles;
+    QMutex manifestMutex;
+    QVector<ManifestEntry> manifestEntries;
+    QMutex statusMutex;
+    qint64 statusEntries = 0,
+           statusBytes = 0;
+    QStringList statusPaths;
+    QElapsedTimer statusTimer;
+    int statusInterval = 100, // msecs
+        statusPathCount = 8;
+    bool entryStatus = false;
+    QMutex mutex; // thread-safe!
+    QMutex claimMutex;
+    PathClaims claimedPaths;
+    QStringList queue;
+    QHash<QString, ArchiveStream*> streams;
+    QString	dest;
+    QThreadPool pool;
+    QFuture<void> Promise; // Promise suits this good than future!
+    int blockSize = 1048576; // 1 MiB
+    int writeFlags = DEFAULT_WRITE;
+    bool skipUnchanged = false,
+         collectManifest = false;
+    static const int64_t PreallocateThreshold = 1048576; // 1 MiB
+    static const int64_t DigestBufferLimit = 16777216; // 16 MiB , bigger files are compared.
+#if defined(QARCHIVE_USE_IO_URING)
+    static const int64_t UringFileLimit = 262144; // 256 KiB , bigger ones are not worth the copy.
+#endif
+    bool memoryMapping = true;
+}; // Extractor Class Ends
+
+/*
+ * Structure PrefetchedEntry
+ * -------------------------
+ *  A entry walked from the disk for the Compressor. data holds the content
+ *  when the walker could read it ahead , else the writer reads the file.
+*/
+struct PrefetchedEntry {
+    struct archive_entry *entry = NULL;
+    QByteArray data;
+    bool prefetched = false;
+};
+
+/*
+ * Structure WalkUnit
+ * ------------------
+ *  A part of a node of the Compressor , walked by a single walker. A split
+ *  unit is a directory with its files but without its subdirectories , they
+ *  are units of their own.
+*/
+struct WalkUnit {
+    int node = 0;
+    QString path;
+    bool split = false;
+};
+
+/*
+ * Class PrefetchQueue
+ * -------------------
+ *
+ *  Hands the entries of a walk unit from its walker thread to the writer of the
+ *  Compressor , in the order they were walked. Bounded by bytes and entries ,
+ *  a walker waits while the writer is behind.
+ *
+ *  Methods:
+ *	bool push(const PrefetchedEntry&) - Walker side , false if the queue was cancelled ,
+ *					    the entry is freed then.
+ *	void finish(short)		  - Walker side , no more entries , with a error code.
+ *	bool pop(PrefetchedEntry*)	  - Writer side , waits for a entry , false at the end.
+ *	void cancel()			  - Writer side , the walker stops at its next push.
+ *	short error()			  - The code the walker finished with.
+*/
+class PrefetchQueue
+{
+public:
+    explicit PrefetchQueue(qint64 limit)
+        : byteLimit(limit)
+    {
+        return;
+    }
+
+    ~PrefetchQueue()
     {
-        char *ret = (char*) calloc(sizeof(char), strlen(dest) + strlen(src) + 1);
-
-        strcpy(ret, dest);
-        strcat(ret, src);
-
-        return ret;
+        while(!entries.isEmpty()) {
+            archive_entry_free(entries.dequeue().entry);
+        }
+        return;
     }
 
-    void startExtraction()
+    bool push(const PrefetchedEntry& item)
     {
-        short error_code = NO_ARCHIVE_ERROR;
-        std::string dest_str = dest.toStdString();
-        const char *destination = (dest.isEmpty()) ? NULL : dest_str.c_str();
-
-        if(destination != NULL) {
-            /*
-             * Check if the directory exist!
-             */
-            if(!QDir(dest).exists()) {
-                emit error(INVALID_DEST_PATH, queue.takeFirst());
-                mutex.unlock();
-                return;
-            }
+        QMutexLocker Locker(&lock);
+        // A single entry is always let in , even if it is bigger than the limit.
+        while(!cancelled && !entries.isEmpty() &&
+              (queuedBytes + item.data.size() > byteLimit || entries.size() >= EntryLimit)) {
+            notFull.wait(&lock);
         }
+        if(cancelled) {
+            archive_entry_free(item.entry);
+            return false;
+        }
+        queuedBytes += item.data.size();
+        entries.enqueue(item);
+        notEmpty.wakeOne();
+        return true;
+    }
 
-        for(auto i = 0; i < queue.size() && !stopExtraction; ++i) {
-            emit extracting(queue.at(i));
-            if( (error_code = extract(queue.at(i).toStdString().c_str(), destination)) ) {
-                emit error(error_code, queue.at(i));
-                queue.removeAll(queue.at(i));
-                mutex.unlock();
-                return;
-            }
-            if(!stopExtraction) {
-                emit extracted(queue.at(i));
-            }
+    void finish(short code)
+    {
+        QMutexLocker Locker(&lock);
+        finished = true;
+        errorCode = code;
+        notEmpty.wakeAll();
+        return;
+    }
+
+    bool pop(PrefetchedEntry *item)
+    {
+        QMutexLocker Locker(&lock);
+        while(entries.isEmpty() && !finished) {
+            notEmpty.wait(&lock);
         }
-        mutex.unlock();
-        queue.clear();
-        if(stopExtraction) {
-            emit(stopped());
-            return;
+        if(entries.isEmpty()) {
+            return false;
         }
-        emit finished();
+        *item = entries.dequeue();
+        queuedBytes -= item->data.size();
+        notFull.wakeOne();
+        return true;
+    }
+
+    void cancel()
+    {
+        QMutexLocker Locker(&lock);
+        cancelled = true;
+        notFull.wakeAll();
         return;
     }
 
+    short error()
+    {
+        QMutexLocker Locker(&lock);
+        return errorCode;
+    }
+
 private:
-    bool stopExtraction = false; // stop flag!
-    QMutex mutex; // thread-safe!
-    QStringList queue;
-    QString	dest;
-    QFuture<void> *Promise = nullptr; // Promise suits this good than future!
-}; // Extractor Class Ends
+    static const int EntryLimit = 4096;
+    QMutex lock;
+    QWaitCondition notEmpty,
+                   notFull;
+    QQueue<PrefetchedEntry> entries;
+    qint64 queuedBytes = 0,
+           byteLimit;
+    bool finished = false,
+         cancelled = false;
+    short errorCode = 0;
+}; // PrefetchQueue Class Ends
 
 /*
  * Supported Archive Types for Compressor
@@ -389,7 +2406,10 @@ enum {
     GZIP,
     RAR,
     ZIP,
-    SEVEN_ZIP
+    SEVEN_ZIP,
+    XZ,
+    ZSTD,
+    LZ4
 };
 
 /*
@@ -414,6 +2434,28 @@ enum {
  *	void addFiles(const QStringList&)- add a list of files and folders to the archive.
  *	void removeFiles(const QString&) - removes a file from the archive.
  *	void removeFiles(const QStringList&) - removes a list of files from the archive.
+ *	void setCompressionLevel(int)	 - sets the level of the filter or the format , -1 (default)
+ *					   keeps the default of libarchive.
+ *	void setBaseDirectory(const QString&) - paths under it are stored relative to it , the directory
+ *					   itself is left out. By default the paths are stored as given.
+ *	void setPathPrefix(const QString&) - paths under the base directory are stored under the prefix
+ *					   and the base directory itself as the prefix , like
+ *					   <name>/ in a meta.7z. Default is no prefix.
+ *	void setBlockSize(int)		 - sets the size of a single read from a file , default is 1 MiB.
+ *	void setMemoryMapping(bool)	 - Memory map big files instead of reading them , default is true.
+ *	void setThreads(int)		 - sets the threads used to compress , 0 for
+ *					   QThread::idealThreadCount() , default is 1. xz and zstd use their
+ *					   own threads , zip and 7z always use one thread.
+ *	void setExternalFilters(bool)	 - If true , gzip and bzip2 are piped through pigz and pbzip2
+ *					   from the PATH when more than one thread is set and they are
+ *					   installed. Default is false , libarchive's own single
+ *					   threaded filters are used.
+ *
+ *  The nodes are walked and stated by up to QThread::idealThreadCount() walker
+ *  threads ahead of the writer , which also read the small files in advance.
+ *  A directory is split at its subdirectories , so a single big node is walked
+ *  by many threads too. The archive still lists the nodes in the order they
+ *  were added , a directory always before what is in it.
  *
  *  Slots:
  *	void start() - starts the compression.
@@ -480,6 +2522,72 @@ public:
         return;
     }
 
+    void setCompressionLevel(int level)
+    {
+        if(mutex.tryLock()) {
+            compressionLevel = (level < 0) ? -1 : level;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setExternalFilters(bool ch)
+    {
+        if(mutex.tryLock()) {
+            externalFilters = ch;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setBaseDirectory(const QString& directory)
+    {
+        if(mutex.tryLock()) {
+            baseDirectory = directory.isEmpty() ? QString() : QDir::cleanPath(directory);
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setPathPrefix(const QString& prefix)
+    {
+        if(mutex.tryLock()) {
+            pathPrefix = QDir::cleanPath(prefix);
+            if(pathPrefix == ".") {
+                pathPrefix.clear();
+            }
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setBlockSize(int size)
+    {
+        if(mutex.tryLock()) {
+            blockSize = (size < 16384) ? 16384 : size;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setMemoryMapping(bool ch)
+    {
+        if(mutex.tryLock()) {
+            memoryMapping = ch;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setThreads(int count)
+    {
+        if(mutex.tryLock()) {
+            threads = (count < 0) ? 1 : count;
+            mutex.unlock();
+        }
+        return;
+    }
+
     void addFiles(const QString& file)
     {
         /*
@@ -576,156 +2684,458 @@ private slots:
     */
     void checkNodes()
     {
+        QStringList Existing;
+        Existing.reserve(nodes.size());
         for(QStringListIterator nodeIt(nodes); nodeIt.hasNext();) {
-            QString currentNode(nodeIt.next());
-            QFileInfo fInfo(currentNode);
-            if(!fInfo.exists()) {
-                nodes.removeAll(currentNode);
+            const QString &currentNode = nodeIt.next();
+            if(QFileInfo::exists(currentNode)) {
+                Existing << currentNode;
+            } else {
                 emit error(FILE_NOT_EXIST, currentNode);
             }
         }
+        nodes.swap(Existing);
+        return;
+    }
+
+    /*
+     * Automatically finds the file format from archive extension
+    */
+    void getArchiveFormat()
+    {
+        QFileInfo fInfo(archivePath);
+        QString ext = fInfo.suffix();
+
+        if(ext.toLower() == "bz") {
+            archiveFormat = BZIP;
+        }
+        if(ext.toLower() == "bz2") {
+            archiveFormat = BZIP2;
+        } else if(ext.toLower() == "gz") {
+            archiveFormat = GZIP;
+        } else if(ext.toLower() == "cpio") {
+            archiveFormat = CPIO;
+        } else if(ext.toLower() == "rar") {
+            archiveFormat = RAR;
+        } else if(ext.toLower() == "zip") {
+            archiveFormat = ZIP;
+        } else if(ext.toLower() == "7z") {
+            archiveFormat = SEVEN_ZIP;
+        } else if(ext.toLower() == "xz") {
+            archiveFormat = XZ;
+        } else if(ext.toLower() == "zst" || ext.toLower() == "tzst") {
+            archiveFormat = ZSTD;
+        } else if(ext.toLower() == "lz4") {
+            archiveFormat = LZ4;
+        } else {
+            archiveFormat = NO_FORMAT; // default
+        }
+    }
+
+    /*
+     * libarchive's gzip and bzip2 filters have no threads , a parallel
+     * compressor is run as a external filter instead if the caller asked
+     * for it and there is one. Levels below the lowest of the program are
+     * raised to it , like libarchive does.
+    */
+    bool addParallelFilter(struct archive *a, const char *program, const QString& threadsArgument, int lowestLevel)
+    {
+        const int Count = threadCount();
+        if(!externalFilters || Count < 2 || QStandardPaths::findExecutable(program).isEmpty()) {
+            return false;
+        }
+        QString Command = QString::fromLatin1(program) + " -c " + threadsArgument.arg(Count);
+        if(compressionLevel >= 0) {
+            Command += " -" + QString::number(qBound(lowestLevel, compressionLevel, 9));
+        }
+        return (archive_write_add_filter_program(a, Command.toLatin1().constData()) == ARCHIVE_OK);
+    }
+
+    int threadCount() const
+    {
+        return (threads == 0) ? QThread::idealThreadCount() : threads;
+    }
+
+    /*
+     * Unknown options are ignored , a older libarchive
+     * just compresses with its defaults then.
+    */
+    void setCompressionOptions(struct archive *a)
+    {
+        if(compressionLevel >= 0) {
+            const QByteArray Level = QByteArray::number(compressionLevel);
+            archive_write_set_filter_option(a, NULL, "compression-level", Level.constData());
+            archive_write_set_format_option(a, NULL, "compression-level", Level.constData());
+        }
+        if((archiveFormat == XZ || archiveFormat == ZSTD) && threadCount() > 1) {
+            archive_write_set_filter_option(a, (archiveFormat == XZ) ? "xz" : "zstd", "threads",
+                                            QByteArray::number(threadCount()).constData());
+        }
+        return;
+    }
+
+    void startCompression()
+    {
+        checkNodes(); // clear unwanted files
+        qDebug() << nodes;
+        if(nodes.isEmpty() || archivePath.isEmpty()) {
+            mutex.unlock();
+            return;
+        }
+        if(archiveFormat == NO_FORMAT) {
+            getArchiveFormat();
+        }
+        // Creating the archive!
+        struct archive *a;
+        bool noTar = false;
+        int filterResult = ARCHIVE_OK;
+
+        a = archive_write_new();
+        switch (archiveFormat) {
+        case BZIP:
+        case BZIP2:
+        case NO_FORMAT:
+            if(!addParallelFilter(a, "pbzip2", "-p%1", 1)) {
+                archive_write_add_filter_bzip2(a);
+            }
+            break;
+        case GZIP:
+            if(!addParallelFilter(a, "pigz", "-p %1", 0)) {
+                archive_write_add_filter_gzip(a);
+            }
+            break;
+        case XZ:
+            filterResult = archive_write_add_filter_xz(a);
+            break;
+        case ZSTD:
+            filterResult = archive_write_add_filter_zstd(a);
+            break;
+        case LZ4:
+            filterResult = archive_write_add_filter_lz4(a);
+            break;
+        default:
+            noTar = true;
+            archive_write_add_filter_none(a);
+            break;
+        }
+        if(noTar) {
+            if(archiveFormat == SEVEN_ZIP) {
+                archive_write_set_format_7zip(a);
+            }
+            if(archiveFormat == RAR) {
+                archive_write_set_format_xar(a);
+            }
+            if(archiveFormat == ZIP) {
+                archive_write_set_format_zip(a);
+            }
+        } else {
+            archive_write_set_format_ustar(a);
+        }
+        /*
+         * Without libzstd or liblz4 libarchive runs the zstd or lz4 program
+         * instead (ARCHIVE_WARN) , which only fails once the archive is opened.
+        */
+        setCompressionOptions(a);
+        if(filterResult < ARCHIVE_WARN ||
+           archive_write_open_filename(a, archivePath.toStdString().c_str()) != ARCHIVE_OK) {
+            archive_write_free(a);
+            emit error(ARCHIVE_FATAL_ERROR, archivePath);
+            mutex.unlock();
+            return;
+        }
+
+        short result = writeNodes(a);
+
+        archive_write_close(a);
+        archive_write_free(a);
+        if(result != NO_ARCHIVE_ERROR) {
+            mutex.unlock();
+            return;
+        }
+        if(stopCompression) {
+            mutex.unlock();
+            emit(stopped());
+            return;
+        }
+        nodes.clear();
+        mutex.unlock();
+        emit finished();
+        return;
+    }
+
+    /*
+     * Splits the directories into units breadth first , until there are
+     * enough units to keep the walkers busy or SplitDepth is reached.
+     * Symlinks are never split , they are not followed.
+    */
+    QVector<WalkUnit> walkUnits(int walkers)
+    {
+        QVector<WalkUnit> Units;
+        for(int node = 0; node < nodes.size() ; ++node) {
+            WalkUnit Unit;
+            Unit.node = node;
+            Unit.path = nodes.at(node);
+            Units.push_back(Unit);
+        }
+
+        for(int depth = 0; depth < SplitDepth && Units.size() < walkers * UnitsPerWalker ; ++depth) {
+            QVector<WalkUnit> Split;
+            bool splitAny = false;
+            for(int unit = 0; unit < Units.size() ; ++unit) {
+                WalkUnit Unit = Units.at(unit);
+                QFileInfo Info(Unit.path);
+                if(Unit.split || !Info.isDir() || Info.isSymLink()) {
+                    Split.push_back(Unit);
+                    continue;
+                }
+                Unit.split = true;
+                Split.push_back(Unit);
+                const QString Prefix = Unit.path.endsWith('/') ? Unit.path : Unit.path + "/";
+                const QStringList Directories = QDir(Unit.path).entryList(QDir::Dirs | QDir::NoSymLinks |
+                                                QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+                for(int child = 0; child < Directories.size() ; ++child) {
+                    WalkUnit Child;
+                    Child.node = Unit.node;
+                    Child.path = Prefix + Directories.at(child);
+                    Split.push_back(Child);
+                }
+                splitAny = true;
+            }
+            Units.swap(Split);
+            if(!splitAny) {
+                break;
+            }
+        }
+        return Units;
+    }
+
+    /*
+     * The walkers run on their own pool , so a walker the writer waits
+     * for is always running. A window of units is walked at a time.
+     * The queues live until the pool is done , a walker may still be
+     * leaving finish() when the writer moves on.
+    */
+    short writeNodes(struct archive *a)
+    {
+        const int Walkers = qMax(2, QThread::idealThreadCount());
+        const QVector<WalkUnit> Units = walkUnits(Walkers);
+        const int Window = qMin(Units.size(), Walkers);
+        std::vector<std::unique_ptr<PrefetchQueue>> Queues(Units.size());
+        QThreadPool Pool;
+        Pool.setMaxThreadCount(Window);
+        const std::string Base = baseDirectory.toStdString(),
+                          Prefix = pathPrefix.toStdString();
+
+        auto startWalker = [&](int unit) {
+            if(unit >= Units.size()) {
+                return;
+            }
+            Queues[unit].reset(new PrefetchQueue(PrefetchBytes / Window));
+            PrefetchQueue *Queue = Queues[unit].get();
+            const WalkUnit Unit = Units.at(unit);
+            QtConcurrent::run(&Pool, [this, Unit, Base, Prefix, Queue]() {
+                walkNode(Unit.path, Unit.split, Base, Prefix, Queue);
+            });
+        };
+        for(int unit = 0; unit < Window ; ++unit) {
+            startWalker(unit);
+        }
+
+        std::vector<char> Buffer(blockSize);
+        short result = NO_ARCHIVE_ERROR;
+        for(int unit = 0; unit < Units.size() && !stopCompression ; ++unit) {
+            const QString &currentNode = nodes.at(Units.at(unit).node);
+            const bool firstUnit = (unit == 0 || Units.at(unit - 1).node != Units.at(unit).node),
+                       lastUnit = (unit + 1 == Units.size() || Units.at(unit + 1).node != Units.at(unit).node);
+            PrefetchQueue *Queue = Queues[unit].get();
+            PrefetchedEntry Item;
+
+            if(firstUnit) {
+                emit compressing(currentNode);
+            }
+            while(!stopCompression && Queue->pop(&Item)) {
+                int r = archive_write_header(a, Item.entry);
+                if (r == ARCHIVE_FATAL) {
+                    archive_entry_free(Item.entry);
+                    result = ARCHIVE_FATAL_ERROR;
+                    break;
+                }
+                if (r > ARCHIVE_FAILED && archive_entry_filetype(Item.entry) == AE_IFREG &&
+                    archive_entry_size(Item.entry) > 0) {
+                    if(Item.prefetched) {
+                        writeData(a, Item.data.constData(), Item.data.size());
+                    } else {
+                        writeFileData(a, archive_entry_sourcepath(Item.entry), &Buffer);
+                    }
+                }
+                archive_entry_free(Item.entry);
+            }
+            if(result == NO_ARCHIVE_ERROR && !stopCompression) {
+                result = Queue->error();
+            }
+            if(result != NO_ARCHIVE_ERROR) {
+                emit error(result, currentNode);
+                break;
+            }
+            if(lastUnit && !stopCompression) {
+                emit compressed(currentNode);
+            }
+            startWalker(unit + Window);
+        }
+
+        for(size_t left = 0; left < Queues.size() ; ++left) {
+            if(Queues[left]) {
+                Queues[left]->cancel();
+            }
+        }
+        Pool.waitForDone();
+        return result;
+    }
+
+    /*
+     * Runs on a walker thread , walks and stats the node and reads
+     * the small files while the writer compresses the units before.
+     * A split node is only descended once , its subdirectories are
+     * left to their own units.
+    */
+    void walkNode(const QString& node, bool split, const std::string& base, const std::string& prefix,
+                  PrefetchQueue *queue)
+    {
+        struct archive *disk = archive_read_disk_new();
+        archive_read_disk_set_standard_lookup(disk);
+        if(archive_read_disk_open(disk, node.toStdString().c_str()) != ARCHIVE_OK) {
+            archive_read_free(disk);
+            queue->finish(DISK_OPEN_ERROR);
+            return;
+        }
+
+        short result = NO_ARCHIVE_ERROR;
+        bool root = true;
+        for (; !stopCompression;) {
+            PrefetchedEntry Item;
+            Item.entry = archive_entry_new();
+            int r = archive_read_next_header2(disk, Item.entry);
+            if (r != ARCHIVE_OK) {
+                archive_entry_free(Item.entry);
+                result = (r == ARCHIVE_EOF) ? NO_ARCHIVE_ERROR : DISK_READ_ERROR;
+                break;
+            }
+            if(!split || root) {
+                archive_read_disk_descend(disk);
+            } else if(archive_entry_filetype(Item.entry) == AE_IFDIR) {
+                archive_entry_free(Item.entry);
+                continue;
+            }
+            root = false;
+            if(!base.empty() && !rebaseEntry(Item.entry, base, prefix)) {
+                archive_entry_free(Item.entry);
+                continue;
+            }
+            if(archive_entry_filetype(Item.entry) == AE_IFREG && archive_entry_size(Item.entry) > 0 &&
+               archive_entry_size(Item.entry) <= PrefetchFileLimit) {
+                Item.prefetched = readSmallFile(archive_entry_sourcepath(Item.entry),
+                                                archive_entry_size(Item.entry), &Item.data);
+            }
+            if(!queue->push(Item)) {
+                break;
+            }
+        }
+        archive_read_close(disk);
+        archive_read_free(disk);
+        queue->finish(result);
+        return;
     }
 
     /*
-     * Automatically finds the file format from archive extension
+     * Replaces the base of the path with the prefix , false for the base
+     * itself without a prefix. The path is copied first , it lives inside
+     * the entry.
     */
-    void getArchiveFormat()
+    static bool rebaseEntry(struct archive_entry *entry, const std::string& base, const std::string& prefix)
     {
-        QFileInfo fInfo(archivePath);
-        QString ext = fInfo.suffix();
-
-        if(ext.toLower() == "bz") {
-            archiveFormat = BZIP;
+        const char *Path = archive_entry_pathname(entry);
+        if(Path == NULL || strncmp(Path, base.c_str(), base.size())) {
+            return true;
         }
-        if(ext.toLower() == "bz2") {
-            archiveFormat = BZIP2;
-        } else if(ext.toLower() == "gz") {
-            archiveFormat = GZIP;
-        } else if(ext.toLower() == "cpio") {
-            archiveFormat = CPIO;
-        } else if(ext.toLower() == "rar") {
-            archiveFormat = RAR;
-        } else if(ext.toLower() == "zip") {
-            archiveFormat = ZIP;
-        } else if(ext.toLower() == "7z") {
-            archiveFormat = SEVEN_ZIP;
-        } else {
-            archiveFormat = NO_FORMAT; // default
+        if(Path[base.size()] == '\0') {
+            if(prefix.empty()) {
+                return false;
+            }
+            archive_entry_copy_pathname(entry, prefix.c_str());
+            return true;
+        }
+        if(Path[base.size()] == '/') {
+            const std::string Relative = (prefix.empty() ? std::string() : prefix + "/") + (Path + base.size() + 1);
+            archive_entry_copy_pathname(entry, Relative.c_str());
         }
+        return true;
     }
 
-    void startCompression()
+    static bool readSmallFile(const char *path, int64_t size, QByteArray *data)
     {
-        checkNodes(); // clear unwanted files
-        qDebug() << nodes;
-        if(nodes.isEmpty() || archivePath.isEmpty()) {
-            mutex.unlock();
-            return;
-        }
-        if(archiveFormat == NO_FORMAT) {
-            getArchiveFormat();
-        }
-        // Creating the archive!
-        char buff[16384];
-        struct archive *a;
-        struct archive_entry *entry;
-        ssize_t len;
-        bool noTar = false;
-        int fd;
-
-        a = archive_write_new();
-        switch (archiveFormat) {
-        case BZIP:
-        case BZIP2:
-        case NO_FORMAT:
-            archive_write_add_filter_bzip2(a);
-            break;
-        case GZIP:
-            archive_write_add_filter_gzip(a);
-            break;
-        default:
-            noTar = true;
-            archive_write_add_filter_none(a);
-            break;
+        int fd = open(path, O_RDONLY);
+        if(fd < 0) {
+            return false;
         }
-        if(noTar) {
-            if(archiveFormat == SEVEN_ZIP) {
-                archive_write_set_format_7zip(a);
-            }
-            if(archiveFormat == RAR) {
-                archive_write_set_format_xar(a);
+        data->resize(int(size));
+        int64_t got = 0;
+        while(got < size) {
+            ssize_t len = read(fd, data->data() + got, size - got);
+            if(len < 0 && errno == EINTR) {
+                continue;
             }
-            if(archiveFormat == ZIP) {
-                archive_write_set_format_zip(a);
+            if(len <= 0) {
+                break;
             }
-        } else {
-            archive_write_set_format_ustar(a);
+            got += len;
         }
-        archive_write_open_filename(a, archivePath.toStdString().c_str());
-
-        QStringListIterator nodeIt(nodes);
-        while (nodeIt.hasNext() && !stopCompression) {
-            struct archive *disk = archive_read_disk_new();
-            archive_read_disk_set_standard_lookup(disk);
-            QString currentNode = nodeIt.next();
-            int r;
-
-            emit compressing(currentNode);
+        close(fd);
+        data->resize(int(got)); // The file may have shrunk since its stat.
+        return true;
+    }
 
-            r = archive_read_disk_open(disk, currentNode.toStdString().c_str());
-            if (r != ARCHIVE_OK) {
-                emit error(DISK_OPEN_ERROR, currentNode);
-                mutex.unlock();
+    static void writeData(struct archive *a, const char *data, int64_t size)
+    {
+        while(size > 0) {
+            la_ssize_t written = archive_write_data(a, data, size);
+            if(written <= 0) {
                 return;
             }
+            data += written;
+            size -= written;
+        }
+        return;
+    }
 
-            for (; !stopCompression;) {
-                entry = archive_entry_new();
-                r = archive_read_next_header2(disk, entry);
-                if (r == ARCHIVE_EOF)
-                    break;
-                if (r != ARCHIVE_OK) {
-                    emit error(DISK_READ_ERROR, currentNode);
-                    mutex.unlock();
-                    return;
-                }
-                archive_read_disk_descend(disk);
-                r = archive_write_header(a, entry);
-
-                if (r == ARCHIVE_FATAL) {
-                    emit error(ARCHIVE_FATAL_ERROR, currentNode);
-                    mutex.unlock();
-                    return;
-                }
-                if (r > ARCHIVE_FAILED) {
-                    /* For now, we use a simpler loop to copy data
-                     * into the target archive. */
-                    fd = open(archive_entry_sourcepath(entry), O_RDONLY);
-                    len = read(fd, buff, sizeof(buff));
-                    while (len > 0 && !stopCompression) {
-                        archive_write_data(a, buff, len);
-                        len = read(fd, buff, sizeof(buff));
-                    }
-                    close(fd);
-                }
-                archive_entry_free(entry);
-            }
-            archive_read_close(disk);
-            archive_read_free(disk);
-            if(!stopCompression) {
-                emit compressed(currentNode);
+    /*
+     * Big files are mapped , the filter reads them right from the page
+     * cache. Without a mapping they are read in blockSize chunks.
+    */
+    void writeFileData(struct archive *a, const char *path, std::vector<char> *buffer)
+    {
+        int fd = open(path, O_RDONLY);
+        if(fd < 0) {
+            return;
+        }
+#if defined(Q_OS_UNIX)
+        struct stat info;
+        if(memoryMapping && fstat(fd, &info) == 0 && info.st_size > 0) {
+            void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapped != MAP_FAILED) {
+                madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+                writeData(a, static_cast<const char*>(mapped), info.st_size);
+                munmap(mapped, info.st_size);
+                close(fd);
+                return;
             }
         }
-        archive_write_close(a);
-        archive_write_free(a);
-        if(stopCompression) {
-            mutex.unlock();
-            emit(stopped());
-            return;
+#endif
+        ssize_t len = read(fd, buffer->data(), buffer->size());
+        while (len > 0 && !stopCompression) {
+            writeData(a, buffer->data(), len);
+            len = read(fd, buffer->data(), buffer->size());
         }
-        nodes.clear();
-        mutex.unlock();
-        emit finished();
+        close(fd);
         return;
     }
 
@@ -742,6 +3152,17 @@ private:
     QString archivePath;
     QStringList nodes;
     short archiveFormat = NO_FORMAT; // Default
+    int compressionLevel = -1,
+        threads = 1,
+        blockSize = 1048576; // 1 MiB
+    bool memoryMapping = true,
+         externalFilters = false;
+    QString baseDirectory,
+            pathPrefix;
+    static const int64_t PrefetchFileLimit = 1048576; // 1 MiB , bigger files are read by the writer.
+    static const qint64 PrefetchBytes = 67108864; // 64 MiB over all walkers.
+    static const int SplitDepth = 4,
+                     UnitsPerWalker = 4;
 }; // Compressor Class Ends
 
 /*
@@ -759,9 +3180,24 @@ private:
  * 	void setArchive(const QString&) - Sets a single archive
  *	void clear()			- Clears everything stored in this class.
  *	const QStringList& listFiles() - get the files stored in this class.
+ *	void setBlockSize(int)		- Sets the size of a single read from the archive , default is 1 MiB.
+ *	void setMemoryMapping(bool)	- Memory map the archive instead of reading it , default is true.
+ *	void setIndexCache(const QString&) - Sets a directory where the table of contents of every
+ *					  archive read is kept , by the SHA1 of the archive. A archive
+ *					  read again is not walked , default is no cache.
+ *	void setArchiveDigest(const QByteArray&) - The raw SHA1 of the archive if known , else the
+ *					  cache goes by the path , size and modification time.
+ *	const QVector<ArchiveIndexEntry>& listEntries() - get the table of contents.
+ *	bool isIndexCached()		- True if the last listing came from the cache.
+ *	short extractEntries(const QStringList& ,
+ *			     const QString&) - Extracts the given paths of the listed archive to the
+ *					  destination , blocking. Entries of zip and uncompressed tar
+ *					  are read right from their offset , the others in a single
+ *					  pass which skips the rest.
  *
  * Slots:
  * 	start() - Starts the operation.
+ * 	read()  - Same as start() but reads on the calling thread , blocking.
  * 	stop()  - Stops the operation.
  *
  * Signals:
@@ -800,11 +3236,92 @@ public:
         return Files;
     }
 
+    void setBlockSize(int size)
+    {
+        if(mutex.tryLock()) {
+            blockSize = (size < 1024) ? 1024 : size;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setMemoryMapping(bool ch)
+    {
+        if(mutex.tryLock()) {
+            memoryMapping = ch;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setIndexCache(const QString& directory)
+    {
+        if(mutex.tryLock()) {
+            indexCache = directory;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    void setArchiveDigest(const QByteArray& digest)
+    {
+        if(mutex.tryLock()) {
+            archiveDigest = digest;
+            mutex.unlock();
+        }
+        return;
+    }
+
+    const QVector<ArchiveIndexEntry>& listEntries()
+    {
+        return Entries;
+    }
+
+    bool isIndexCached() const
+    {
+        return indexCached;
+    }
+
+    short extractEntries(const QStringList& paths, const QString& destination)
+    {
+        if(!mutex.tryLock()) {
+            return ARCHIVE_UNCAUGHT_ERROR;
+        }
+        if(!QDir(destination).exists()) {
+            mutex.unlock();
+            return INVALID_DEST_PATH;
+        }
+
+        QString Destination = QDir::cleanPath(destination) + "/";
+        QSet<QString> Wanted = paths.toSet();
+        short result = NO_ARCHIVE_ERROR;
+
+        for(int item = 0; item < Entries.size() && indexSeek != NO_INDEX_SEEK ; ++item) {
+            const ArchiveIndexEntry &Entry = Entries.at(item);
+            if(Entry.offset >= 0 && Wanted.contains(Entry.path) &&
+               extractAt(Entry, Destination) == NO_ARCHIVE_ERROR) {
+                Wanted.remove(Entry.path);
+            }
+        }
+        if(!Wanted.isEmpty()) {
+            result = extractByScan(&Wanted, Destination);
+        }
+        if(result == NO_ARCHIVE_ERROR && !Wanted.isEmpty()) {
+            result = FILE_NOT_EXIST;
+        }
+        mutex.unlock();
+        return result;
+    }
+
     void clear()
     {
         if(mutex.tryLock()) {
             Archive.clear();
+            archiveDigest.clear();
             Files.clear();
+            Entries.clear();
+            indexSeek = NO_INDEX_SEEK;
+            indexCached = false;
             mutex.unlock();
         }
         return;
@@ -834,6 +3351,15 @@ public slots:
         return;
     }
 
+    void read(void)
+    {
+        if(!mutex.tryLock()) {
+            return;
+        }
+        startReading();
+        return;
+    }
+
     void stop(void)
     {
         /*
@@ -865,6 +3391,35 @@ private slots:
             return;
         }
 
+        Files.clear();
+        Entries.clear();
+        indexSeek = NO_INDEX_SEEK;
+        indexCached = false;
+
+        QString IndexFile;
+        if(!indexCache.isEmpty()) {
+            /*
+             * Hashing the archive would cost as much as walking it ,
+             * without a digest the path , size and time are the key.
+            */
+            QByteArray Digest = archiveDigest;
+            if(Digest.isEmpty()) {
+                QCryptographicHash Hash(QCryptographicHash::Sha1);
+                Hash.addData(fInfo.absoluteFilePath().toUtf8());
+                Hash.addData(QByteArray(1, '\0'));
+                Hash.addData(QByteArray::number(fInfo.size()) + ":" +
+                             QByteArray::number(fInfo.lastModified().toMSecsSinceEpoch()));
+                Digest = Hash.result();
+            }
+            IndexFile = indexCache + "/" + QString::fromLatin1(Digest.toHex()) + ".toc";
+            if(loadIndex(IndexFile)) {
+                indexCached = true;
+                mutex.unlock();
+                emit archiveFiles(Archive, Files);
+                return;
+            }
+        }
+
         struct archive *arch;
         struct archive_entry *entry;
         int ret = 0;
@@ -873,7 +3428,9 @@ private slots:
         archive_read_support_format_all(arch);
         archive_read_support_filter_all(arch);
 
-        if((ret = archive_read_open_filename(arch, Archive.toStdString().c_str(), 10240))) {
+        QFile ArchiveFile(Archive);
+        if((ret = openArchiveFile(arch, &ArchiveFile, blockSize, memoryMapping))) {
+            archive_read_free(arch);
             mutex.unlock();
             emit error(ARCHIVE_READ_ERROR, Archive);
             return;
@@ -884,14 +3441,36 @@ private slots:
                 break;
             }
             if (ret != ARCHIVE_OK) {
+                archive_read_free(arch);
                 mutex.unlock();
                 emit error(ARCHIVE_QUALITY_ERROR, Archive);
                 return;
             }
-            Files << archive_entry_pathname(entry);
+            if(Entries.isEmpty() && archive_filter_code(arch, 0) == ARCHIVE_FILTER_NONE) {
+                const int Format = archive_format(arch) & ARCHIVE_FORMAT_BASE_MASK;
+                indexSeek = (Format == ARCHIVE_FORMAT_ZIP) ? ZIP_INDEX_SEEK :
+                            (Format == ARCHIVE_FORMAT_TAR) ? TAR_INDEX_SEEK : NO_INDEX_SEEK;
+            }
+
+            ArchiveIndexEntry Entry;
+            Entry.path = QString::fromUtf8(archive_entry_pathname(entry));
+            Entry.size = archive_entry_size(entry);
+            Entry.type = archive_entry_filetype(entry);
+            // A tar is read front to back , the header position is the file offset.
+            Entry.offset = (indexSeek == TAR_INDEX_SEEK) ? archive_read_header_position(arch) : -1;
+            Entries.push_back(Entry);
+            Files << Entry.path;
         }
         archive_read_close(arch);
         archive_read_free(arch);
+
+        // The zip reader jumps around , its offsets come from the central directory.
+        if(indexSeek == ZIP_INDEX_SEEK && !stopReader && !zipOffsets()) {
+            indexSeek = NO_INDEX_SEEK;
+        }
+        if(!IndexFile.isEmpty() && !stopReader) {
+            saveIndex(IndexFile);
+        }
         mutex.unlock();
         if(stopReader) {
             emit(stopped());
@@ -900,6 +3479,206 @@ private slots:
         emit archiveFiles(Archive, Files);
         return;
     }
+
+    /*
+     * Index format , QDataStream (Qt 5.0) :
+     *  quint32 magic , quint16 version , qint32 seek kind , quint32 count ,
+     *  then per entry QByteArray path (UTF-8) , qint64 size , qint32 type ,
+     *  qint64 offset.
+    */
+    bool loadIndex(const QString& fileName)
+    {
+        QFile File(fileName);
+        if(!File.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        QDataStream Stream(&File);
+        Stream.setVersion(QDataStream::Qt_5_0);
+        quint32 Magic, Count;
+        quint16 Version;
+        qint32 Seek;
+        Stream >> Magic >> Version >> Seek >> Count;
+        if(Magic != IndexMagic || Version != IndexVersion) {
+            return false;
+        }
+
+        QVector<ArchiveIndexEntry> Loaded;
+        for(quint32 item = 0; item < Count && Stream.status() == QDataStream::Ok ; ++item) {
+            ArchiveIndexEntry Entry;
+            QByteArray Path;
+            qint32 Type;
+            Stream >> Path >> Entry.size >> Type >> Entry.offset;
+            Entry.path = QString::fromUtf8(Path);
+            Entry.type = Type;
+            Loaded.push_back(Entry);
+        }
+        if(Stream.status() != QDataStream::Ok) {
+            return false;
+        }
+
+        Entries.swap(Loaded);
+        indexSeek = Seek;
+        for(int item = 0; item < Entries.size() ; ++item) {
+            Files << Entries.at(item).path;
+        }
+        return true;
+    }
+
+    bool saveIndex(const QString& fileName)
+    {
+        if(!QDir().mkpath(indexCache)) {
+            return false;
+        }
+        QSaveFile File(fileName);
+        if(!File.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+
+        QDataStream Stream(&File);
+        Stream.setVersion(QDataStream::Qt_5_0);
+        Stream << quint32(IndexMagic) << quint16(IndexVersion) << qint32(indexSeek) << quint32(Entries.size());
+        for(int item = 0; item < Entries.size() ; ++item) {
+            const ArchiveIndexEntry &Entry = Entries.at(item);
+            Stream << Entry.path.toUtf8() << Entry.size << qint32(Entry.type) << Entry.offset;
+        }
+        return File.commit();
+    }
+
+    /*
+     * Takes the local header offsets from the central directory at the
+     * end of the zip. Zip64 archives are left without offsets.
+    */
+    bool zipOffsets()
+    {
+        QFile File(Archive);
+        if(!File.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        const qint64 TailSize = qMin<qint64>(File.size(), 65535 + 22);
+        File.seek(File.size() - TailSize);
+        const QByteArray Tail = File.read(TailSize);
+        const int End = Tail.lastIndexOf(QByteArray("PK\x05\x06", 4));
+        if(End < 0 || End + 22 > Tail.size()) {
+            return false;
+        }
+        const uchar *Record = reinterpret_cast<const uchar*>(Tail.constData()) + End;
+        const quint32 DirectorySize = qFromLittleEndian<quint32>(Record + 12),
+                      DirectoryOffset = qFromLittleEndian<quint32>(Record + 16);
+        if(DirectorySize == 0xffffffff || DirectoryOffset == 0xffffffff || !File.seek(DirectoryOffset)) {
+            return false;
+        }
+
+        const QByteArray Directory = File.read(DirectorySize);
+        const uchar *Data = reinterpret_cast<const uchar*>(Directory.constData());
+        QHash<QString, qint64> Offsets;
+        for(int at = 0; at + 46 <= Directory.size() && !memcmp(Data + at, "PK\x01\x02", 4) ; ) {
+            const int NameLength = qFromLittleEndian<quint16>(Data + at + 28),
+                      ExtraLength = qFromLittleEndian<quint16>(Data + at + 30),
+                      CommentLength = qFromLittleEndian<quint16>(Data + at + 32);
+            const quint32 Offset = qFromLittleEndian<quint32>(Data + at + 42);
+            if(at + 46 + NameLength > Directory.size()) {
+                return false;
+            }
+            if(Offset != 0xffffffff) {
+                Offsets.insert(QString::fromUtf8(Directory.constData() + at + 46, NameLength), Offset);
+            }
+            at += 46 + NameLength + ExtraLength + CommentLength;
+        }
+
+        for(int item = 0; item < Entries.size() ; ++item) {
+            Entries[item].offset = Offsets.value(Entries.at(item).path, -1);
+        }
+        return true;
+    }
+
+    bool writeEntry(struct archive *arch, struct archive_entry *entry, const QString& destination)
+    {
+        const std::string Path = QFile::encodeName(destination).toStdString() + archive_entry_pathname(entry);
+        archive_entry_set_pathname(entry, Path.c_str());
+
+        struct archive *ext = archive_write_disk_new();
+        archive_write_disk_set_options(ext, ARCHIVE_EXTRACT_TIME);
+        bool ok = (archive_write_header(ext, entry) == ARCHIVE_OK);
+        const void *buff;
+        size_t size;
+        int64_t offset;
+        for(int ret = ARCHIVE_OK; ok ;) {
+            ret = archive_read_data_block(arch, &buff, &size, &offset);
+            if(ret == ARCHIVE_EOF) {
+                break;
+            }
+            ok = (ret == ARCHIVE_OK && archive_write_data_block(ext, buff, size, offset) == ARCHIVE_OK);
+        }
+        ok = (archive_write_finish_entry(ext) == ARCHIVE_OK) && ok;
+        archive_write_free(ext);
+        return ok;
+    }
+
+    short extractAt(const ArchiveIndexEntry& entry, const QString& destination)
+    {
+        QFile File(Archive);
+        if(!File.open(QIODevice::ReadOnly) || !File.seek(entry.offset)) {
+            return ARCHIVE_READ_ERROR;
+        }
+
+        struct archive *arch = archive_read_new();
+        if(indexSeek == ZIP_INDEX_SEEK) {
+            archive_read_support_format_zip_streamable(arch);
+        } else {
+            archive_read_support_format_tar(arch);
+        }
+        ArchiveWindow Window = { &File, QByteArray(blockSize, Qt::Uninitialized) };
+        struct archive_entry *header;
+        short result = ARCHIVE_READ_ERROR;
+        if(archive_read_open(arch, &Window, NULL, readArchiveWindow, NULL) == ARCHIVE_OK &&
+           archive_read_next_header(arch, &header) == ARCHIVE_OK &&
+           QString::fromUtf8(archive_entry_pathname(header)) == entry.path) {
+            result = writeEntry(arch, header, destination) ? NO_ARCHIVE_ERROR : ARCHIVE_UNCAUGHT_ERROR;
+        }
+        archive_read_free(arch);
+        return result;
+    }
+
+    short extractByScan(QSet<QString> *wanted, const QString& destination)
+    {
+        struct archive *arch = archive_read_new();
+        archive_read_support_format_all(arch);
+        archive_read_support_filter_all(arch);
+
+        QFile ArchiveFile(Archive);
+        if(openArchiveFile(arch, &ArchiveFile, blockSize, memoryMapping)) {
+            archive_read_free(arch);
+            return ARCHIVE_READ_ERROR;
+        }
+
+        struct archive_entry *entry;
+        short result = NO_ARCHIVE_ERROR;
+        while(!wanted->isEmpty()) {
+            int ret = archive_read_next_header(arch, &entry);
+            if(ret == ARCHIVE_EOF) {
+                break;
+            }
+            if(ret != ARCHIVE_OK) {
+                result = ARCHIVE_QUALITY_ERROR;
+                break;
+            }
+
+            QString Path = QString::fromUtf8(archive_entry_pathname(entry));
+            if(!wanted->contains(Path)) {
+                archive_read_data_skip(arch); // No decompression for seekable formats.
+                continue;
+            }
+            if(!writeEntry(arch, entry, destination)) {
+                result = ARCHIVE_UNCAUGHT_ERROR;
+                break;
+            }
+            wanted->remove(Path);
+        }
+        archive_read_free(arch);
+        return result;
+    }
 signals:
     void stopped(void);
     void archiveFiles(const QString&, const QStringList&);
@@ -908,9 +3687,24 @@ signals:
 private:
     bool stopReader = false;
     QMutex mutex;
-    QString Archive;
+    QString Archive,
+            indexCache;
+    QByteArray archiveDigest;
     QStringList Files;
+    QVector<ArchiveIndexEntry> Entries;
     QFuture<void> *Promise = nullptr;
+    int blockSize = 1048576; // 1 MiB
+    bool memoryMapping = true,
+         indexCached = false;
+
+    enum {
+        NO_INDEX_SEEK,
+        ZIP_INDEX_SEEK,
+        TAR_INDEX_SEEK
+    };
+    int indexSeek = NO_INDEX_SEEK;
+    static const quint32 IndexMagic = 0x51415443; // "QATC"
+    static const quint16 IndexVersion = 1;
 }; // Class Reader Ends
 
 } // QArchive Namespace Ends.
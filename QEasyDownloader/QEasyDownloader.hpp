@@ -43,6 +43,7 @@
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QNetworkReply>
+#include <atomic>
 
 #define NONEED(x) (void)x
 
@@ -69,6 +70,14 @@
  * 	void setTimeoutTime(int) - sets the timeout time (in miliseconds) for a request! default is 5000 = 5 secs
  * 	void setRetryTime(int)   - sets the retry time (in miliseconds) for a request! default is 6000 = 6 secs
  *
+ *  Static Methods:
+ *	void setInstrumentation(const Instrumentation*) - Hooks every downloader reports the spans and
+ *							  the metrics of its probes and transfers to , NULL
+ *							  (the default) for none. QInstallerBridge points
+ *							  them at QInstallerBridgeTrace and
+ *							  QInstallerBridgeMetrics , the hooks have to
+ *							  outlive every downloader.
+ *
  *  Private Slots:
  *	void download() - Starts the download with the current pointer _URL and _qsFileName
  *	void finishedHead() - Checks if the source has partial download.
@@ -80,6 +89,13 @@
  *  Public Slots:
  *	void Download(const QString& , const QString&) - Download a file and save it in the location provided.
  *	void Download(const QString&) - Simply download a file.
+ *	void DownloadFirst(const QString& , const QString&) - Same as Download but puts the file at the front of the queue ,
+ *							     so it is the very next download.
+ *	void Download(const QString& , QIODevice*)	   - Download straight into a opened device instead of a file ,
+ *	void DownloadFirst(const QString& , QIODevice*)	     the device's objectName() is used as the fileName in the
+ *							     signals. The device is closed when the download finishes.
+ *							     A device always starts from the beginning , there is no
+ *							     old file to resume from.
  *	void Pause() - Pause the current download.
  *	void Resume() - Resume any paused download.
  *
@@ -108,8 +124,43 @@ class QEasyDownloader : public QObject
 {
     Q_OBJECT
 public:
+    enum MetricCounter {
+        DOWNLOADED_BYTES_METRIC, // Bytes received.
+        RESUMED_BYTES_METRIC, // Bytes a partial download already had.
+        DOWNLOAD_RETRIES_METRIC,
+        DOWNLOAD_TIMEOUTS_METRIC,
+        DOWNLOAD_ERRORS_METRIC // Canceled requests are not counted.
+    };
+
+    enum MetricPhase {
+        PROBE_PHASE_METRIC,
+        TRANSFER_PHASE_METRIC
+    };
+
+    /*
+     * Structure Instrumentation
+     * -------------------------
+     *  traceBegin() begins a span and returns 0 if it is not recorded ,
+     *  traceEnd() is only called for a begin other than 0. The same for
+     *  metricNow() , which begins a timed phase , and metricObserve().
+    */
+    struct Instrumentation {
+        qint64 (*traceBegin)();
+        void (*traceEnd)(const char *phase, const QString& subject, qint64 begin, qint64 bytes);
+        qint64 (*metricNow)();
+        void (*metricAdd)(MetricCounter counter, qint64 value);
+        void (*metricObserve)(MetricPhase phase, qint64 begin);
+    };
+
+    static void setInstrumentation(const Instrumentation *hooks)
+    {
+        instrumentation().store(hooks, std::memory_order_release);
+        return;
+    }
+
     explicit QEasyDownloader(QObject *parent = NULL, QNetworkAccessManager *toUseManager = NULL)
-        : QObject(parent)
+        : QObject(parent),
+          _Timer(this) // Parented so that it follows us on moveToThread.
     {
         _pManager = (toUseManager == NULL) ? new QNetworkAccessManager(this) : toUseManager;
         _pManager->setRedirectPolicy(QNetworkRequest::NoLessSafeRedirectPolicy);
@@ -165,6 +216,8 @@ private slots:
             _CurrentRequest.setRawHeader("Range", rangeHeaderValue);
         }
 
+        _nTraceBegin = traceBegin();
+        _nMetricBegin = metricNow();
         _pCurrentReply = _pManager->get(_CurrentRequest);
 
         _Timer.setInterval(_TimeoutTime);
@@ -197,6 +250,11 @@ private slots:
         _Timer.stop();
         _bAcceptRanges = false;
 
+        // Connecting , TLS and the first byte , the reply does not tell them apart.
+        traceEnd("probe", _nTraceBegin, 0);
+        metricObserve(PROBE_PHASE_METRIC, _nMetricBegin);
+        _nTraceBegin = _nMetricBegin = 0;
+
 
         _nDownloadTotal = bytesTotal; // less expensive than parsing the content length header.
         if(_pCurrentReply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt() >= 400) {
@@ -229,20 +287,28 @@ private slots:
          */
         _CurrentRequest.setRawHeader("Connection", "Keep-Alive");
         _CurrentRequest.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
-        _pFile = new QFile(_qsFileName);
 
-        /*
-         * Check if we want to delete the old file.
-        */
-        if (!_bAcceptRanges) {
-            _pFile->remove();
-        }
-        if(!doResumeDownloads) {
-            _pFile->remove();
-        }
+        if(_Devices.contains(_qsFileName)) {
+            _pFile = _Devices.value(_qsFileName);
+            _nDownloadSizeAtPause = 0;
+        } else {
+            QFile *File = new QFile(_qsFileName);
 
-        _pFile->open(QIODevice::ReadWrite | QIODevice::Append);
-        _nDownloadSizeAtPause = _pFile->size();
+            /*
+             * Check if we want to delete the old file.
+            */
+            if (!_bAcceptRanges) {
+                File->remove();
+            }
+            if(!doResumeDownloads) {
+                File->remove();
+            }
+
+            File->open(QIODevice::ReadWrite | QIODevice::Append);
+            _nDownloadSizeAtPause = File->size();
+            _pFile = File;
+            metricAdd(RESUMED_BYTES_METRIC, _nDownloadSizeAtPause);
+        }
 
         /*
          * If the total download size and download size at pause
@@ -267,8 +333,16 @@ private slots:
         if(doDebug) {
             qDebug() << "QEasyDownloader::Finishing Download!";
         }
+        const qint64 Received = qMax<qint64>(0, _nDownloadSize - _nDownloadSizeAtPause);
+        traceEnd("transfer", _nTraceBegin, Received);
+        metricAdd(DOWNLOADED_BYTES_METRIC, Received);
+        metricObserve(TRANSFER_PHASE_METRIC, _nMetricBegin);
+        _nTraceBegin = _nMetricBegin = 0;
         _Timer.stop();
         _pFile->close();
+        if(_Devices.remove(_qsFileName) == 0) {
+            delete _pFile; // Only the files are ours.
+        }
         _pFile = NULL;
         _pCurrentReply = 0;
 
@@ -372,6 +446,8 @@ private slots:
          * and abort it in a very short time. Getting all the information
          * like HEAD but having the advantages of GET.
         */
+        _nTraceBegin = traceBegin();
+        _nMetricBegin = metricNow();
         _pCurrentReply = _pManager->get(_CurrentRequest);
 
         _Timer.setInterval(_TimeoutTime);
@@ -395,6 +471,7 @@ private slots:
         }
 
         isError = true;
+        metricAdd(DOWNLOAD_ERRORS_METRIC, 1);
         if(doDebug) {
             qDebug() << "QEasyDownloader::error::" << errorCode;
         }
@@ -404,6 +481,7 @@ private slots:
 
     void timeout()
     {
+        metricAdd(DOWNLOAD_TIMEOUTS_METRIC, 1);
         if(doDebug) {
             qDebug() << "QEasyDownloader::timeout";
         }
@@ -441,6 +519,40 @@ public slots:
         return;
     }
 
+    void DownloadFirst(const QString& givenURL, const QString& fileName)
+    {
+
+        if(doDebug) {
+            qDebug() << "QEasyDownloader::Added to Front of Queue:: " << givenURL << " :: " << fileName;
+        }
+
+        QStringList DownloadInformation;
+        DownloadInformation << givenURL << fileName;
+        downloadQueue.prepend(DownloadInformation);
+
+        if(NewDownload) {
+            NewDownload = false;
+            emit(startNextDownload());
+        }
+        return;
+    }
+
+    void Download(const QString& givenURL, QIODevice *device)
+    {
+        QString fileName = device->objectName().isEmpty() ? saveFileName(givenURL) : device->objectName();
+        _Devices.insert(fileName, device);
+        Download(givenURL, fileName);
+        return;
+    }
+
+    void DownloadFirst(const QString& givenURL, QIODevice *device)
+    {
+        QString fileName = device->objectName().isEmpty() ? saveFileName(givenURL) : device->objectName();
+        _Devices.insert(fileName, device);
+        DownloadFirst(givenURL, fileName);
+        return;
+    }
+
     void Download(const QString& givenURL)
     {
         Download(givenURL, saveFileName(givenURL));
@@ -466,7 +578,13 @@ public slots:
         disconnect(_pCurrentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(error(QNetworkReply::NetworkError)));
 
         _pCurrentReply->abort();
-        _pFile->flush();
+        if(QFile *File = qobject_cast<QFile*>(_pFile)) {
+            File->flush();
+        }
+        const qint64 Received = qMax<qint64>(0, _nDownloadSize - _nDownloadSizeAtPause);
+        traceEnd("transfer", _nTraceBegin, Received);
+        metricAdd(DOWNLOADED_BYTES_METRIC, Received);
+        _nTraceBegin = _nMetricBegin = 0; // A paused transfer is no latency.
         _pCurrentReply = 0;
         _nDownloadSizeAtPause = _nDownloadSize;
         _nDownloadSize = 0;
@@ -486,6 +604,7 @@ public slots:
             qDebug() << "QEasyDownloader::Download Resumed :: " << _URL  << " :: " << _qsFileName;
         }
         StopDownload = false;
+        metricAdd(DOWNLOAD_RETRIES_METRIC, 1);
         download();
         return;
     }
@@ -571,11 +690,58 @@ signals:
     void GetResponse(const QString &content);
 
 private:
+    static std::atomic<const Instrumentation*> &instrumentation()
+    {
+        static std::atomic<const Instrumentation*> Hooks(nullptr);
+        return Hooks;
+    }
+
+    static qint64 traceBegin()
+    {
+        const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+        return (Hooks != NULL && Hooks->traceBegin != NULL) ? Hooks->traceBegin() : 0;
+    }
+
+    // The url is only turned into a subject if the span was begun.
+    void traceEnd(const char *phase, qint64 begin, qint64 bytes)
+    {
+        const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+        if(begin != 0 && Hooks != NULL && Hooks->traceEnd != NULL) {
+            Hooks->traceEnd(phase, _URL.path(), begin, bytes);
+        }
+        return;
+    }
+
+    static qint64 metricNow()
+    {
+        const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+        return (Hooks != NULL && Hooks->metricNow != NULL) ? Hooks->metricNow() : 0;
+    }
+
+    static void metricAdd(MetricCounter counter, qint64 value)
+    {
+        const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+        if(Hooks != NULL && Hooks->metricAdd != NULL) {
+            Hooks->metricAdd(counter, value);
+        }
+        return;
+    }
+
+    static void metricObserve(MetricPhase phase, qint64 begin)
+    {
+        const Instrumentation *Hooks = instrumentation().load(std::memory_order_acquire);
+        if(begin != 0 && Hooks != NULL && Hooks->metricObserve != NULL) {
+            Hooks->metricObserve(phase, begin);
+        }
+        return;
+    }
+
     QNetworkAccessManager    *_pManager = NULL;
     QNetworkRequest           _CurrentRequest;
     QNetworkReply            *_pCurrentReply = NULL,
                               *_pCurrentGetReply = NULL;
-    QFile		     *_pFile = NULL;
+    QIODevice		     *_pFile = NULL;
+    QHash<QString, QIODevice*> _Devices;
 
     QTimer _Timer;
     QTime  downloadSpeed;
@@ -589,6 +755,8 @@ private:
         _DownloadedCount = 0,
         _TimeoutTime = 5000,
         _RetryTime = 6000;
+    qint64 _nTraceBegin = 0, // Of the probe or the transfer , 0 if not traced.
+           _nMetricBegin = 0;
     bool _bAcceptRanges = false,
          StopDownload = false,
          isError = false,
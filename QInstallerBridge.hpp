@@ -45,8 +45,27 @@
 #include <QTemporaryFile>
 #include <QDomDocument>
 #include <QDomElement>
+#include "QInstallerBridgeTrace.hpp"
+#include "QInstallerBridgeMetrics.hpp"
+#include "QInstallerBridgeMetricsEndpoint.hpp"
 #include "QArchive/QArchive.hpp"
 #include "QEasyDownloader/QEasyDownloader.hpp"
+#include "QInstallerBridgeDelta.hpp"
+
+#if defined(Q_OS_UNIX)
+extern "C" {
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+}
+#endif
+#if defined(Q_OS_LINUX)
+#include <sys/syscall.h>
+#if !defined(RENAME_EXCHANGE)
+#define RENAME_EXCHANGE (1 << 1)
+#endif
+#endif
 
 #define NONEED(x) (void)x
 
@@ -77,24 +96,103 @@
  *	void setRepoLink(const QString&) 	  - Assigns (1) repoLink.
  *	void setComponentsXML(const QString&)	  - Assigns (2) componentsXML.
  *	void setDebug(bool)			  - Assigns or sets (3) Debug.
+ *	void setMaxParallelInstalls(int)	  - Sets how many packages can be extracted at the same time ,
+ *						    default is QThread::idealThreadCount(). Packages which
+ *						    write the same file are extracted one after another.
+ *	void setStreamingInstall(bool)		  - If true , tar and cpio archives are extracted while they
+ *						    are downloaded into a staging directory under the
+ *						    installation path , no archive is written to the disk.
+ *						    The staged files are moved in place by InstallUpdates()
+ *						    only if the SHA1 of the stream matched. Only used with
+ *						    moveToWorkerThread() , the downloader waits while the
+ *						    extractor is behind. Default is false.
+ *	void setAtomicInstall(bool)		  - If true , InstallUpdates() works on a hard linked copy of
+ *						    the installation path ({path}.next) and swaps it with the
+ *						    installation path in one rename when everything is done.
+ *						    The old tree is kept as {path}.previous. While it exists
+ *						    every install unlinks a file before writing it , the
+ *						    trees share their files. Default is false.
+ *	void setSkipUnchangedFiles(bool)	  - If true , files which are installed with the same content
+ *						    are not written again. Default is false.
+ *	void setWriteManifests(bool)		  - If true , InstallUpdates() writes a binary manifest for every
+ *						    package (path , size , mtime and SHA1 of every file) to
+ *						    .QInstallerBridgeManifests in the installation path.
+ *						    Default is false.
+ *	void setDeltaUpdates(bool)		  - If true (default) a package whose installed version is the
+ *						    base of its DeltaArchives downloads the deltas instead of
+ *						    the full archives. The deltas are applied against the
+ *						    installation path into a staging directory while the
+ *						    downloads go on , any mismatch falls back to the full
+ *						    archives of that package. updatesDownloaded() waits
+ *						    for the last apply.
+ *	void setPackageFilter(const QString& ,
+ *			      const QStringList& ,
+ *			      const QStringList&)	  - Only installs the files of the package which match one of
+ *						    the include globs (all if empty) and none of the exclude
+ *						    globs , like "*.qm" or "*.debug".
+ *	void setPackageFilter(const QString& ,
+ *			      const QArchive::EntryFilter&) - The same with prefixes or a predicate.
+ *	void clearPackageFilters()		  - Installs every package in full again.
+ *	void setPerFileStatus(bool)		  - If true , updatesInstalling() is emitted for every installed
+ *						    file. Else (default) it is emitted with the latest file of
+ *						    every updatesInstallProgress() batch.
+ *	void setTracing(bool)			  - If true , the phases of every package (check , XML sync ,
+ *						    probe , transfer , verify , delta apply , extract , commit ,
+ *						    XML merge) are recorded as spans , see
+ *						    QInstallerBridgeTrace.hpp. The new spans are emitted with
+ *						    traceSpans() before updatesList() , updatesDownloaded()
+ *						    and updatesInstalled(). The ring is shared by the process ,
+ *						    it records while any bridge traces. Default is false.
+ *	bool exportTrace(const QString&)	  - Writes the spans in the ring as Chrome trace events ,
+ *						    returns false if the file cannot be written.
  *
  *	const QString &getRepoLink(void)	  - Gets (1) repoLink.
  *	const QString &getComponentsXML(void)  	  - Gets (2) componentsXML.
  *	bool  isDebug(void)			  - Returns True or False from (3) Debug.
+ *	int   getMaxParallelInstalls(void)	  - Gets the number of packages extracted at the same time.
+ *	bool  isStreamingInstall(void)		  - Returns True if streaming install is set.
+ *	bool  isAtomicInstall(void)		  - Returns True if atomic install is set.
+ *	bool  isSkipUnchangedFiles(void)	  - Returns True if unchanged files are skipped.
+ *	bool  isWriteManifests(void)		  - Returns True if manifests are written.
+ *	bool  isDeltaUpdates(void)		  - Returns True if delta updates are used.
+ *	bool  isPerFileStatus(void)		  - Returns True if updatesInstalling() is emitted for every file.
+ *	bool  isTracing(void)			  - Returns True if the phases are traced.
+ *
+ *	bool  moveToWorkerThread(void)		  - Moves the bridge , its downloader and its extractors to
+ *						    a QThread owned by the bridge. Network , XML parsing and
+ *						    hashing then never run on the caller's thread. Returns
+ *						    false if the bridge has a parent or uses a given
+ *						    QNetworkAccessManager.
+ *	bool  isOnWorkerThread(void)		  - Returns True if the bridge runs on its own thread.
+ *
+ *	Note: The counters and latency histograms of every bridge in the process are in
+ *	      QInstallerBridgeMetrics , with a Prometheus text export and a scrape endpoint.
+ *
+ *	Note: All setters and public slots can be called from any thread , they are posted
+ *	      to the thread of the bridge. Signals are delivered queued to the receivers
+ *	      living in other threads. Getters should only be used when the bridge is idle.
  *
  * Private Slots:
  * 	void RepoSync(const QString&)                       - This slot is connected to the signal of
  * 						       	      QEasyDownloader::DownloadFinished
  * 						              Downloads Updates.xml from the remote
  * 						              repo and checks for new update.
+ * 						              Dependencies which are not installed are
+ * 						              pulled in and the updates are sorted so that
+ * 						              a package comes after its dependencies.
  * 						              If found updatesList(const QStringList&) is
  * 						              emitted.
  *
- * 	void VerifyAndMergeRepo(const QString&)            - This slot is connect to the signal of
+ * 	void FinishUpdateDownload(const QUrl&,
+ * 				  const QString&)           - This slot is connected to the signal of
  * 							      QEasyDownloader::DownloadFinished
- * 							      Downloads {Version}meta.7z from the
- * 							      remote repo and checks the SHA1 sum of
- * 							      the {Version}meta.7z.
+ * 							      Dispatches a finished download either to
+ * 							      the {Version}meta.7z verification or to the
+ * 							      archive verification.
+ *
+ * 	void VerifyPackageChecksums(const QUrl&,
+ * 				    const QString&)         - Checks the SHA1 sum of a {Version}meta.7z and
+ * 							      queues the archives of that package right away.
  *
  * 	void RepoMergeXML(const QString& , const QString&)  - Sets the new version for the respective package.
  *
@@ -106,7 +204,9 @@
  * 	void CheckForUpdates()	- Checks for updates and if found then emits a signal.
  * 	void DownloadUpdates()	- Downloads the entried updates by (1) CheckForUpdates.
  * 	void InstallUpdates()	- Installs the content cached by (2) DownloadUpdates
- * 				  from the remote repo.
+ * 				  from the remote repo. Packages which do not depend on
+ * 				  each other are extracted at the same time , a package
+ * 				  is only installed after all its dependencies.
  *
  * 	Note: The Above slots must be called in sequence , only execute the next slot once
  * 	      You know that the previous or the current slot emits a positive signal!
@@ -114,6 +214,10 @@
  *
  * 	void AbortDownload() - Cancel Downloading Updates.
  * 	void AbortInstallation() - Cancel Installation.
+ * 	void RollbackInstallation() - Swaps the installation path with the tree kept by the last
+ * 				      atomic install , calling it again undoes the rollback.
+ * 	void VerifyInstallation() - Checks the installation path against the manifests on all cores.
+ * 				    Only files whose size or mtime changed are hashed again.
  *
  * Signals:
  *
@@ -132,10 +236,23 @@
  *      void updateDownloaded(const QUrl&, const QString&) - Emitted when a single update is downloaded.
  *      void updatesDownloaded() - Emitted when all updates are downloaded.
  *      void updatesInstalling(const QString&) - Emitted when a package is beign installed.
+ *      void updatesInstallProgress(const QString& package,
+ *                                  qint64 files,
+ *                                  qint64 bytes,
+ *                                  const QStringList& latestFiles) - Emitted at most every 100 msecs per
+ *                                                         package with the files and bytes done so far.
+ *      void updatesWriteStatistics(qint64 bytesWritten,
+ *                                  qint64 bytesSkipped) - Emitted right before updatesInstalled() with the
+ *                                                         bytes of files written and skipped as unchanged.
  *      void updatesInstalled() - Emitted when all updates get installed , this will be our endpoint!
  *
  * 	void DownloadAborted()  - Emitted when AbortDownload() is successfull.
  * 	void InstallationAborted() - Emitted when AbortInstallation() is successfull.
+ * 	void InstallationRolledBack() - Emitted when RollbackInstallation() is successfull.
+ * 	void installationVerified(const QStringList&) - Emitted by VerifyInstallation() with the files which
+ * 							are missing or damaged , empty if all is well.
+ * 	void traceSpans(const QVector<QInstallerBridgeTrace::Span>&) - The spans recorded since the last
+ * 							one , only with setTracing(true).
  *
 */
 class QInstallerBridge : public QObject
@@ -154,6 +271,9 @@ public:
         QString Version;
         QString DownloadableArchives;
         QString SHA1;
+        QString Dependencies;
+        QString DeltaArchives;
+        QString DeltaBaseVersion;
     } PackageUpdate;
 
     /*
@@ -167,13 +287,19 @@ public:
         UPDATES_XML_NOT_FOUND = -5,
         UPDATES_XML_SYNTAX_ERROR = -6,
         SHA1_KEY_MISMATCH = -7,
-        UNKNOWN_ERROR = -8
+        UNKNOWN_ERROR = -8,
+        DEPENDENCY_ERROR = -9,
+        INSTALL_COMMIT_ERROR = -10,
+        ROLLBACK_ERROR = -11
     };
 
     explicit QInstallerBridge(QObject *p = NULL, QNetworkAccessManager *toUse = NULL)
-        : QObject(p)
+        : QObject(p),
+          externalNetworkManager(toUse != NULL)
     {
-        DownloadManager = new QEasyDownloader(p, toUse);
+        registerMetaTypes();
+        installInstrumentation();
+        DownloadManager = new QEasyDownloader(this, toUse);
         return;
     }
     explicit QInstallerBridge(const QString& repoLink,
@@ -186,16 +312,26 @@ public:
           componentsXML(componentsXML),
           installationPath(installPath)
     {
-        DownloadManager = new QEasyDownloader;
+        registerMetaTypes();
+        installInstrumentation();
+        DownloadManager = new QEasyDownloader(this);
         showConfiguration();
         return;
     }
 
-    void setConfiguration(const QString& repoLink,
-                          const QString& componentsXML,
-                          const QString& installPath,
-                          bool debug)
+    Q_INVOKABLE void setConfiguration(const QString& repoLink,
+                                      const QString& componentsXML,
+                                      const QString& installPath,
+                                      bool debug)
     {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setConfiguration", Qt::QueuedConnection,
+                                      Q_ARG(QString, repoLink),
+                                      Q_ARG(QString, componentsXML),
+                                      Q_ARG(QString, installPath),
+                                      Q_ARG(bool, debug));
+            return;
+        }
         this->debug = debug;
         this->repoLink = repoLink;
         this->componentsXML = componentsXML;
@@ -218,26 +354,42 @@ public:
         return;
     }
 
-    void setRepoLink(const QString& repoLink)
+    Q_INVOKABLE void setRepoLink(const QString& repoLink)
     {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setRepoLink", Qt::QueuedConnection, Q_ARG(QString, repoLink));
+            return;
+        }
         this->repoLink = repoLink;
         return;
     }
 
-    void setComponentsXML(const QString& componentsXML)
+    Q_INVOKABLE void setComponentsXML(const QString& componentsXML)
     {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setComponentsXML", Qt::QueuedConnection, Q_ARG(QString, componentsXML));
+            return;
+        }
         this->componentsXML = componentsXML;
         return;
     }
 
-    void setInstallationPath(const QString& installPath)
+    Q_INVOKABLE void setInstallationPath(const QString& installPath)
     {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setInstallationPath", Qt::QueuedConnection, Q_ARG(QString, installPath));
+            return;
+        }
         this->installationPath = installPath;
         return;
     }
 
-    void setDebug(bool ch)
+    Q_INVOKABLE void setDebug(bool ch)
     {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setDebug", Qt::QueuedConnection, Q_ARG(bool, ch));
+            return;
+        }
         this->debug = ch;
         return;
     }
@@ -247,6 +399,210 @@ public:
         return debug;
     }
 
+    Q_INVOKABLE void setMaxParallelInstalls(int count)
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setMaxParallelInstalls", Qt::QueuedConnection, Q_ARG(int, count));
+            return;
+        }
+        this->maxParallelInstalls = (count < 1) ? 1 : count;
+        return;
+    }
+
+    int getMaxParallelInstalls()
+    {
+        return maxParallelInstalls;
+    }
+
+    Q_INVOKABLE void setStreamingInstall(bool ch)
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setStreamingInstall", Qt::QueuedConnection, Q_ARG(bool, ch));
+            return;
+        }
+        this->streamingInstall = ch;
+        return;
+    }
+
+    bool isStreamingInstall()
+    {
+        return streamingInstall;
+    }
+
+    Q_INVOKABLE void setAtomicInstall(bool ch)
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setAtomicInstall", Qt::QueuedConnection, Q_ARG(bool, ch));
+            return;
+        }
+        this->atomicInstall = ch;
+        return;
+    }
+
+    bool isAtomicInstall()
+    {
+        return atomicInstall;
+    }
+
+    Q_INVOKABLE void setSkipUnchangedFiles(bool ch)
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setSkipUnchangedFiles", Qt::QueuedConnection, Q_ARG(bool, ch));
+            return;
+        }
+        this->skipUnchangedFiles = ch;
+        return;
+    }
+
+    bool isSkipUnchangedFiles()
+    {
+        return skipUnchangedFiles;
+    }
+
+    Q_INVOKABLE void setWriteManifests(bool ch)
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setWriteManifests", Qt::QueuedConnection, Q_ARG(bool, ch));
+            return;
+        }
+        this->writeManifests = ch;
+        return;
+    }
+
+    bool isWriteManifests()
+    {
+        return writeManifests;
+    }
+
+    Q_INVOKABLE void setDeltaUpdates(bool ch)
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setDeltaUpdates", Qt::QueuedConnection, Q_ARG(bool, ch));
+            return;
+        }
+        this->deltaUpdates = ch;
+        return;
+    }
+
+    bool isDeltaUpdates()
+    {
+        return deltaUpdates;
+    }
+
+    Q_INVOKABLE void setPackageFilter(const QString& package, const QStringList& include, const QStringList& exclude)
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setPackageFilter", Qt::QueuedConnection, Q_ARG(QString, package),
+                                      Q_ARG(QStringList, include), Q_ARG(QStringList, exclude));
+            return;
+        }
+        QArchive::EntryFilter Filter;
+        for(int glob = 0; glob < include.size() ; ++glob) {
+            Filter.include(include.at(glob));
+        }
+        for(int glob = 0; glob < exclude.size() ; ++glob) {
+            Filter.exclude(exclude.at(glob));
+        }
+        setPackageFilter(package, Filter);
+        return;
+    }
+
+    /*
+     * Not posted , a predicate may not be safe to copy across threads.
+     * Call it before CheckForUpdates() or from the bridge's thread.
+    */
+    void setPackageFilter(const QString& package, const QArchive::EntryFilter& filter)
+    {
+        if(filter.isEmpty()) {
+            PackageFilters.remove(package);
+            return;
+        }
+        PackageFilters.insert(package, filter);
+        return;
+    }
+
+    Q_INVOKABLE void clearPackageFilters()
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "clearPackageFilters", Qt::QueuedConnection);
+            return;
+        }
+        PackageFilters.clear();
+        return;
+    }
+
+    Q_INVOKABLE void setPerFileStatus(bool ch)
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setPerFileStatus", Qt::QueuedConnection, Q_ARG(bool, ch));
+            return;
+        }
+        this->perFileStatus = ch;
+        return;
+    }
+
+    bool isPerFileStatus()
+    {
+        return perFileStatus;
+    }
+
+    Q_INVOKABLE void setTracing(bool ch)
+    {
+        if(isForeignThread()) {
+            QMetaObject::invokeMethod(this, "setTracing", Qt::QueuedConnection, Q_ARG(bool, ch));
+            return;
+        }
+        if(ch == tracing) {
+            return; // Counted once per bridge.
+        }
+        if(ch) {
+            TraceCursor = QInstallerBridgeTrace::position(); // Only ours from now on.
+        }
+        this->tracing = ch;
+        QInstallerBridgeTrace::setEnabled(ch);
+        return;
+    }
+
+    bool isTracing()
+    {
+        return tracing;
+    }
+
+    bool exportTrace(const QString& fileName)
+    {
+        return QInstallerBridgeTrace::exportChromeTrace(fileName);
+    }
+
+    bool moveToWorkerThread()
+    {
+        if(WorkerThread != NULL) {
+            return true;
+        }
+
+        /*
+         * A parented object cannot change its thread and a given
+         * QNetworkAccessManager stays with its own thread.
+        */
+        if(parent() != NULL || externalNetworkManager || isForeignThread()) {
+            return false;
+        }
+
+        WorkerThread = new QThread;
+        WorkerThread->setObjectName("QInstallerBridge");
+        moveToThread(WorkerThread);
+        WorkerThread->start();
+
+        if(debug) {
+            qDebug() << "QInstallerBridge::Running on Worker Thread!";
+        }
+        return true;
+    }
+
+    bool isOnWorkerThread()
+    {
+        return (WorkerThread != NULL);
+    }
+
     const QString &getRepoLink()
     {
         return repoLink;
@@ -264,16 +620,102 @@ public:
 
     ~QInstallerBridge()
     {
+        if(WorkerThread != NULL) {
+            if(QThread::currentThread() == WorkerThread) {
+                connect(WorkerThread, &QThread::finished, WorkerThread, &QObject::deleteLater);
+                WorkerThread->quit();
+            } else {
+                /*
+                 * Come back to the thread that deletes us , everything
+                 * below is then torn down like a single threaded bridge.
+                */
+                QMetaObject::invokeMethod(this, "ReturnToThread", Qt::BlockingQueuedConnection,
+                                          Q_ARG(QThread*, QThread::currentThread()));
+                WorkerThread->quit();
+                WorkerThread->wait();
+                delete WorkerThread;
+            }
+            WorkerThread = NULL;
+        }
+
+        /*
+         * A stream extractor waits for data that will never come now ,
+         * wake it up and let it go before its stream is deleted.
+        */
+        AbortArchiveStreams();
+        qDeleteAll(StreamWorkers);
+        StreamWorkers.clear();
         FreeTemporaryFiles();
-        DownloadManager->deleteLater();
+        if(tracing) {
+            QInstallerBridgeTrace::setEnabled(false);
+        }
     }
 
 private slots:
+    bool isForeignThread()
+    {
+        return (QThread::currentThread() != thread());
+    }
+
+    /*
+     * Calls from other threads are posted to the thread we live in ,
+     * so only one thread ever touches the bridge.
+    */
+    bool postToOwnerThread(const char *method)
+    {
+        if(!isForeignThread()) {
+            return false;
+        }
+        QMetaObject::invokeMethod(this, method, Qt::QueuedConnection);
+        return true;
+    }
+
+    void ReturnToThread(QThread *target)
+    {
+        moveToThread(target);
+        return;
+    }
+
+    void EmitTraceSpans()
+    {
+        if(!tracing) {
+            return;
+        }
+        QVector<QInstallerBridgeTrace::Span> Spans = QInstallerBridgeTrace::spans(&TraceCursor);
+        if(!Spans.isEmpty()) {
+            emit traceSpans(Spans);
+        }
+        return;
+    }
 
     void FinishedDownloadingUpdates()
     {
-        disconnect(DownloadManager, &QEasyDownloader::DownloadFinished, this, &QInstallerBridge::FinishArchiveDownload);
+        if(!RunningDeltaApplies.isEmpty()) {
+            // A failed delta may still queue its full archives.
+            DeltaDownloadsIdle = true;
+            return;
+        }
+        disconnect(DownloadManager, &QEasyDownloader::GetResponse, this, &QInstallerBridge::VerifyArchiveChecksums);
+        disconnect(DownloadManager, &QEasyDownloader::DownloadFinished, this, &QInstallerBridge::FinishUpdateDownload);
+        disconnect(DownloadManager, &QEasyDownloader::DownloadProgress, this, &QInstallerBridge::ProxyDownloadProgress);
         disconnect(DownloadManager, &QEasyDownloader::Finished, this, &QInstallerBridge::FinishedDownloadingUpdates);
+        DownloadsFinished = true;
+        CheckDownloadsFinished();
+        return;
+    }
+
+    /*
+     * The last bytes of a stream may still be extracted when the
+     * downloader is done , updatesDownloaded() waits for them.
+    */
+    void CheckDownloadsFinished()
+    {
+        if(!DownloadsFinished || !StreamWorkers.isEmpty() || StreamFailed) {
+            return;
+        }
+        DownloadsFinished = false;
+        QIB_TRACE_END("download", repoLink, DownloadTraceBegin, 0);
+        EmitTraceSpans();
         emit(updatesDownloaded());
         return;
     }
@@ -292,16 +734,24 @@ private slots:
 
     void VerifyArchiveChecksums(const QString &RepoArchiveChecksum)
     {
-
-        QFile LocalArchive(CurrentCheckFile);
-        if(LocalArchive.open(QIODevice::ReadOnly)) {
-            QString LocalArchiveChecksum = QCryptographicHash::hash(LocalArchive.readAll(), QCryptographicHash::Sha1).toHex();
-
+        QString LocalArchiveChecksum;
+        if(archiveChecksum(CurrentCheckFile, &LocalArchiveChecksum)) {
+            if(DeltaArchiveFiles.contains(CurrentCheckFile)) {
+                VerifyDeltaArchive(CurrentCheckFile, LocalArchiveChecksum == RepoArchiveChecksum);
+                return;
+            }
             if(LocalArchiveChecksum != RepoArchiveChecksum) {
                 /*
                  * Failed to prove integrity!
+                 * The staged files of a stream are never committed.
                  * emit error and die.
                 */
+                QIB_METRIC_ADD(CHECKSUM_FAILURES, 1);
+                if(ArchiveStreams.contains(CurrentCheckFile)) {
+                    StreamFailed = true;
+                    StagedPackageTrees.remove(StreamPackages.value(CurrentCheckFile));
+                    ArchiveStreams.value(CurrentCheckFile)->abort();
+                }
                 emit error(SHA1_KEY_MISMATCH, CurrentCheckFile);
                 return;
             }
@@ -317,119 +767,540 @@ private slots:
             emit error(TEMP_FILE_OPEN_ERROR, CurrentCheckFile);
         }
         return;
-
-        return;
     }
 
     void FinishArchiveDownload(const QUrl &url, const QString &file)
     {
         QUrl ChecksumURL = QUrl(QString(url.toEncoded().data()) + ".sha1");
         CurrentCheckFile = file;
+        StartStreamExtraction(file); // In case not a single byte came.
         DownloadManager->Get(ChecksumURL);
         emit updateDownloaded(url, file);
         return;
     }
 
-    void FinishedPackageVerifications()
+    void FinishUpdateDownload(const QUrl &url, const QString &file)
     {
-        FreeTemporaryFiles();
+        if(PendingMetaPackages.contains(url)) {
+            VerifyPackageChecksums(url, file);
+            return;
+        }
+        FinishArchiveDownload(url, file);
+        return;
+    }
 
-        disconnect(DownloadManager, &QEasyDownloader::DownloadFinished, this, &QInstallerBridge::VerifyPackageChecksums);
-        disconnect(DownloadManager, &QEasyDownloader::Finished, this, &QInstallerBridge::FinishedPackageVerifications);
-        connect(DownloadManager, &QEasyDownloader::DownloadFinished, this, &QInstallerBridge::FinishArchiveDownload);
-        connect(DownloadManager, &QEasyDownloader::Finished, this, &QInstallerBridge::FinishedDownloadingUpdates);
+    void VerifyPackageChecksums(const QUrl &url, const QString &file)
+    {
+        int item = PendingMetaPackages.take(url);
+        QString LocalMetaChecksum;
+        if(!fileChecksum(file, &LocalMetaChecksum)) {
+            emit error(TEMP_FILE_OPEN_ERROR, file);
+            return;
+        }
 
-        for(int item = 0; item < Updates.size() ; ++item) {
-            QStringList PackagesData = Updates
-                                       .at(item)
-                                       .DownloadableArchives
-                                       .split(",");
+        if(LocalMetaChecksum != Updates.at(item).SHA1) {
+            /*
+             * Failed to prove integrity!
+             * emit error and die.
+            */
+            QIB_METRIC_ADD(CHECKSUM_FAILURES, 1);
+            emit error(SHA1_KEY_MISMATCH, file);
+            return;
+        }
 
-            for(int dataItem = 0; dataItem < PackagesData.size() ; ++dataItem) {
-                QString ArchiveURL = repoLink
-                                     + "/"
-                                     + Updates.at(item).PackageName
-                                     + "/"
-                                     + Updates.at(item).Version
-                                     + PackagesData.at(dataItem);
-                auto TFile = new QTemporaryFile;
-                TFile->open();
-                CachedPackagesData << TFile->fileName();
-                DownloadManager->Download(ArchiveURL, TFile->fileName());
-                CachedTemporaryFiles.push_back(TFile);
-            }
+        // Integrity Proved. The meta is no longer needed.
+        if(debug) {
+            qDebug() << "QInstallerBridge::Integrity Proved : " << file;
         }
+        FreeTemporaryFile(file);
 
+        /*
+         * The archives of this package goes right in front of the
+         * queue , so they do not have to wait for the other metas.
+        */
+        QueueArchives(item);
+        DownloadManager->Next(); // Next Iteration.
+        return;
     }
 
-    void VerifyPackageChecksums(const QUrl &url, const QString &file)
+    void QueueArchives(int item)
     {
-        NONEED(url);
-        QFile LocalMeta(file);
-        if(LocalMeta.open(QIODevice::ReadOnly)) {
-            QString LocalMetaChecksum = QCryptographicHash::hash(LocalMeta.readAll(), QCryptographicHash::Sha1).toHex();
+        if(isDeltaUpdate(item)) {
+            QueueDeltaArchives(item);
+            return;
+        }
 
-            if(LocalMetaChecksum != Updates.at(buff).SHA1) {
-                /*
-                 * Failed to prove integrity!
-                 * emit error and die.
-                */
-                emit error(SHA1_KEY_MISMATCH, CurrentCheckFile);
-                return;
-            }
+        QStringList PackagesData = Updates
+                                   .at(item)
+                                   .DownloadableArchives
+                                   .split(",", QString::SkipEmptyParts);
+        QStringList ArchiveURLs,
+                    ArchiveFiles;
+
+        for(int dataItem = 0; dataItem < PackagesData.size() ; ++dataItem) {
+            QString ArchiveURL = repoLink
+                                 + "/"
+                                 + Updates.at(item).PackageName
+                                 + "/"
+                                 + Updates.at(item).Version
+                                 + PackagesData.at(dataItem).trimmed();
+            ArchiveURLs << ArchiveURL;
 
-            // Integrity Proved. So lets download the next package.
-            if(debug) {
-                qDebug() << "QInstallerBridge::Integrity Proved : " << file;
+            /*
+             * The downloader blocks in write() while a stream is full ,
+             * that must not be the caller's thread.
+            */
+            if(streamingInstall && WorkerThread != NULL && isStreamableArchive(ArchiveURL)) {
+                QString Stream = OpenArchiveStream(item, ArchiveURL);
+                if(!Stream.isEmpty()) {
+                    CachedPackagesData << Stream;
+                    ArchiveFiles << Stream;
+                    continue;
+                }
             }
 
-            buff += 1;
-            DownloadManager->Next(); // Next Iteration.
+            auto TFile = new QTemporaryFile;
+            TFile->open();
+            CachedPackagesData << TFile->fileName();
+            CachedPackageArchives[Updates.at(item).PackageName] << TFile->fileName();
+            CachedTemporaryFiles.push_back(TFile);
+            ArchiveFiles << TFile->fileName();
+        }
 
-        } else {
-            emit error(TEMP_FILE_OPEN_ERROR, file);
+        // Prepending reverses the order , so walk backwards.
+        for(int dataItem = ArchiveURLs.size() - 1; dataItem >= 0 ; --dataItem) {
+            DownloadArchive(ArchiveURLs.at(dataItem), ArchiveFiles.at(dataItem));
         }
         return;
     }
 
-    void RepoSync(const QString& resp)
+    /*
+     * A delta is only made against one version , and a package whose
+     * delta failed once takes the full archives.
+    */
+    bool isDeltaUpdate(int item)
     {
-        QXmlStreamReader XMLReader(resp);
-        QVector<PackageUpdate> RepoPackages;
-        PackageUpdate Package;
+        const PackageUpdate &Package = Updates.at(item);
+        return (deltaUpdates &&
+                !Package.DeltaArchives.trimmed().isEmpty() &&
+                !Package.DeltaBaseVersion.isEmpty() &&
+                InstalledVersions.value(Package.PackageName) == Package.DeltaBaseVersion &&
+                !FailedDeltaPackages.contains(Package.PackageName));
+    }
 
-        while (!XMLReader.atEnd() && !XMLReader.hasError()) {
-            XMLReader.readNext();
-            if (XMLReader.isStartElement()) {
-                QString Key = XMLReader.name().toString();
+    void QueueDeltaArchives(int item)
+    {
+        QStringList DeltaData = Updates
+                                .at(item)
+                                .DeltaArchives
+                                .split(",", QString::SkipEmptyParts);
+        QStringList ArchiveURLs,
+                    ArchiveFiles;
 
-                if(Key == "Name") {
-                    Package.PackageName = QString(XMLReader.readElementText());
-                } else if(Key == "Description") {
-                    Package.Description = QString(XMLReader.readElementText());
-                } else if(Key == "Changelog") {
-                    Package.Changelog = QString(XMLReader.readElementText());
-                } else if(Key == "Version") {
-                    Package.Version = QString(XMLReader.readElementText());
-                } else if(Key == "DownloadableArchives") {
-                    Package.DownloadableArchives = QString(XMLReader.readElementText());
-                } else if(Key == "SHA1") {
-                    Package.SHA1 = QString(XMLReader.readElementText());
-                    RepoPackages.push_back(Package);
-                }
-            }
+        if(debug) {
+            qDebug() << "QInstallerBridge::Using Delta Archives :: " << Updates.at(item).PackageName;
+        }
+        for(int dataItem = 0; dataItem < DeltaData.size() ; ++dataItem) {
+            ArchiveURLs << repoLink
+                        + "/"
+                        + Updates.at(item).PackageName
+                        + "/"
+                        + Updates.at(item).Version
+                        + DeltaData.at(dataItem).trimmed();
+
+            // Never extracted by InstallUpdates() , only its staged result is committed.
+            auto TFile = new QTemporaryFile;
+            TFile->open();
+            CachedPackagesData << TFile->fileName();
+            CachedTemporaryFiles.push_back(TFile);
+            DeltaArchiveFiles.insert(TFile->fileName(), item);
+            ArchiveFiles << TFile->fileName();
         }
 
-        if(XMLReader.hasError()) {
-            if(debug) {
-                qDebug() << "QInstallerBridge::UpdatesXML::Error::" << XMLReader.errorString();
-            }
-            emit error(UPDATES_XML_SYNTAX_ERROR, XMLReader.errorString());
-            return;
+        for(int dataItem = ArchiveURLs.size() - 1; dataItem >= 0 ; --dataItem) {
+            DownloadArchive(ArchiveURLs.at(dataItem), ArchiveFiles.at(dataItem));
         }
+        return;
+    }
 
-        QFile localComponents(componentsXML);
-        if(!localComponents.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    /*
+     * The downloader waits while a delta archive is applied , so the
+     * full archives can still go to the front of the queue if it fails.
+    */
+    void VerifyDeltaArchive(const QString& file, bool checksumMatched)
+    {
+        const int item = DeltaArchiveFiles.take(file);
+        const QString PackageName = Updates.at(item).PackageName;
+
+        if(!checksumMatched || FailedDeltaPackages.contains(PackageName)) {
+            if(!checksumMatched) {
+                QIB_METRIC_ADD(CHECKSUM_FAILURES, 1);
+            }
+            FallbackToFullArchives(item, file, false);
+            DownloadManager->Next(); // Next Iteration.
+            return;
+        }
+
+        if(debug) {
+            qDebug() << "QInstallerBridge::Integrity Proved : " << file;
+        }
+
+        const QString Staging = stagingRoot() + "/" + PackageName;
+        auto Watcher = new QFutureWatcher<short>(this);
+        auto Manifest = QSharedPointer<QVector<QArchive::ManifestEntry>>::create();
+        auto FailedPath = QSharedPointer<QString>::create();
+
+        connect(Watcher, &QFutureWatcher<short>::finished, this,
+        [this, Watcher, Manifest, FailedPath, item, file, Staging, PackageName]() {
+            short result = Watcher->result();
+            Watcher->deleteLater();
+            const bool LastApply = (--RunningDeltaApplies[PackageName] <= 0);
+            if(LastApply) {
+                RunningDeltaApplies.remove(PackageName);
+            }
+
+            if(!isTemporaryFile(file)) {
+                // AbortDownload() freed it , the downloads are over.
+                QDir(Staging).removeRecursively();
+                return;
+            }
+            if(result != QInstallerBridgeDelta::NO_DELTA_ERROR || FailedDeltaPackages.contains(PackageName)) {
+                if(debug && result != QInstallerBridgeDelta::NO_DELTA_ERROR) {
+                    qDebug() << "QInstallerBridge::Delta Failed :: " << *FailedPath << " :: " << result;
+                }
+                FallbackToFullArchives(item, file, LastApply);
+            } else {
+                FreeTemporaryFile(file);
+                DeltaPackages.insert(PackageName);
+                StagedPackageTrees.insert(PackageName, Staging);
+                PackageManifests[PackageName] += *Manifest;
+            }
+
+            if(DeltaDownloadsIdle && RunningDeltaApplies.isEmpty()) {
+                DeltaDownloadsIdle = false;
+                FinishedDownloadingUpdates();
+            }
+            return;
+        });
+        const QArchive::EntryFilter Filter = PackageFilters.value(PackageName);
+        const QString Base = liveTree();
+        RunningDeltaApplies[PackageName] += 1;
+        DownloadManager->Next(); // Next Iteration , while the delta is applied.
+        Watcher->setFuture(QtConcurrent::run([file, Base, Staging, Manifest, FailedPath, Filter, PackageName]() {
+            QIB_TRACE_SCOPE("delta_apply", PackageName);
+            const qint64 MetricBegin = QIB_METRIC_NOW();
+            short result = QInstallerBridgeDelta::applyArchive(file, Base, Staging, Manifest.data(),
+                                                               FailedPath.data(), Filter);
+            QIB_METRIC_OBSERVE(DELTA_APPLY_PHASE, MetricBegin);
+            return result;
+        }));
+        return;
+    }
+
+    /*
+     * lastApply is true when the last running apply of the package
+     * just ended , the full archives wait for it since it writes into
+     * the same staging directory.
+    */
+    void FallbackToFullArchives(int item, const QString& file, bool lastApply)
+    {
+        const QString PackageName = Updates.at(item).PackageName;
+        FreeTemporaryFile(file);
+        CachedPackagesData.removeAll(file);
+
+        /*
+         * Once is enough , the other delta archives of the package
+         * are skipped as they arrive.
+        */
+        bool First = !FailedDeltaPackages.contains(PackageName);
+        if(First) {
+            if(debug) {
+                qDebug() << "QInstallerBridge::Falling back to the Full Archives :: " << PackageName;
+            }
+            FailedDeltaPackages.insert(PackageName);
+            DeltaPackages.remove(PackageName);
+            StagedPackageTrees.remove(PackageName);
+            PackageManifests.remove(PackageName);
+        }
+        if((First || lastApply) && !RunningDeltaApplies.contains(PackageName)) {
+            QDir(stagingRoot() + "/" + PackageName).removeRecursively();
+            DeltaDownloadsIdle = false; // The downloader starts again.
+            QueueArchives(item);
+        }
+        return;
+    }
+
+    /*
+     * The archives of a package go right in front of the queue ,
+     * so they do not wait behind the metas of other packages.
+    */
+    void DownloadArchive(const QString& url, const QString& file)
+    {
+        QIODevice *Stream = ArchiveStreams.value(file);
+        if(Stream != NULL) {
+            DownloadManager->DownloadFirst(url, Stream);
+            return;
+        }
+        DownloadManager->DownloadFirst(url, file);
+        return;
+    }
+
+    /*
+     * libarchive can only read a stream front to back ,
+     * 7z and zip need to seek and are downloaded to a file.
+    */
+    bool isStreamableArchive(const QString& name)
+    {
+        static const char *Suffixes[] = {
+            ".tar", ".tar.gz", ".tgz", ".tar.bz2", ".tbz2",
+            ".tar.xz", ".txz", ".tar.lzma", ".tar.zst", ".tzst",
+            ".tar.lz4", ".cpio", NULL
+        };
+        for(int suffix = 0; Suffixes[suffix] != NULL ; ++suffix) {
+            if(name.endsWith(QLatin1String(Suffixes[suffix]), Qt::CaseInsensitive)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    QString stagingRoot()
+    {
+        return installationPath + "/.QInstallerBridgeStaging";
+    }
+
+    /*
+     * Creates the stream a archive is downloaded into and the extractor
+     * which unpacks it into the package's staging directory.
+     * Returns the name of the stream or a empty string if the staging
+     * directory cannot be created.
+    */
+    QString OpenArchiveStream(int item, const QString& url)
+    {
+        const QString &PackageName = Updates.at(item).PackageName;
+        QString Staging = stagingRoot() + "/" + PackageName;
+        if(!QDir().mkpath(Staging)) {
+            return QString();
+        }
+
+        // The worker first , so it is deleted before its stream.
+        auto Worker = new QArchive::Extractor(this);
+        auto Stream = new QArchive::ArchiveStream(this);
+        Stream->setObjectName(url);
+        Worker->setMaxThreads(1);
+        Worker->setCollectManifest(writeManifests);
+        Worker->setEntryStatus(perFileStatus);
+        Worker->setEntryFilter(PackageFilters.value(PackageName));
+        Worker->addStream(Stream);
+        Worker->setDestination(Staging);
+
+        connect(Stream, &QIODevice::readyRead, this, [this, url]() {
+            StartStreamExtraction(url);
+            return;
+        });
+
+        // Reported like the install workers , the staged paths are the installed ones.
+        connect(Worker, &QArchive::Extractor::status, this,
+        [this](const QString& Archive, const QString& file) {
+            NONEED(Archive);
+            emit updatesInstalling(file);
+            return;
+        });
+
+        connect(Worker, &QArchive::Extractor::progress, this,
+        [this, PackageName](qint64 files, qint64 bytes, const QStringList& latest) {
+            if(!perFileStatus && !latest.isEmpty()) {
+                emit updatesInstalling(latest.last());
+            }
+            emit updatesInstallProgress(PackageName, files, bytes, latest);
+            return;
+        });
+
+        connect(Worker, &QArchive::Extractor::finished, this, [this, url, Worker]() {
+            // The staged paths are the same as the installed ones.
+            PackageManifests[StreamPackages.value(url)] += Worker->takeManifest();
+            FinishStreamExtraction(url);
+            CheckDownloadsFinished();
+            return;
+        });
+
+        connect(Worker, &QArchive::Extractor::error, this,
+        [this, url](short errorCode, const QString& Archive) {
+            NONEED(Archive);
+            FinishStreamExtraction(url);
+            if(!StreamFailed) {
+                StreamFailed = true;
+                StagedPackageTrees.remove(StreamPackages.value(url));
+                emit error(errorCode, url);
+            }
+            return;
+        });
+
+        ArchiveStreams.insert(url, Stream);
+        StreamWorkers.insert(url, Worker);
+        StreamPackages.insert(url, PackageName);
+        StagedPackageTrees.insert(PackageName, Staging);
+        return url;
+    }
+
+    void StartStreamExtraction(const QString& name)
+    {
+        if(!StreamWorkers.contains(name) || StartedStreams.contains(name)) {
+            return;
+        }
+        StartedStreams.insert(name);
+        StreamWorkers.value(name)->start();
+        return;
+    }
+
+    void FinishStreamExtraction(const QString& name)
+    {
+        auto Worker = StreamWorkers.take(name);
+        if(Worker != NULL) {
+            Worker->deleteLater();
+        }
+        return;
+    }
+
+    void AbortArchiveStreams()
+    {
+        StreamFailed = true; // The extractors fail now , that is no news.
+        for(auto Stream : ArchiveStreams) {
+            Stream->abort();
+        }
+        return;
+    }
+
+    void FreeArchiveStreams()
+    {
+        for(auto Stream : ArchiveStreams) {
+            Stream->deleteLater();
+        }
+        ArchiveStreams.clear();
+        StreamPackages.clear();
+        StartedStreams.clear();
+        return;
+    }
+
+    void FreeStagingTrees()
+    {
+        StagedPackageTrees.clear();
+        QDir(stagingRoot()).removeRecursively();
+        return;
+    }
+
+    /*
+     * Moves a verified staging tree into the installation path ,
+     * both are on the same filesystem so every file is a rename.
+    */
+    bool commitStagingTree(const QString& staging, const QString& destination)
+    {
+        QIB_TRACE_SCOPE("commit", QFileInfo(staging).fileName());
+        QDir Staging(staging);
+        QDirIterator Entries(staging,
+                             QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                             QDirIterator::Subdirectories);
+        while(Entries.hasNext()) {
+            QString Source = Entries.next();
+            QString Target = destination + "/" + Staging.relativeFilePath(Source);
+            QFileInfo Info = Entries.fileInfo();
+
+            if(Info.isDir() && !Info.isSymLink()) {
+                if(!QDir().mkpath(Target)) {
+                    return false;
+                }
+                continue;
+            }
+
+            QFileInfo Existing(Target);
+            if(Existing.exists() || Existing.isSymLink()) {
+                QFile::remove(Target);
+            }
+            if(!QDir().rename(Source, Target)) {
+                return false;
+            }
+        }
+        return Staging.removeRecursively();
+    }
+
+    bool archiveChecksum(const QString& name, QString *checksum)
+    {
+        if(ArchiveStreams.contains(name)) {
+            *checksum = ArchiveStreams.value(name)->digest().toHex();
+            return true;
+        }
+        return fileChecksum(name, checksum);
+    }
+
+    bool fileChecksum(const QString& fileName, QString *checksum)
+    {
+        QFile File(fileName);
+        if(!File.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        // Hash in chunks , archives can be larger than the memory we have.
+        const qint64 TraceBegin = QIB_TRACE_BEGIN(),
+                     MetricBegin = QIB_METRIC_NOW();
+        QCryptographicHash Hash(QCryptographicHash::Sha1);
+        Hash.addData(&File);
+        *checksum = Hash.result().toHex();
+        QIB_TRACE_END("verify", QFileInfo(fileName).fileName(), TraceBegin, File.size());
+        QIB_METRIC_OBSERVE(VERIFY_PHASE, MetricBegin);
+        return true;
+    }
+
+    void RepoSync(const QString& resp)
+    {
+        QIB_TRACE_END("check", repoLink, CheckTraceBegin, resp.size());
+        QIB_METRIC_OBSERVE(CHECK_PHASE, CheckMetricBegin);
+        QIB_METRIC_ADD(UPDATE_CHECKS, 1);
+        CheckMetricBegin = 0;
+        const qint64 TraceBegin = QIB_TRACE_BEGIN();
+        QXmlStreamReader XMLReader(resp);
+        QVector<PackageUpdate> RepoPackages;
+        PackageUpdate Package;
+
+        while (!XMLReader.atEnd() && !XMLReader.hasError()) {
+            XMLReader.readNext();
+            if (XMLReader.isStartElement()) {
+                QString Key = XMLReader.name().toString();
+
+                if(Key == "PackageUpdate") {
+                    Package = PackageUpdate(); // Nothing should leak from the previous package.
+                } else if(Key == "Name") {
+                    Package.PackageName = QString(XMLReader.readElementText());
+                } else if(Key == "Description") {
+                    Package.Description = QString(XMLReader.readElementText());
+                } else if(Key == "Changelog") {
+                    Package.Changelog = QString(XMLReader.readElementText());
+                } else if(Key == "Version") {
+                    Package.Version = QString(XMLReader.readElementText());
+                } else if(Key == "DownloadableArchives") {
+                    Package.DownloadableArchives = QString(XMLReader.readElementText());
+                } else if(Key == "DeltaArchives") {
+                    Package.DeltaBaseVersion = XMLReader.attributes().value("BaseVersion").toString();
+                    Package.DeltaArchives = QString(XMLReader.readElementText());
+                } else if(Key == "Dependencies") {
+                    Package.Dependencies = QString(XMLReader.readElementText());
+                } else if(Key == "SHA1") {
+                    Package.SHA1 = QString(XMLReader.readElementText());
+                }
+            } else if(XMLReader.isEndElement() && XMLReader.name() == "PackageUpdate") {
+                RepoPackages.push_back(Package);
+            }
+        }
+
+        if(XMLReader.hasError()) {
+            if(debug) {
+                qDebug() << "QInstallerBridge::UpdatesXML::Error::" << XMLReader.errorString();
+            }
+            emit error(UPDATES_XML_SYNTAX_ERROR, XMLReader.errorString());
+            return;
+        }
+
+        QFile localComponents(componentsXML);
+        if(!localComponents.open(QIODevice::ReadOnly | QIODevice::Text)) {
             if(debug) {
                 qDebug() << "QInstallerBridge::ComponentsXML:: Not Found!";
             }
@@ -441,111 +1312,877 @@ private slots:
             }
         }
 
-        QXmlStreamReader XMLReaderLocal(&localComponents);
-        QString PackageNameLocal;
+        QXmlStreamReader XMLReaderLocal(&localComponents);
+        QString PackageNameLocal;
+        QSet<QString> LocalPackages;
+        InstalledVersions.clear();
+
+        while (!XMLReaderLocal.atEnd() && !XMLReaderLocal.hasError()) {
+            XMLReaderLocal.readNext();
+            if (XMLReaderLocal.isStartElement()) {
+                QString Key = XMLReaderLocal.name().toString();
+                if (Key == "Name") {
+                    PackageNameLocal = QString(XMLReaderLocal.readElementText());
+                    LocalPackages.insert(PackageNameLocal);
+                }
+
+                if(Key == "Version") {
+                    QString Version(XMLReaderLocal.readElementText());
+                    InstalledVersions.insert(PackageNameLocal, Version);
+                    for(int item = 0; item < RepoPackages.size() ; ++item) {
+                        if(PackageNameLocal == RepoPackages.at(item).PackageName) {
+                            QStringList LocalSemVer = Version.split('.');
+                            QStringList RepoSemVer = RepoPackages.at(item).Version.split('.');
+                            if(RepoSemVer.at(0).toInt() > LocalSemVer.at(0).toInt()) {
+                                Updates.push_back(RepoPackages.at(item));
+                            } else if(RepoSemVer.at(0).toInt() == LocalSemVer.at(0).toInt()) {
+                                if(RepoSemVer.at(1).toInt() > LocalSemVer.at(1).toInt()) {
+                                    Updates.push_back(RepoPackages.at(item));
+                                } else if(RepoSemVer.at(1).toInt() == LocalSemVer.at(1).toInt()) {
+                                    if(RepoSemVer.at(2).toInt() > LocalSemVer.at(2).toInt()) {
+                                        Updates.push_back(RepoPackages.at(item));
+                                    }
+                                } else {
+                                    break;
+                                }
+
+                            } else {
+                                break;
+                            }
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if(XMLReaderLocal.hasError()) {
+            if(debug) {
+                qDebug() << "QInstallerBridge::ComponentsXML::Error::" << XMLReader.errorString();
+            }
+            emit error(COMPONENTS_XML_SYNTAX_ERROR, XMLReader.errorString());
+            return;
+        }
+
+        /*
+         * Pull in the dependencies which are not installed at all ,
+         * Updates grows as we go so the dependencies of the pulled in
+         * packages are also taken care of.
+        */
+        QSet<QString> UpdateNames;
+        for(int item = 0; item < Updates.size() ; ++item) {
+            UpdateNames.insert(Updates.at(item).PackageName);
+        }
+        for(int item = 0; item < Updates.size() ; ++item) {
+            QStringList Dependencies = dependencyNames(Updates.at(item).Dependencies);
+            for(int dep = 0; dep < Dependencies.size() ; ++dep) {
+                QString Dependency = Dependencies.at(dep);
+                if(LocalPackages.contains(Dependency) || UpdateNames.contains(Dependency)) {
+                    continue;
+                }
+
+                int repoItem = 0;
+                while(repoItem < RepoPackages.size() && RepoPackages.at(repoItem).PackageName != Dependency) {
+                    ++repoItem;
+                }
+                if(repoItem == RepoPackages.size()) {
+                    if(debug) {
+                        qDebug() << "QInstallerBridge::Dependency Not Found in Repo :: " << Dependency;
+                    }
+                    continue;
+                }
+
+                if(debug) {
+                    qDebug() << "QInstallerBridge::Pulling in Dependency :: " << Dependency;
+                }
+                Updates.push_back(RepoPackages.at(repoItem));
+                UpdateNames.insert(Dependency);
+            }
+        }
+
+        if(!sortUpdatesByDependencies()) {
+            if(debug) {
+                qDebug() << "QInstallerBridge::Dependencies::Error::Cycle Detected!";
+            }
+            emit error(DEPENDENCY_ERROR, repoLink + "/Updates.xml");
+            return;
+        }
+        QIB_TRACE_END("xml_sync", repoLink, TraceBegin, Updates.size());
+        EmitTraceSpans();
+        emit updatesList(Updates);
+
+        /*
+         * Disconnect Previous Connections
+         * just in case!
+        */
+        disconnect(DownloadManager,
+                   SIGNAL(GetResponse(const QString& )),
+                   this,
+                   SLOT(RepoSync(const QString&)));
+        return;
+    }
+
+    QStringList dependencyNames(const QString& dependencies)
+    {
+        QStringList Names;
+        QStringList Entries = dependencies.split(",", QString::SkipEmptyParts);
+        for(int item = 0; item < Entries.size() ; ++item) {
+            /*
+             * A dependency can carry a version requirement like
+             * org.example.core->=1.0.0 , we only need the name.
+            */
+            QString Name = Entries.at(item).trimmed();
+            int VersionAt = Name.indexOf("->");
+            if(VersionAt < 0) {
+                VersionAt = Name.indexOf('(');
+            }
+            if(VersionAt >= 0) {
+                Name = Name.left(VersionAt).trimmed();
+            }
+            if(!Name.isEmpty()) {
+                Names << Name;
+            }
+        }
+        return Names;
+    }
+
+    /*
+     * Counts the dependencies of each update which are also beign updated
+     * and lists the updates that wait on each package.
+    */
+    void dependencyGraph(QVector<int> *unmet, QHash<QString, QList<int>> *dependents)
+    {
+        QSet<QString> UpdateNames;
+        for(int item = 0; item < Updates.size() ; ++item) {
+            UpdateNames.insert(Updates.at(item).PackageName);
+        }
+
+        unmet->fill(0, Updates.size());
+        dependents->clear();
+        for(int item = 0; item < Updates.size() ; ++item) {
+            QStringList Dependencies = dependencyNames(Updates.at(item).Dependencies);
+            for(int dep = 0; dep < Dependencies.size() ; ++dep) {
+                if(!UpdateNames.contains(Dependencies.at(dep)) ||
+                   Dependencies.at(dep) == Updates.at(item).PackageName) {
+                    continue;
+                }
+                (*unmet)[item] += 1;
+                (*dependents)[Dependencies.at(dep)] << item;
+            }
+        }
+        return;
+    }
+
+    bool sortUpdatesByDependencies()
+    {
+        QVector<int> Unmet;
+        QHash<QString, QList<int>> Dependents;
+        QVector<PackageUpdate> Sorted;
+        QList<int> Ready;
+
+        dependencyGraph(&Unmet, &Dependents);
+        for(int item = 0; item < Updates.size() ; ++item) {
+            if(!Unmet.at(item)) {
+                Ready << item;
+            }
+        }
+
+        while(!Ready.isEmpty()) {
+            int item = Ready.takeFirst();
+            Sorted.push_back(Updates.at(item));
+
+            QList<int> Waiting = Dependents.value(Updates.at(item).PackageName);
+            for(int dep = 0; dep < Waiting.size() ; ++dep) {
+                Unmet[Waiting.at(dep)] -= 1;
+                if(!Unmet.at(Waiting.at(dep))) {
+                    Ready << Waiting.at(dep);
+                }
+            }
+        }
+
+        if(Sorted.size() != Updates.size()) {
+            return false; // Cyclic dependencies can never be installed.
+        }
+        Updates = Sorted;
+        return true;
+    }
+
+    void RepoMergeXML(const QString& packageName, const QString& newVersion)
+    {
+        QIB_TRACE_SCOPE("xml_merge", packageName);
+        QDomDocument doc("components");
+        const QString ComponentsXML = componentsXMLTarget();
+        QFile file(ComponentsXML);
+        if (!file.open(QIODevice::ReadOnly)) {
+            if(debug) {
+                qDebug() << "QInstallerBridge::ComponentsXML::Error::Cannot Open file!";
+            }
+            emit error(COMPONENTS_XML_SYNTAX_ERROR, ComponentsXML);
+            return;
+        }
+
+        if (!doc.setContent(&file)) {
+            if(debug) {
+                qDebug() << "QInstallerBridge::ComponentsXML::Error::Cannot set QDomDocument!";
+            }
+            emit error(COMPONENTS_XML_SYNTAX_ERROR, ComponentsXML);
+
+            file.close();
+            return ;
+        }
+        file.close();
+
+        QDomNodeList Packages = doc.elementsByTagName("Package");
+        bool Found = false;
+
+        for(int i = 0 ; i < Packages.size() ; ++i) {
+            QDomElement Package = Packages.at(i).toElement();
+            QDomNodeList Version = Package.elementsByTagName("Version");
+            QDomNodeList Name    = Package.elementsByTagName("Name");
+            if(Name.at(0).toElement().text() == packageName) {
+                Version.at(0).firstChild().setNodeValue(newVersion);
+                Found = true;
+                break;
+            }
+        }
+
+        /*
+         * A pulled in dependency is not in components.xml yet ,
+         * so register it as a new package.
+        */
+        if(!Found) {
+            QString Description;
+            for(int item = 0; item < Updates.size() ; ++item) {
+                if(Updates.at(item).PackageName == packageName) {
+                    Description = Updates.at(item).Description;
+                    break;
+                }
+            }
+
+            QDomElement Package = doc.createElement("Package");
+            QStringList Keys, Values;
+            Keys << "Name" << "Title" << "Description" << "Version" << "InstallDate";
+            Values << packageName << packageName << Description << newVersion
+                   << QDate::currentDate().toString(Qt::ISODate);
+            for(int key = 0; key < Keys.size() ; ++key) {
+                QDomElement Element = doc.createElement(Keys.at(key));
+                Element.appendChild(doc.createTextNode(Values.at(key)));
+                Package.appendChild(Element);
+            }
+            doc.documentElement().appendChild(Package);
+        }
+
+        /*
+         * A new file which replaces the old one , it may be a hard
+         * link shared with the live or the previous tree.
+        */
+        QSaveFile Output(ComponentsXML);
+        if (!Output.open(QIODevice::WriteOnly)) {
+            if(debug) {
+                qDebug() << "QInstallerBridge::ComponentsXML::Error::Cannot Append file!";
+            }
+            emit error(COMPONENTS_XML_SYNTAX_ERROR, ComponentsXML);
+            return;
+        }
+        QByteArray xml = doc.toByteArray();
+        Output.write(xml);
+        if(!Output.commit()) {
+            if(debug) {
+                qDebug() << "QInstallerBridge::ComponentsXML::Error::Cannot Write file!";
+            }
+            emit error(COMPONENTS_XML_SYNTAX_ERROR, ComponentsXML);
+        }
+        return;
+    }
+
+    /*
+     * The files each package writes , directories are shared
+     * by the packages and never counted.
+    */
+    static QVector<QStringList> packagePaths(const QVector<QStringList>& archives, const QVector<QString>& stagedTrees)
+    {
+        QVector<QStringList> Paths(archives.size());
+        for(int item = 0; item < archives.size() ; ++item) {
+            for(int archive = 0; archive < archives.at(item).size() ; ++archive) {
+                QArchive::Reader Listing(archives.at(item).at(archive));
+                Listing.read();
+                const QVector<QArchive::ArchiveIndexEntry> &Entries = Listing.listEntries();
+                for(int entry = 0; entry < Entries.size() ; ++entry) {
+                    if(Entries.at(entry).type != AE_IFDIR) {
+                        Paths[item] << QDir::cleanPath(Entries.at(entry).path);
+                    }
+                }
+            }
+            if(stagedTrees.at(item).isEmpty()) {
+                continue;
+            }
+            QDir Staging(stagedTrees.at(item));
+            QDirIterator Files(Staging.path(), QDir::Files | QDir::System | QDir::Hidden,
+                               QDirIterator::Subdirectories);
+            while(Files.hasNext()) {
+                Paths[item] << Staging.relativeFilePath(Files.next());
+            }
+        }
+        return Paths;
+    }
+
+    /*
+     * A package which writes a file of a earlier package waits on it ,
+     * like on a dependency. The updates are sorted by their dependencies ,
+     * so a earlier package never waits on a later one.
+    */
+    void SerializeOverlappingPackages(const QVector<QStringList>& paths)
+    {
+        QHash<QString, int> Writers;
+        for(int item = 0; item < paths.size() ; ++item) {
+            QSet<int> Overlaps;
+            for(int path = 0; path < paths.at(item).size() ; ++path) {
+                int Writer = Writers.value(paths.at(item).at(path), -1);
+                if(Writer < 0) {
+                    Writers.insert(paths.at(item).at(path), item);
+                    continue;
+                }
+                if(Writer == item || Overlaps.contains(Writer)) {
+                    continue;
+                }
+                Overlaps.insert(Writer);
+                UnmetDependencies[item] += 1;
+                DependentPackages[Updates.at(Writer).PackageName] << item;
+                if(debug) {
+                    qDebug() << "QInstallerBridge::Overlapping Packages :: " << Updates.at(Writer).PackageName
+                             << " , " << Updates.at(item).PackageName << " :: " << paths.at(item).at(path);
+                }
+            }
+        }
+        return;
+    }
+
+    void StartInstalls()
+    {
+        for(int item = 0; item < Updates.size() ; ++item) {
+            if(!UnmetDependencies.at(item)) {
+                ReadyPackages << item;
+            }
+        }
+        ScheduleInstalls();
+        return;
+    }
+
+    /*
+     * Starts every package whose dependencies are installed ,
+     * as long as we have a free worker.
+    */
+    void ScheduleInstalls()
+    {
+        while(!ReadyPackages.isEmpty() &&
+              BusyInstallWorkers.size() < maxParallelInstalls &&
+              !InstallFailed && !InstallStopping) {
+            int item = ReadyPackages.takeFirst();
+            if(StagedPackageTrees.contains(Updates.at(item).PackageName) &&
+               !commitStagingTree(StagedPackageTrees.take(Updates.at(item).PackageName), installTarget())) {
+                InstallFailed = true;
+                ReadyPackages.clear();
+                for(auto Running : BusyInstallWorkers.keys()) {
+                    Running->stop();
+                }
+                if(BusyInstallWorkers.isEmpty()) {
+                    DiscardAtomicInstall();
+                }
+                emit error(INSTALL_COMMIT_ERROR, Updates.at(item).PackageName);
+                return;
+            }
+
+            QStringList Archives = CachedPackageArchives.value(Updates.at(item).PackageName);
+            if(Archives.isEmpty()) {
+                // Nothing to extract , only the version changes.
+                FinishPackageInstall(item);
+                continue;
+            }
+
+            auto Worker = IdleInstallWorker();
+            BusyInstallWorkers.insert(Worker, item);
+            PackageTraceBegins.insert(item, QIB_TRACE_BEGIN());
+            PackageMetricBegins.insert(item, QIB_METRIC_NOW());
+
+            if(debug) {
+                qDebug() << "QInstallerBridge::Installing Package :: " << Updates.at(item).PackageName;
+            }
+            /*
+             * The packages already run side by side , so share the
+             * cores between them instead of each taking all of them.
+            */
+            Worker->setMaxThreads(qMax(1, QThread::idealThreadCount() / maxParallelInstalls));
+            Worker->setWriteFlags(isLinkedTree() ? QArchive::UNLINK_WRITE : QArchive::DEFAULT_WRITE);
+            Worker->setSkipUnchanged(skipUnchangedFiles);
+            Worker->setReferenceManifest(ReferenceManifest(item));
+            Worker->setCollectManifest(writeManifests);
+            Worker->setEntryStatus(perFileStatus);
+            Worker->setEntryFilter(PackageFilters.value(Updates.at(item).PackageName));
+            Worker->addArchive(Archives);
+            Worker->setDestination(installTarget());
+            Worker->start();
+        }
+
+        if(InstalledCount == Updates.size() && BusyInstallWorkers.isEmpty()) {
+            if(AtomicStaging && !CommitAtomicInstall()) {
+                DiscardAtomicInstall();
+                emit error(INSTALL_COMMIT_ERROR, installationPath);
+                return;
+            }
+            FreeTemporaryFiles();
+            FreeArchiveStreams();
+            FreeStagingTrees();
+            CachedPackagesData.clear();
+            CachedPackageArchives.clear();
+            QIB_TRACE_END("install", installationPath, InstallTraceBegin, InstallBytesWritten);
+            EmitTraceSpans();
+            emit updatesWriteStatistics(InstallBytesWritten, InstallBytesSkipped);
+            emit updatesInstalled();
+        }
+        return;
+    }
+
+    void FinishPackageInstall(int item)
+    {
+        QIB_TRACE_END("install_package", Updates.at(item).PackageName, PackageTraceBegins.take(item), 0);
+        QIB_METRIC_OBSERVE(INSTALL_PACKAGE_PHASE, PackageMetricBegins.take(item));
+        QIB_METRIC_ADD(PACKAGES_INSTALLED, 1);
+        /*
+         * Update Local Information!
+         * ~This is Very Important than Anything~
+         * A components.xml outside a atomic install is only
+         * touched once the new tree is live.
+        */
+        if(!AtomicStaging || isInstallationFile(componentsXML)) {
+            RepoMergeXML(Updates.at(item).PackageName, Updates.at(item).Version);
+        }
+        QVector<QArchive::ManifestEntry> Manifest = PackageManifests.take(Updates.at(item).PackageName);
+        if(writeManifests && DeltaPackages.contains(Updates.at(item).PackageName)) {
+            // A delta only has the changed files , the others are still as the old manifest says.
+            QVector<QArchive::ManifestEntry> Unchanged;
+            readManifest(installTarget() + "/" + ManifestDirectory + "/" + Updates.at(item).PackageName + ".manifest",
+                         &Unchanged);
+            Manifest = Unchanged + Manifest;
+        }
+        if(writeManifests && !writeManifest(item, Manifest) && debug) {
+            qDebug() << "QInstallerBridge::Cannot write the manifest of :: " << Updates.at(item).PackageName;
+        }
+        InstalledCount += 1;
+
+        QList<int> Waiting = DependentPackages.value(Updates.at(item).PackageName);
+        for(int dep = 0; dep < Waiting.size() ; ++dep) {
+            UnmetDependencies[Waiting.at(dep)] -= 1;
+            if(!UnmetDependencies.at(Waiting.at(dep))) {
+                ReadyPackages << Waiting.at(dep);
+            }
+        }
+        return;
+    }
+
+    QArchive::Extractor *IdleInstallWorker()
+    {
+        for(int item = 0; item < InstallWorkers.size() ; ++item) {
+            if(!BusyInstallWorkers.contains(InstallWorkers.at(item))) {
+                return InstallWorkers.at(item);
+            }
+        }
+
+        /*
+         * The extractor emits from its own thread , giving a context
+         * makes sure the scheduler always runs on our thread.
+        */
+        auto Worker = new QArchive::Extractor(this);
+        connect(Worker, &QArchive::Extractor::status, this,
+        [this](const QString& Archive, const QString& file) {
+            NONEED(Archive);
+            emit updatesInstalling(file);
+            return;
+        });
+
+        connect(Worker, &QArchive::Extractor::progress, this,
+        [this, Worker](qint64 files, qint64 bytes, const QStringList& latest) {
+            if(!BusyInstallWorkers.contains(Worker)) {
+                return; // The last batch of a package which failed.
+            }
+            if(!perFileStatus && !latest.isEmpty()) {
+                emit updatesInstalling(latest.last());
+            }
+            emit updatesInstallProgress(Updates.at(BusyInstallWorkers.value(Worker)).PackageName, files, bytes, latest);
+            return;
+        });
+
+        connect(Worker, &QArchive::Extractor::error, this,
+        [this, Worker](short errorCode, const QString& Archive) {
+            BusyInstallWorkers.remove(Worker);
+            if(!InstallFailed) {
+                InstallFailed = true;
+                ReadyPackages.clear();
+                for(auto Running : BusyInstallWorkers.keys()) {
+                    Running->stop();
+                }
+                emit error(errorCode, Archive);
+            }
+            if(BusyInstallWorkers.isEmpty()) {
+                DiscardAtomicInstall();
+            }
+            return;
+        });
+
+        connect(Worker, &QArchive::Extractor::statistics, this,
+        [this](qint64 written, qint64 skipped) {
+            InstallBytesWritten += written;
+            InstallBytesSkipped += skipped;
+            return;
+        });
+
+        connect(Worker, &QArchive::Extractor::finished, this,
+        [this, Worker]() {
+            int item = BusyInstallWorkers.take(Worker);
+            PackageManifests[Updates.at(item).PackageName] += Worker->takeManifest();
+            if(InstallFailed) {
+                if(BusyInstallWorkers.isEmpty()) {
+                    DiscardAtomicInstall();
+                }
+                return;
+            }
+
+            FinishPackageInstall(item);
+            if(InstallStopping) {
+                FinishedStoppingInstalls();
+                return;
+            }
+            ScheduleInstalls();
+            return;
+        });
+
+        connect(Worker, &QArchive::Extractor::stopped, this,
+        [this, Worker]() {
+            BusyInstallWorkers.remove(Worker);
+            if(InstallStopping) {
+                FinishedStoppingInstalls();
+            } else if(InstallFailed && BusyInstallWorkers.isEmpty()) {
+                DiscardAtomicInstall();
+            }
+            return;
+        });
+
+        InstallWorkers.push_back(Worker);
+        return Worker;
+    }
+
+    void FinishedStoppingInstalls()
+    {
+        if(!BusyInstallWorkers.isEmpty()) {
+            return;
+        }
+        InstallStopping = false;
+        DiscardAtomicInstall(); // The live tree was never touched.
+        FreeTemporaryFiles();
+        emit InstallationAborted();
+        return;
+    }
+
+    QString liveTree()
+    {
+        return QDir(installationPath).absolutePath();
+    }
+
+    QString nextTree()
+    {
+        return liveTree() + ".next";
+    }
+
+    QString previousTree()
+    {
+        return liveTree() + ".previous";
+    }
+
+    QString installTarget()
+    {
+        return AtomicStaging ? nextTree() : installationPath;
+    }
+
+    /*
+     * The files of the target are hard links into another tree while a
+     * atomic install runs and after one , until {path}.previous is gone.
+    */
+    bool isLinkedTree()
+    {
+        return AtomicStaging || QDir(previousTree()).exists();
+    }
+
+    bool isInstallationFile(const QString& fileName)
+    {
+        return QFileInfo(fileName).absoluteFilePath().startsWith(liveTree() + "/");
+    }
+
+    /*
+     * While a atomic install runs , a components.xml inside the
+     * installation path is edited in the new tree.
+    */
+    QString componentsXMLTarget()
+    {
+        if(!AtomicStaging || !isInstallationFile(componentsXML)) {
+            return componentsXML;
+        }
+        return nextTree() + "/" + QFileInfo(componentsXML).absoluteFilePath().mid(liveTree().size() + 1);
+    }
+
+    /*
+     * Copies a tree with hard links , so it costs no data. The extractors
+     * unlink a file before writing it , the live tree is never modified.
+    */
+    bool linkTree(const QString& source, const QString& target)
+    {
+        QDir Source(source);
+        if(!QDir().mkpath(target)) {
+            return false;
+        }
 
-        while (!XMLReaderLocal.atEnd() && !XMLReaderLocal.hasError()) {
-            XMLReaderLocal.readNext();
-            if (XMLReaderLocal.isStartElement()) {
-                QString Key = XMLReaderLocal.name().toString();
-                if (Key == "Name") {
-                    PackageNameLocal = QString(XMLReaderLocal.readElementText());
-                }
+        QDirIterator Entries(source,
+                             QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                             QDirIterator::Subdirectories);
+        while(Entries.hasNext()) {
+            QString From = Entries.next();
+            QString Relative = Source.relativeFilePath(From);
+            QString To = target + "/" + Relative;
+            QFileInfo Info = Entries.fileInfo();
+
+            if(Relative == ".QInstallerBridgeStaging" || Relative.startsWith(".QInstallerBridgeStaging/")) {
+                continue;
+            }
 
-                if(Key == "Version") {
-                    QString Version(XMLReaderLocal.readElementText());
-                    for(int item = 0; item < RepoPackages.size() ; ++item) {
-                        if(PackageNameLocal == RepoPackages.at(item).PackageName) {
-                            QStringList LocalSemVer = Version.split('.');
-                            QStringList RepoSemVer = RepoPackages.at(item).Version.split('.');
-                            if(RepoSemVer.at(0).toInt() > LocalSemVer.at(0).toInt()) {
-                                Updates.push_back(RepoPackages.at(item));
-                            } else if(RepoSemVer.at(0).toInt() == LocalSemVer.at(0).toInt()) {
-                                if(RepoSemVer.at(1).toInt() > LocalSemVer.at(1).toInt()) {
-                                    Updates.push_back(RepoPackages.at(item));
-                                } else if(RepoSemVer.at(1).toInt() == LocalSemVer.at(1).toInt()) {
-                                    if(RepoSemVer.at(2).toInt() > LocalSemVer.at(2).toInt()) {
-                                        Updates.push_back(RepoPackages.at(item));
-                                    }
-                                } else {
-                                    break;
-                                }
+            if(Info.isSymLink()) {
+#if defined(Q_OS_UNIX)
+                QByteArray Link(4096, '\0');
+                ssize_t Size = readlink(QFile::encodeName(From).constData(), Link.data(), Link.size());
+                if(Size < 0 || symlink(Link.left(Size).constData(), QFile::encodeName(To).constData()) != 0) {
+                    return false;
+                }
+#else
+                if(!QFile::link(Info.symLinkTarget(), To)) {
+                    return false;
+                }
+#endif
+                continue;
+            }
 
-                            } else {
-                                break;
-                            }
-                            break;
-                        }
-                    }
+            if(Info.isDir()) {
+                if(!QDir().mkpath(To)) {
+                    return false;
                 }
+                continue;
             }
-        }
-        if(XMLReaderLocal.hasError()) {
-            if(debug) {
-                qDebug() << "QInstallerBridge::ComponentsXML::Error::" << XMLReader.errorString();
+
+#if defined(Q_OS_UNIX)
+            if(link(QFile::encodeName(From).constData(), QFile::encodeName(To).constData()) == 0) {
+                continue;
+            }
+#endif
+            // No hard links here , a copy is slow but just as safe.
+            if(!QFile::copy(From, To)) {
+                return false;
             }
-            emit error(COMPONENTS_XML_SYNTAX_ERROR, XMLReader.errorString());
-            return;
         }
-        emit updatesList(Updates);
+        return true;
+    }
 
-        /*
-         * Disconnect Previous Connections
-         * just in case!
-        */
-        disconnect(DownloadManager,
-                   SIGNAL(GetResponse(const QString& )),
-                   this,
-                   SLOT(RepoSync(const QString&)));
-        return;
+    /*
+     * Swaps two paths in one step where the kernel can , so there
+     * is never a moment without a installation.
+    */
+    bool swapPaths(const QString& first, const QString& second)
+    {
+#if defined(Q_OS_LINUX) && defined(SYS_renameat2)
+        if(syscall(SYS_renameat2, AT_FDCWD, QFile::encodeName(first).constData(),
+                   AT_FDCWD, QFile::encodeName(second).constData(), RENAME_EXCHANGE) == 0) {
+            return true;
+        }
+        if(errno != EINVAL && errno != ENOSYS) {
+            return false;
+        }
+#endif
+        QString Aside = second + ".swap";
+        QDir Dir;
+        if(!Dir.rename(second, Aside)) {
+            return false;
+        }
+        if(!Dir.rename(first, second)) {
+            Dir.rename(Aside, second);
+            return false;
+        }
+        return Dir.rename(Aside, first);
     }
 
-    void RepoMergeXML(const QString& packageName, const QString& newVersion)
+    bool CommitAtomicInstall()
     {
-        QDomDocument doc("components");
-        QFile file(componentsXML);
-        if (!file.open(QIODevice::ReadOnly)) {
-            if(debug) {
-                qDebug() << "QInstallerBridge::ComponentsXML::Error::Cannot Open file!";
+        if(!swapPaths(nextTree(), liveTree())) {
+            return false;
+        }
+        AtomicStaging = false;
+
+        // {path}.next holds the old tree now.
+        QDir(previousTree()).removeRecursively();
+        QDir().rename(nextTree(), previousTree());
+
+        if(!isInstallationFile(componentsXML)) {
+            QFile::remove(componentsXML + ".previous");
+            QFile::copy(componentsXML, componentsXML + ".previous");
+            for(int item = 0; item < Updates.size() ; ++item) {
+                RepoMergeXML(Updates.at(item).PackageName, Updates.at(item).Version);
             }
-            emit error(COMPONENTS_XML_SYNTAX_ERROR, componentsXML );
+        }
+
+        if(debug) {
+            qDebug() << "QInstallerBridge::Activated :: " << liveTree();
+        }
+        return true;
+    }
+
+    void DiscardAtomicInstall()
+    {
+        if(!AtomicStaging) {
             return;
         }
+        AtomicStaging = false;
+        QDir(nextTree()).removeRecursively();
+        return;
+    }
+
+    /*
+     * Manifest format , QDataStream (Qt 5.0) :
+     *  quint32 magic , quint16 version , QString package , QString version ,
+     *  quint32 count , then per file QByteArray path (UTF-8 , relative) ,
+     *  qint64 size , qint64 mtime (ns , 0 if unknown) , QByteArray SHA1.
+    */
+    bool writeManifest(int item, const QVector<QArchive::ManifestEntry>& entries)
+    {
+        QString Directory = installTarget() + "/" + ManifestDirectory;
+        if(!QDir().mkpath(Directory)) {
+            return false;
+        }
 
-        if (!doc.setContent(&file)) {
-            if(debug) {
-                qDebug() << "QInstallerBridge::ComponentsXML::Error::Cannot set QDomDocument!";
+        // A path written twice ends up as the last one , like on the disk.
+        QHash<QString, int> Latest;
+        for(int entry = 0; entry < entries.size() ; ++entry) {
+            Latest.insert(entries.at(entry).path, entry);
+        }
+
+        // A new file which replaces the old one , never written in place.
+        QSaveFile File(Directory + "/" + Updates.at(item).PackageName + ".manifest");
+        if(!File.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        QDataStream Stream(&File);
+        Stream.setVersion(QDataStream::Qt_5_0);
+        Stream << quint32(ManifestMagic) << quint16(ManifestVersion)
+               << Updates.at(item).PackageName << Updates.at(item).Version
+               << quint32(Latest.size());
+        for(int entry = 0; entry < entries.size() ; ++entry) {
+            const QArchive::ManifestEntry &Entry = entries.at(entry);
+            if(Latest.value(Entry.path) != entry) {
+                continue;
             }
-            emit error(COMPONENTS_XML_SYNTAX_ERROR, componentsXML);
+            Stream << Entry.path.toUtf8() << Entry.size << Entry.mtime << Entry.digest;
+        }
+        return File.commit();
+    }
 
-            file.close();
-            return ;
+    /*
+     * The manifest of the installed version , so skip unchanged files
+     * does not hash what it already knows. Empty if nothing is skipped.
+    */
+    QVector<QArchive::ManifestEntry> ReferenceManifest(int item)
+    {
+        QVector<QArchive::ManifestEntry> Entries;
+        if(skipUnchangedFiles &&
+           !readManifest(installTarget() + "/" + ManifestDirectory + "/" + Updates.at(item).PackageName + ".manifest",
+                         &Entries)) {
+            Entries.clear();
         }
-        file.close();
+        return Entries;
+    }
 
-        QDomNodeList Packages = doc.elementsByTagName("Package");
+    static bool readManifest(const QString& fileName, QVector<QArchive::ManifestEntry> *entries)
+    {
+        QFile File(fileName);
+        if(!File.open(QIODevice::ReadOnly)) {
+            return false;
+        }
 
-        for(int i = 0 ; i < Packages.size() ; ++i) {
-            QDomElement Package = Packages.at(i).toElement();
-            QDomNodeList Version = Package.elementsByTagName("Version");
-            QDomNodeList Name    = Package.elementsByTagName("Name");
-            if(Name.at(0).toElement().text() == packageName) {
-                Version.at(0).firstChild().setNodeValue(newVersion);
-                break;
+        QDataStream Stream(&File);
+        Stream.setVersion(QDataStream::Qt_5_0);
+        quint32 Magic, Count;
+        quint16 Version;
+        QString Package, PackageVersion;
+        Stream >> Magic >> Version >> Package >> PackageVersion >> Count;
+        if(Magic != ManifestMagic || Version != ManifestVersion) {
+            return false;
+        }
+
+        for(quint32 entry = 0; entry < Count && Stream.status() == QDataStream::Ok ; ++entry) {
+            QArchive::ManifestEntry Entry;
+            QByteArray Path;
+            Stream >> Path >> Entry.size >> Entry.mtime >> Entry.digest;
+            Entry.path = QString::fromUtf8(Path);
+            entries->append(Entry);
+        }
+        return (Stream.status() == QDataStream::Ok);
+    }
+
+    /*
+     * A file with the size and mtime of its manifest entry is trusted ,
+     * only the others are hashed again.
+    */
+    static QStringList scanManifestEntries(const QString& root,
+                                           const QVector<QArchive::ManifestEntry>& entries,
+                                           int begin, int end)
+    {
+        QStringList Damaged;
+        for(int entry = begin; entry < end ; ++entry) {
+            const QArchive::ManifestEntry &Entry = entries.at(entry);
+            QFileInfo Info(root + "/" + Entry.path);
+            if(!Info.isFile() || Info.size() != Entry.size) {
+                Damaged << Entry.path;
+                continue;
+            }
+            if(Entry.mtime != 0 &&
+               Info.lastModified().toMSecsSinceEpoch() == Entry.mtime / 1000000) {
+                continue;
+            }
+
+            QFile File(Info.filePath());
+            QCryptographicHash Hash(QCryptographicHash::Sha1);
+            if(!File.open(QIODevice::ReadOnly) || !Hash.addData(&File) || Hash.result() != Entry.digest) {
+                Damaged << Entry.path;
             }
         }
+        return Damaged;
+    }
 
-        if (!file.open(QIODevice::Truncate | QIODevice::WriteOnly)) {
-            if(debug) {
-                qDebug() << "QInstallerBridge::ComponentsXML::Error::Cannot Append file!";
+    static QStringList scanInstallation(const QString& root)
+    {
+        QStringList Damaged;
+        QVector<QArchive::ManifestEntry> Entries;
+        QDir Manifests(root + "/" + ManifestDirectory);
+        for(auto Manifest : Manifests.entryList(QStringList() << "*.manifest", QDir::Files)) {
+            if(!readManifest(Manifests.filePath(Manifest), &Entries)) {
+                Damaged << QString(ManifestDirectory) + "/" + Manifest;
             }
-            emit error(COMPONENTS_XML_SYNTAX_ERROR, componentsXML);
-            return;
         }
-        QByteArray xml = doc.toByteArray();
-        file.write(xml);
-        file.close();
-        return;
+
+        // Small slices , so a few huge files do not keep one thread busy alone.
+        QThreadPool Pool;
+        const int Slices = qMax(1, Pool.maxThreadCount() * 8);
+        const int SliceSize = qMax(1, (Entries.size() + Slices - 1) / Slices);
+        QVector<QFuture<QStringList>> Jobs;
+        for(int begin = 0; begin < Entries.size() ; begin += SliceSize) {
+            Jobs.push_back(QtConcurrent::run(&Pool, &QInstallerBridge::scanManifestEntries, root, Entries,
+                                             begin, qMin(Entries.size(), begin + SliceSize)));
+        }
+        for(int job = 0; job < Jobs.size() ; ++job) {
+            Damaged << Jobs[job].result();
+        }
+        return Damaged;
     }
 
     bool isEmptyConfiguration()
@@ -557,6 +2194,29 @@ private slots:
                );
     }
 
+    bool isTemporaryFile(const QString& fileName)
+    {
+        for(int item = 0; item < CachedTemporaryFiles.size() ; ++item) {
+            if(CachedTemporaryFiles.at(item)->fileName() == fileName) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void FreeTemporaryFile(const QString& fileName)
+    {
+        for(int item = 0; item < CachedTemporaryFiles.size() ; ++item) {
+            auto TFile = CachedTemporaryFiles.at(item);
+            if(TFile->fileName() == fileName) {
+                CachedTemporaryFiles.remove(item);
+                TFile->deleteLater();
+                break;
+            }
+        }
+        return;
+    }
+
     void FreeTemporaryFiles()
     {
         for(int item = 0; item < CachedTemporaryFiles.size() ; ++item) {
@@ -570,6 +2230,10 @@ private slots:
 public slots:
     void CheckForUpdates()
     {
+        if(postToOwnerThread("CheckForUpdates")) {
+            return;
+        }
+
         if(debug) {
             qDebug() << "QInstallerBridge::Checking for updates";
             qDebug() << "QInstallerBridge::Collecting online information.";
@@ -583,6 +2247,8 @@ public slots:
         }
 
         Updates.clear(); // clear previous updates!
+        CheckTraceBegin = QIB_TRACE_BEGIN();
+        CheckMetricBegin = QIB_METRIC_NOW();
 
         if(debug) {
             qDebug() << "QInstallerBridge::GET::Updates.xml:: " << repoLink + "/Updates.xml";
@@ -614,19 +2280,32 @@ public slots:
 
     void DownloadUpdates()
     {
-        if(Updates.isEmpty()) {
+        if(postToOwnerThread("DownloadUpdates")) {
+            return;
+        }
+
+        if(Updates.isEmpty() || !StreamWorkers.isEmpty() || !RunningDeltaApplies.isEmpty()) {
             return;
         }
 
         CachedPackagesData.clear(); // clean previous data
+        CachedPackageArchives.clear();
         CurrentCheckFile.clear();
-        buff = 0; // Random integer buffer , Can be used for any type of counting.
+        PendingMetaPackages.clear();
+        DeltaArchiveFiles.clear();
+        DeltaPackages.clear();
+        FailedDeltaPackages.clear();
+        FreeArchiveStreams();
+        FreeStagingTrees();
+        DownloadsFinished = StreamFailed = DeltaDownloadsIdle = false;
+        DownloadTraceBegin = QIB_TRACE_BEGIN();
 
         connect(DownloadManager, &QEasyDownloader::GetResponse, this, &QInstallerBridge::VerifyArchiveChecksums);
-        connect(DownloadManager, &QEasyDownloader::DownloadFinished, this, &QInstallerBridge::VerifyPackageChecksums);
+        connect(DownloadManager, &QEasyDownloader::DownloadFinished, this, &QInstallerBridge::FinishUpdateDownload);
 
         connect(DownloadManager, &QEasyDownloader::Error,
         [&](QNetworkReply::NetworkError errorCode, const QUrl &url, const QString &fileName) {
+            AbortArchiveStreams();
             if(errorCode == QNetworkReply::HostNotFoundError) {
                 emit error(NETWORK_ERROR,url.toString() + " :: " + fileName);
             } else {
@@ -636,7 +2315,7 @@ public slots:
         });
 
         connect(DownloadManager, &QEasyDownloader::DownloadProgress, this, &QInstallerBridge::ProxyDownloadProgress);
-        connect(DownloadManager, &QEasyDownloader::Finished, this, &QInstallerBridge::FinishedPackageVerifications);
+        connect(DownloadManager, &QEasyDownloader::Finished, this, &QInstallerBridge::FinishedDownloadingUpdates);
 
         // Lets enable iteration in our faithfull downloader.
         DownloadManager->Iterated(true);
@@ -651,6 +2330,7 @@ public slots:
 
             auto TFile = new QTemporaryFile;
             TFile->open();
+            PendingMetaPackages.insert(QUrl(MetaURL), item);
             DownloadManager->Download(MetaURL, TFile->fileName());
             CachedTemporaryFiles.push_back(TFile);
         }
@@ -659,49 +2339,80 @@ public slots:
 
     void InstallUpdates()
     {
-        if(CachedPackagesData.isEmpty()) {
+        if(postToOwnerThread("InstallUpdates")) {
             return;
         }
 
-        connect(&Archiver, &QArchive::Extractor::status,
-        [&](const QString& Archive,const QString& file) {
-            (void)Archive;
-            emit updatesInstalling(file);
-            return;
-        });
-
-        connect(&Archiver, &QArchive::Extractor::error,
-        [&](short errorCode, const QString& Archive) {
-            emit error(errorCode, Archive);
+        if(CachedPackagesData.isEmpty() || !BusyInstallWorkers.isEmpty() || !StreamWorkers.isEmpty() ||
+           PlanningInstalls) {
             return;
-        });
+        }
 
-        connect(&Archiver, &QArchive::Extractor::finished,
-        [&]() {
-            FreeTemporaryFiles();
-            CachedPackagesData.clear();
+        InstalledCount = 0;
+        InstallBytesWritten = InstallBytesSkipped = 0;
+        InstallFailed = InstallStopping = false;
+        ReadyPackages.clear();
+        PackageTraceBegins.clear();
+        PackageMetricBegins.clear();
+        InstallTraceBegin = QIB_TRACE_BEGIN();
+
+        if(atomicInstall) {
+            AtomicStaging = true;
+            QDir(nextTree()).removeRecursively(); // A left over from a failed install.
+            if(!linkTree(liveTree(), nextTree())) {
+                DiscardAtomicInstall();
+                emit error(INSTALL_COMMIT_ERROR, nextTree());
+                return;
+            }
+        }
+        dependencyGraph(&UnmetDependencies, &DependentPackages);
 
-            /*
-             * Update Local Information!
-             * ~This is Very Important than Anything~
-            */
-            for(int item = 0; item < Updates.size() ; ++item) {
-                RepoMergeXML(Updates.at(item).PackageName, Updates.at(item).Version);
+        /*
+         * Packages which run side by side must not write the same file ,
+         * the result would depend on which one is faster. Their paths are
+         * listed first and such packages wait on each other.
+        */
+        QVector<QStringList> Archives(Updates.size());
+        QVector<QString> StagedTrees(Updates.size());
+        int Payloads = 0;
+        for(int item = 0; item < Updates.size() ; ++item) {
+            Archives[item] = CachedPackageArchives.value(Updates.at(item).PackageName);
+            StagedTrees[item] = StagedPackageTrees.value(Updates.at(item).PackageName);
+            if(!Archives.at(item).isEmpty() || !StagedTrees.at(item).isEmpty()) {
+                ++Payloads;
             }
+        }
+        if(maxParallelInstalls < 2 || Payloads < 2) {
+            StartInstalls();
+            return;
+        }
 
-            emit updatesInstalled();
+        PlanningInstalls = true;
+        auto Watcher = new QFutureWatcher<QVector<QStringList>>(this);
+        connect(Watcher, &QFutureWatcher<QVector<QStringList>>::finished, this, [this, Watcher]() {
+            QVector<QStringList> Paths = Watcher->result();
+            Watcher->deleteLater();
+            PlanningInstalls = false;
+            if(InstallStopping) {
+                FinishedStoppingInstalls();
+                return;
+            }
+            SerializeOverlappingPackages(Paths);
+            StartInstalls();
             return;
         });
-
-        Archiver.addArchive(CachedPackagesData);
-        Archiver.setDestination(installationPath);
-        Archiver.start(); // Start the extraction off!
+        Watcher->setFuture(QtConcurrent::run(&QInstallerBridge::packagePaths, Archives, StagedTrees));
         return;
     }
 
     void AbortDownload()
     {
+        if(postToOwnerThread("AbortDownload")) {
+            return;
+        }
+
         DownloadManager->Pause();
+        AbortArchiveStreams();
         FreeTemporaryFiles();
         emit DownloadAborted();
         return;
@@ -709,20 +2420,64 @@ public slots:
 
     void AbortInstallation()
     {
-        /*
-         * Thanks to QArchive v0.0.3  ,
-         * this is handled with elegance!
-        */
-        connect(&Archiver, &QArchive::Extractor::stopped,
-        [&]() {
-            FreeTemporaryFiles();
-            emit InstallationAborted();
+        if(postToOwnerThread("AbortInstallation")) {
             return;
-        });
+        }
+
+        if(BusyInstallWorkers.isEmpty() && !PlanningInstalls) {
+            return;
+        }
+
+        InstallStopping = true;
+        ReadyPackages.clear();
+        for(auto Worker : BusyInstallWorkers.keys()) {
+            Worker->stop();
+        }
+        return;
+    }
+
+    void RollbackInstallation()
+    {
+        if(postToOwnerThread("RollbackInstallation")) {
+            return;
+        }
+
+        if(!BusyInstallWorkers.isEmpty() || AtomicStaging) {
+            return;
+        }
+
+        if(!QDir(previousTree()).exists() || !swapPaths(previousTree(), liveTree())) {
+            emit error(ROLLBACK_ERROR, previousTree());
+            return;
+        }
+        if(!isInstallationFile(componentsXML) && QFile::exists(componentsXML + ".previous")) {
+            swapPaths(componentsXML + ".previous", componentsXML);
+        }
+
+        if(debug) {
+            qDebug() << "QInstallerBridge::Rolled Back :: " << liveTree();
+        }
+        emit InstallationRolledBack();
+        return;
+    }
 
-        if(Archiver.isRunning()) {
-            Archiver.stop();
+    void VerifyInstallation()
+    {
+        if(postToOwnerThread("VerifyInstallation")) {
+            return;
         }
+
+        auto Watcher = new QFutureWatcher<QStringList>(this);
+        connect(Watcher, &QFutureWatcher<QStringList>::finished, this, [this, Watcher]() {
+            QStringList Damaged = Watcher->result();
+            Watcher->deleteLater();
+            if(debug) {
+                qDebug() << "QInstallerBridge::Verified Installation , Damaged Files :: " << Damaged.size();
+            }
+            emit installationVerified(Damaged);
+            return;
+        });
+        Watcher->setFuture(QtConcurrent::run(&QInstallerBridge::scanInstallation, liveTree()));
         return;
     }
 signals:
@@ -738,23 +2493,195 @@ signals:
     void updateDownloaded(const QUrl&, const QString&);
     void updatesDownloaded();
     void updatesInstalling(const QString&);
+    void updatesInstallProgress(const QString&, qint64, qint64, const QStringList&);
+    void updatesWriteStatistics(qint64, qint64);
     void updatesInstalled();
 
     void DownloadAborted();
     void InstallationAborted();
+    void InstallationRolledBack();
+    void installationVerified(const QStringList&);
+    void traceSpans(const QVector<QInstallerBridgeTrace::Span>&);
 
 private:
-    int buff = 0;
+    void registerMetaTypes();
+    void installInstrumentation();
+
     bool debug = false,
-         doUpdate = false;
+         doUpdate = false,
+         InstallFailed = false,
+         InstallStopping = false,
+         externalNetworkManager = false,
+         streamingInstall = false,
+         atomicInstall = false,
+         skipUnchangedFiles = false,
+         writeManifests = false,
+         deltaUpdates = true,
+         perFileStatus = false,
+         tracing = false,
+         AtomicStaging = false,
+         DownloadsFinished = false,
+         DeltaDownloadsIdle = false,
+         StreamFailed = false,
+         PlanningInstalls = false;
+    int maxParallelInstalls = QThread::idealThreadCount(),
+        InstalledCount = 0;
+    qint64 InstallBytesWritten = 0,
+           InstallBytesSkipped = 0,
+           CheckTraceBegin = 0, // 0 while not traced.
+           DownloadTraceBegin = 0,
+           InstallTraceBegin = 0,
+           CheckMetricBegin = 0;
+    quint64 TraceCursor = 0;
+    QHash<int, qint64> PackageTraceBegins,
+          PackageMetricBegins;
     QString repoLink,
             componentsXML,
             installationPath,
             CurrentCheckFile;
     QStringList CachedPackagesData;
+    QHash<QUrl, int> PendingMetaPackages;
+    QHash<QString, QStringList> CachedPackageArchives;
+    QHash<QString, QString> InstalledVersions;
+    QHash<QString, QArchive::EntryFilter> PackageFilters;
+    QHash<QString, int> DeltaArchiveFiles;
+    QSet<QString> DeltaPackages,
+          FailedDeltaPackages;
+    QHash<QString, int> RunningDeltaApplies;
+    QHash<QString, QArchive::ArchiveStream*> ArchiveStreams;
+    QHash<QString, QArchive::Extractor*> StreamWorkers;
+    QHash<QString, QString> StreamPackages,
+          StagedPackageTrees;
+    QSet<QString> StartedStreams;
+    QHash<QString, QVector<QArchive::ManifestEntry>> PackageManifests;
+    QVector<int> UnmetDependencies;
+    QHash<QString, QList<int>> DependentPackages;
+    QList<int> ReadyPackages;
+    QVector<QArchive::Extractor*> InstallWorkers;
+    QHash<QArchive::Extractor*, int> BusyInstallWorkers;
     QVector<QTemporaryFile*> CachedTemporaryFiles;
     QVector<PackageUpdate> Updates;
     QEasyDownloader *DownloadManager;
-    QArchive::Extractor Archiver;
+    QThread *WorkerThread = NULL;
+
+    static constexpr const char *ManifestDirectory = ".QInstallerBridgeManifests";
+    static const quint32 ManifestMagic = 0x5149424d; // "QIBM"
+    static const quint16 ManifestVersion = 1;
 }; // Class QInstallerBridge Ends
+
+Q_DECLARE_METATYPE(QInstallerBridge::PackageUpdate)
+
+/*
+ * Needed to emit updatesList across threads.
+*/
+inline void QInstallerBridge::registerMetaTypes()
+{
+    qRegisterMetaType<QInstallerBridge::PackageUpdate>("PackageUpdate");
+    qRegisterMetaType<QVector<QInstallerBridge::PackageUpdate>>("QVector<PackageUpdate>");
+    qRegisterMetaType<QVector<QInstallerBridgeTrace::Span>>("QVector<QInstallerBridgeTrace::Span>");
+    return;
+}
+
+/*
+ * QArchive and QEasyDownloader include neither the trace nor the metrics ,
+ * their reports come here. Compiled with QINSTALLER_BRIDGE_NO_TRACE or
+ * QINSTALLER_BRIDGE_NO_METRICS they are dropped.
+*/
+inline qint64 QInstallerBridgeTraceBegin()
+{
+    return QIB_TRACE_BEGIN();
+}
+
+inline void QInstallerBridgeTraceEnd(const char *phase, const QString& subject, qint64 begin, qint64 bytes)
+{
+    QIB_TRACE_END(phase, subject, begin, bytes);
+    return;
+}
+
+inline qint64 QInstallerBridgeMetricNow()
+{
+    return QIB_METRIC_NOW();
+}
+
+inline void QInstallerBridgeArchiveMetricAdd(QArchive::MetricCounter counter, qint64 value)
+{
+    switch(counter) {
+    case QArchive::EXTRACTED_FILES_METRIC:
+        QIB_METRIC_ADD(EXTRACTED_FILES, value);
+        break;
+    case QArchive::EXTRACTED_BYTES_METRIC:
+        QIB_METRIC_ADD(EXTRACTED_BYTES, value);
+        break;
+    case QArchive::UNCHANGED_BYTES_METRIC:
+        QIB_METRIC_ADD(UNCHANGED_BYTES, value);
+        break;
+    }
+    return;
+}
+
+inline void QInstallerBridgeArchiveMetricObserve(QArchive::MetricPhase phase, qint64 begin)
+{
+    switch(phase) {
+    case QArchive::EXTRACT_PHASE_METRIC:
+        QIB_METRIC_OBSERVE(EXTRACT_PHASE, begin);
+        break;
+    }
+    return;
+}
+
+inline void QInstallerBridgeDownloaderMetricAdd(QEasyDownloader::MetricCounter counter, qint64 value)
+{
+    switch(counter) {
+    case QEasyDownloader::DOWNLOADED_BYTES_METRIC:
+        QIB_METRIC_ADD(DOWNLOADED_BYTES, value);
+        break;
+    case QEasyDownloader::RESUMED_BYTES_METRIC:
+        QIB_METRIC_ADD(RESUMED_BYTES, value);
+        break;
+    case QEasyDownloader::DOWNLOAD_RETRIES_METRIC:
+        QIB_METRIC_ADD(DOWNLOAD_RETRIES, value);
+        break;
+    case QEasyDownloader::DOWNLOAD_TIMEOUTS_METRIC:
+        QIB_METRIC_ADD(DOWNLOAD_TIMEOUTS, value);
+        break;
+    case QEasyDownloader::DOWNLOAD_ERRORS_METRIC:
+        QIB_METRIC_ADD(DOWNLOAD_ERRORS, value);
+        break;
+    }
+    return;
+}
+
+inline void QInstallerBridgeDownloaderMetricObserve(QEasyDownloader::MetricPhase phase, qint64 begin)
+{
+    switch(phase) {
+    case QEasyDownloader::PROBE_PHASE_METRIC:
+        QIB_METRIC_OBSERVE(PROBE_PHASE, begin);
+        break;
+    case QEasyDownloader::TRANSFER_PHASE_METRIC:
+        QIB_METRIC_OBSERVE(TRANSFER_PHASE, begin);
+        break;
+    }
+    return;
+}
+
+inline void QInstallerBridge::installInstrumentation()
+{
+    static const QArchive::Instrumentation ArchiveHooks = {
+        &QInstallerBridgeTraceBegin,
+        &QInstallerBridgeTraceEnd,
+        &QInstallerBridgeMetricNow,
+        &QInstallerBridgeArchiveMetricAdd,
+        &QInstallerBridgeArchiveMetricObserve
+    };
+    static const QEasyDownloader::Instrumentation DownloaderHooks = {
+        &QInstallerBridgeTraceBegin,
+        &QInstallerBridgeTraceEnd,
+        &QInstallerBridgeMetricNow,
+        &QInstallerBridgeDownloaderMetricAdd,
+        &QInstallerBridgeDownloaderMetricObserve
+    };
+    QArchive::setInstrumentation(&ArchiveHooks);
+    QEasyDownloader::setInstrumentation(&DownloaderHooks);
+    return;
+}
 #endif // QINSTALLER_BRIDGE_HPP_INCLUDED
@@ -9,4 +9,14 @@ QT += core concurrent network xml
 # Input
 HEADERS += QInstallerBridge.hpp \
            QArchive/QArchive.hpp \
-           QEasyDownloader/QEasyDownloader.hpp
+           QEasyDownloader/QEasyDownloader.hpp \
+           QInstallerBridgeDelta.hpp \
+           QInstallerBridgeTrace.hpp \
+           QInstallerBridgeMetrics.hpp \
+           QInstallerBridgeMetricsEndpoint.hpp
+
+# Optional io_uring writer for the extraction , qmake CONFIG+=io_uring (needs liburing).
+io_uring {
+    DEFINES += QARCHIVE_USE_IO_URING
+    LIBS += -luring
+}
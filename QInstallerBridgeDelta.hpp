@@ -0,0 +1,490 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Antony jr
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ *  @filename		: QInstallerBridgeDelta.hpp
+ *  @description	: Binary deltas between two versions of a package , used by
+ *  			  QInstallerBridge for delta updates and by the delta
+ *  			  generator tool.
+ *  @tag		: v0.0.4
+ * -----------------------------------------------------------------------------
+*/
+#if !defined(QINSTALLER_BRIDGE_DELTA_HPP_INCLUDED)
+#define QINSTALLER_BRIDGE_DELTA_HPP_INCLUDED
+#include <QtCore>
+#include "QArchive/QArchive.hpp"
+
+/*
+ * Class QInstallerBridgeDelta
+ * ---------------------------
+ *
+ *  A rsync like binary delta of a file against its older version. The
+ *  base is cut in blocks which are indexed by a rolling checksum , the
+ *  target is scanned byte by byte and every block found in the base
+ *  becomes a COPY , the bytes in between become a INSERT.
+ *
+ *  Delta format :
+ *   "QIBD" , quint8 version , 20 bytes SHA1 of the base , 20 bytes SHA1 of
+ *   the target , varint target size , then the ops until END :
+ *	COPY   (1) - varint offset , varint length , bytes from the base.
+ *	INSERT (2) - varint length , then the bytes.
+ *	END    (0)
+ *  Varints are little endian base 128.
+ *
+ *  A delta archive is a normal archive of the files which changed , a
+ *  entry named <path>.qibdelta is a delta against <path> of the installed
+ *  tree , every other entry is a file as it is. Directories are created ,
+ *  links are not supported and fail the archive.
+ *
+ *  Static Methods:
+ *	QByteArray encode(const QByteArray& base ,
+ *			  const QByteArray& target ,
+ *			  int blockSize)		- Returns the delta from base to target.
+ *	short apply(const QByteArray& delta ,
+ *		    QIODevice *base ,
+ *		    QIODevice *target ,
+ *		    QByteArray *digest)			- Writes the target , verifies the base and
+ *							  the target against their SHA1.
+ *	short applyArchive(const QString& archive ,
+ *			   const QString& base ,
+ *			   const QString& staging ,
+ *			   QVector<QArchive::ManifestEntry> *manifest ,
+ *			   QString *failedPath ,
+ *			   const QArchive::EntryFilter& filter) - Applies a delta archive against the tree
+ *							  in base , the new files are written to
+ *							  staging and the base is never touched.
+ *							  Files the filter drops are skipped.
+ *
+ *  All of them are thread safe , the bridge runs applyArchive() on the
+ *  global thread pool.
+*/
+class QInstallerBridgeDelta
+{
+public:
+    /*
+     * Error codes!
+    */
+    enum {
+        NO_DELTA_ERROR = 0,
+        DELTA_FORMAT_ERROR,
+        DELTA_BASE_MISMATCH,
+        DELTA_TARGET_MISMATCH,
+        DELTA_ARCHIVE_ERROR,
+        DELTA_WRITE_ERROR
+    };
+
+    static constexpr const char *Suffix = ".qibdelta";
+    static const int DefaultBlockSize = 2048;
+
+    static QByteArray encode(const QByteArray& base, const QByteArray& target, int blockSize = DefaultBlockSize)
+    {
+        QByteArray Delta(Magic, 4);
+        Delta.append(char(FormatVersion));
+        Delta.append(QCryptographicHash::hash(base, QCryptographicHash::Sha1));
+        Delta.append(QCryptographicHash::hash(target, QCryptographicHash::Sha1));
+        appendVarint(&Delta, target.size());
+
+        const uchar *Base = reinterpret_cast<const uchar*>(base.constData()),
+                     *Target = reinterpret_cast<const uchar*>(target.constData());
+        const qint64 BaseSize = base.size(),
+                     TargetSize = target.size();
+
+        QMultiHash<quint32, qint64> Blocks;
+        for(qint64 offset = 0; offset + blockSize <= BaseSize; offset += blockSize) {
+            Blocks.insert(weakChecksum(Base + offset, blockSize), offset);
+        }
+
+        qint64 position = 0,
+               literal = 0;
+        quint32 a = 0,
+                b = 0;
+        bool summed = false;
+        while(!Blocks.isEmpty() && position + blockSize <= TargetSize) {
+            if(!summed) {
+                sumBlock(Target + position, blockSize, &a, &b);
+                summed = true;
+            }
+
+            qint64 match = -1;
+            const quint32 Key = a | (b << 16);
+            auto Candidate = Blocks.constFind(Key);
+            // Bounded , a weak checksum shared by many blocks must not make it quadratic.
+            for(int tries = 0; Candidate != Blocks.constEnd() && Candidate.key() == Key && tries < 16;
+                ++Candidate, ++tries) {
+                if(!memcmp(Base + Candidate.value(), Target + position, blockSize)) {
+                    match = Candidate.value();
+                    break;
+                }
+            }
+
+            if(match < 0) {
+                if(position + blockSize < TargetSize) {
+                    const quint32 Out = Target[position],
+                                  In = Target[position + blockSize];
+                    a = (a - Out + In) & 0xffff;
+                    b = (b - quint32(blockSize) * Out + a) & 0xffff;
+                }
+                ++position;
+                continue;
+            }
+
+            // Grow the match both ways , files rarely change on block boundaries.
+            qint64 length = blockSize;
+            while(match + length < BaseSize && position + length < TargetSize &&
+                  Base[match + length] == Target[position + length]) {
+                ++length;
+            }
+            while(match > 0 && position > literal && Base[match - 1] == Target[position - 1]) {
+                --match;
+                --position;
+                ++length;
+            }
+
+            appendInsert(&Delta, Target + literal, position - literal);
+            Delta.append(char(COPY));
+            appendVarint(&Delta, match);
+            appendVarint(&Delta, length);
+            position += length;
+            literal = position;
+            summed = false;
+        }
+        appendInsert(&Delta, Target + literal, TargetSize - literal);
+        Delta.append(char(END));
+        return Delta;
+    }
+
+    static short apply(const QByteArray& delta, QIODevice *base, QIODevice *target, QByteArray *digest = NULL)
+    {
+        const int HeaderSize = 4 + 1 + 20 + 20;
+        if(delta.size() < HeaderSize || memcmp(delta.constData(), Magic, 4) ||
+           quint8(delta.at(4)) != FormatVersion) {
+            return DELTA_FORMAT_ERROR;
+        }
+        const QByteArray BaseDigest = delta.mid(5, 20),
+                         TargetDigest = delta.mid(25, 20);
+        int position = HeaderSize;
+        quint64 TargetSize = 0;
+        if(!readVarint(delta, &position, &TargetSize)) {
+            return DELTA_FORMAT_ERROR;
+        }
+
+        // A delta is only ever applied to the very file it was made from.
+        QCryptographicHash BaseHash(QCryptographicHash::Sha1);
+        if(!base->seek(0) || !BaseHash.addData(base) || BaseHash.result() != BaseDigest) {
+            return DELTA_BASE_MISMATCH;
+        }
+
+        QCryptographicHash TargetHash(QCryptographicHash::Sha1);
+        QByteArray Buffer;
+        quint64 written = 0;
+        for(;;) {
+            if(position >= delta.size()) {
+                return DELTA_FORMAT_ERROR;
+            }
+            const quint8 Op = delta.at(position++);
+            if(Op == END) {
+                break;
+            }
+
+            quint64 offset = 0,
+                    length = 0;
+            if(Op == COPY) {
+                if(!readVarint(delta, &position, &offset) || !readVarint(delta, &position, &length) ||
+                   offset + length > quint64(base->size()) || !base->seek(offset)) {
+                    return DELTA_FORMAT_ERROR;
+                }
+                while(length > 0) {
+                    Buffer = base->read(qMin<quint64>(length, 1048576));
+                    if(Buffer.isEmpty()) {
+                        return DELTA_BASE_MISMATCH;
+                    }
+                    if(target->write(Buffer) != Buffer.size()) {
+                        return DELTA_WRITE_ERROR;
+                    }
+                    TargetHash.addData(Buffer);
+                    length -= Buffer.size();
+                    written += Buffer.size();
+                }
+            } else if(Op == INSERT) {
+                if(!readVarint(delta, &position, &length) || length > quint64(delta.size() - position)) {
+                    return DELTA_FORMAT_ERROR;
+                }
+                if(target->write(delta.constData() + position, length) != qint64(length)) {
+                    return DELTA_WRITE_ERROR;
+                }
+                TargetHash.addData(delta.constData() + position, length);
+                position += length;
+                written += length;
+            } else {
+                return DELTA_FORMAT_ERROR;
+            }
+        }
+
+        const QByteArray Result = TargetHash.result();
+        if(written != TargetSize || Result != TargetDigest) {
+            return DELTA_TARGET_MISMATCH;
+        }
+        if(digest != NULL) {
+            *digest = Result;
+        }
+        return NO_DELTA_ERROR;
+    }
+
+    static short applyArchive(const QString& archive,
+                              const QString& base,
+                              const QString& staging,
+                              QVector<QArchive::ManifestEntry> *manifest,
+                              QString *failedPath,
+                              const QArchive::EntryFilter& filter = QArchive::EntryFilter())
+    {
+        struct archive *Archive = archive_read_new();
+        archive_read_support_format_all(Archive);
+        archive_read_support_filter_all(Archive);
+
+        QFile ArchiveFile(archive);
+        if(QArchive::openArchiveFile(Archive, &ArchiveFile, 1048576, true) != ARCHIVE_OK) {
+            archive_read_free(Archive);
+            *failedPath = archive;
+            return DELTA_ARCHIVE_ERROR;
+        }
+
+        struct archive_entry *Entry;
+        short result = NO_DELTA_ERROR;
+        while(result == NO_DELTA_ERROR) {
+            int ret = archive_read_next_header(Archive, &Entry);
+            if(ret == ARCHIVE_EOF) {
+                break;
+            }
+            if(ret < ARCHIVE_WARN) {
+                *failedPath = archive;
+                result = DELTA_ARCHIVE_ERROR;
+                break;
+            }
+
+            QString Path = QDir::cleanPath(QString::fromUtf8(archive_entry_pathname(Entry)));
+            *failedPath = Path;
+            if(Path.isEmpty() || Path == "." || QDir::isAbsolutePath(Path) ||
+               Path == ".." || Path.startsWith("../")) {
+                result = DELTA_ARCHIVE_ERROR;
+                break;
+            }
+
+            if(archive_entry_filetype(Entry) == AE_IFDIR) {
+                if(!QDir().mkpath(staging + "/" + Path)) {
+                    result = DELTA_WRITE_ERROR;
+                }
+                continue;
+            }
+            if(archive_entry_filetype(Entry) != AE_IFREG) {
+                result = DELTA_ARCHIVE_ERROR;
+                break;
+            }
+
+            const bool isDelta = Path.endsWith(QLatin1String(Suffix));
+            const QString Relative = isDelta ? Path.left(Path.size() - int(strlen(Suffix))) : Path;
+            if(!filter.accepts(Relative.toUtf8().constData())) {
+                archive_read_data_skip(Archive);
+                continue;
+            }
+            const QString Output = staging + "/" + Relative;
+            QFile Target(Output);
+            if(!QDir().mkpath(QFileInfo(Output).path()) ||
+               !Target.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                result = DELTA_WRITE_ERROR;
+                break;
+            }
+
+            QByteArray Digest;
+            if(isDelta) {
+                QByteArray Delta;
+                QFile Base(base + "/" + Relative);
+                if(!readEntry(Archive, &Delta)) {
+                    result = DELTA_ARCHIVE_ERROR;
+                } else if(!Base.open(QIODevice::ReadOnly)) {
+                    result = DELTA_BASE_MISMATCH;
+                } else {
+                    result = apply(Delta, &Base, &Target, &Digest);
+                    Target.setPermissions(Base.permissions());
+                }
+            } else {
+                result = copyEntry(Archive, &Target, &Digest);
+                Target.setPermissions(permissionsFromMode(archive_entry_perm(Entry)));
+            }
+            Target.close();
+            if(result == NO_DELTA_ERROR && Target.error() != QFileDevice::NoError) {
+                result = DELTA_WRITE_ERROR;
+            }
+
+            if(result == NO_DELTA_ERROR && manifest != NULL) {
+                QArchive::ManifestEntry Written;
+                QFileInfo Info(Output);
+                Written.path = Relative;
+                Written.size = Info.size();
+                Written.mtime = Info.lastModified().toMSecsSinceEpoch() * 1000000;
+                Written.digest = Digest;
+                manifest->append(Written);
+            }
+        }
+
+        archive_read_free(Archive);
+        if(result == NO_DELTA_ERROR) {
+            failedPath->clear();
+        }
+        return result;
+    }
+
+private:
+    enum {
+        END = 0,
+        COPY = 1,
+        INSERT = 2
+    };
+
+    static constexpr const char *Magic = "QIBD";
+    static const quint8 FormatVersion = 1;
+
+    static void sumBlock(const uchar *data, int length, quint32 *a, quint32 *b)
+    {
+        quint32 sumA = 0,
+                sumB = 0;
+        for(int byte = 0; byte < length ; ++byte) {
+            sumA += data[byte];
+            sumB += quint32(length - byte) * data[byte];
+        }
+        *a = sumA & 0xffff;
+        *b = sumB & 0xffff;
+        return;
+    }
+
+    static quint32 weakChecksum(const uchar *data, int length)
+    {
+        quint32 a, b;
+        sumBlock(data, length, &a, &b);
+        return a | (b << 16);
+    }
+
+    static void appendVarint(QByteArray *out, quint64 value)
+    {
+        while(value >= 0x80) {
+            out->append(char((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out->append(char(value));
+        return;
+    }
+
+    static bool readVarint(const QByteArray& in, int *position, quint64 *value)
+    {
+        *value = 0;
+        for(int shift = 0; shift < 64 && *position < in.size() ; shift += 7) {
+            const quint8 Byte = in.at((*position)++);
+            *value |= quint64(Byte & 0x7f) << shift;
+            if(!(Byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void appendInsert(QByteArray *out, const uchar *data, qint64 length)
+    {
+        if(length <= 0) {
+            return;
+        }
+        out->append(char(INSERT));
+        appendVarint(out, length);
+        out->append(reinterpret_cast<const char*>(data), length);
+        return;
+    }
+
+    static bool readEntry(struct archive *arch, QByteArray *data)
+    {
+        char Buffer[65536];
+        la_ssize_t length;
+        while((length = archive_read_data(arch, Buffer, sizeof(Buffer))) > 0) {
+            data->append(Buffer, length);
+        }
+        return (length == 0);
+    }
+
+    static short copyEntry(struct archive *arch, QFile *target, QByteArray *digest)
+    {
+        QCryptographicHash Hash(QCryptographicHash::Sha1);
+        char Buffer[65536];
+        la_ssize_t length;
+        while((length = archive_read_data(arch, Buffer, sizeof(Buffer))) > 0) {
+            if(target->write(Buffer, length) != length) {
+                return DELTA_WRITE_ERROR;
+            }
+            Hash.addData(Buffer, length);
+        }
+        if(length < 0) {
+            return DELTA_ARCHIVE_ERROR;
+        }
+        *digest = Hash.result();
+        return NO_DELTA_ERROR;
+    }
+
+    static QFileDevice::Permissions permissionsFromMode(int mode)
+    {
+        QFileDevice::Permissions Permissions;
+        if(mode & 0400) {
+            Permissions |= QFileDevice::ReadOwner | QFileDevice::ReadUser;
+        }
+        if(mode & 0200) {
+            Permissions |= QFileDevice::WriteOwner | QFileDevice::WriteUser;
+        }
+        if(mode & 0100) {
+            Permissions |= QFileDevice::ExeOwner | QFileDevice::ExeUser;
+        }
+        if(mode & 0040) {
+            Permissions |= QFileDevice::ReadGroup;
+        }
+        if(mode & 0020) {
+            Permissions |= QFileDevice::WriteGroup;
+        }
+        if(mode & 0010) {
+            Permissions |= QFileDevice::ExeGroup;
+        }
+        if(mode & 0004) {
+            Permissions |= QFileDevice::ReadOther;
+        }
+        if(mode & 0002) {
+            Permissions |= QFileDevice::WriteOther;
+        }
+        if(mode & 0001) {
+            Permissions |= QFileDevice::ExeOther;
+        }
+        return Permissions;
+    }
+}; // Class QInstallerBridgeDelta Ends
+#endif // QINSTALLER_BRIDGE_DELTA_HPP_INCLUDED
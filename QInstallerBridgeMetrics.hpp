@@ -0,0 +1,276 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Antony jr
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ *  @filename		: QInstallerBridgeMetrics.hpp
+ *  @description	: Counters and latency histograms of the bridge , the
+ *  			  downloader and the extractor , in the Prometheus text
+ *  			  format.
+ *  @tag		: v0.0.4
+ * -----------------------------------------------------------------------------
+*/
+#if !defined(QINSTALLER_BRIDGE_METRICS_HPP_INCLUDED)
+#define QINSTALLER_BRIDGE_METRICS_HPP_INCLUDED
+#include <QtCore>
+#include <atomic>
+#include <chrono>
+
+/*
+ * Class QInstallerBridgeMetrics
+ * -----------------------------
+ *
+ *  A fixed registry of counters and histograms for the whole process ,
+ *  every one a relaxed atomic , so any thread updates them without a
+ *  lock and nothing is allocated. Long running updaters read them with
+ *  toPrometheus() or let a scraper fetch them from the endpoint of
+ *  QInstallerBridgeMetricsEndpoint.hpp.
+ *
+ *  Counters:
+ *	DOWNLOADED_BYTES	- Bytes the downloader received.
+ *	RESUMED_BYTES		- Bytes a partial download already had , not fetched again.
+ *	UNCHANGED_BYTES		- Bytes of installed files with the same content , not written again.
+ *	DOWNLOAD_RETRIES	- Paused downloads which were resumed.
+ *	DOWNLOAD_TIMEOUTS	- Downloads without progress for the timeout time.
+ *	DOWNLOAD_ERRORS		- Network errors , canceled requests are not counted.
+ *	CHECKSUM_FAILURES	- Metas , archives and deltas whose SHA1 did not match.
+ *	EXTRACTED_FILES		- Regular files taken out of archives , unchanged ones included.
+ *	EXTRACTED_BYTES		- Their bytes.
+ *	UPDATE_CHECKS		- Updates.xml files checked.
+ *	PACKAGES_INSTALLED	- Packages installed.
+ *
+ *  Histograms of the seconds a phase took , per archive or file:
+ *	CHECK_PHASE , PROBE_PHASE , TRANSFER_PHASE , VERIFY_PHASE ,
+ *	DELTA_APPLY_PHASE , EXTRACT_PHASE , INSTALL_PACKAGE_PHASE
+ *
+ *  Static Methods:
+ *	void add(Counter , qint64)		- Adds to a counter.
+ *	qint64 value(Counter)			- The counter now.
+ *	qint64 now()				- Nanoseconds of a monotonic clock , never 0.
+ *	void observe(Phase , qint64 nsecs)	- Adds a duration to the histogram of the phase.
+ *	void observeSince(Phase , qint64)	- The same from a now() on , nothing if it is 0.
+ *	void reset()				- Every counter and histogram back to zero.
+ *	QByteArray toPrometheus()		- The Prometheus text exposition format (0.0.4).
+ *
+ *  Macros:
+ *	QIB_METRIC_ADD(counter , value) , QIB_METRIC_NOW() and
+ *	QIB_METRIC_OBSERVE(phase , begin) for add() , now() and observeSince().
+ *
+ *  Define QINSTALLER_BRIDGE_NO_METRICS to compile them out. QArchive and
+ *  QEasyDownloader do not include this header , the bridge gives them hooks
+ *  (their setInstrumentation()) which call the macros.
+*/
+class QInstallerBridgeMetrics
+{
+public:
+    enum Counter {
+        DOWNLOADED_BYTES = 0,
+        RESUMED_BYTES,
+        UNCHANGED_BYTES,
+        DOWNLOAD_RETRIES,
+        DOWNLOAD_TIMEOUTS,
+        DOWNLOAD_ERRORS,
+        CHECKSUM_FAILURES,
+        EXTRACTED_FILES,
+        EXTRACTED_BYTES,
+        UPDATE_CHECKS,
+        PACKAGES_INSTALLED,
+        COUNTER_COUNT
+    };
+
+    enum Phase {
+        CHECK_PHASE = 0,
+        PROBE_PHASE,
+        TRANSFER_PHASE,
+        VERIFY_PHASE,
+        DELTA_APPLY_PHASE,
+        EXTRACT_PHASE,
+        INSTALL_PACKAGE_PHASE,
+        PHASE_COUNT
+    };
+
+    static void add(Counter counter, qint64 value)
+    {
+        state().counters[counter].fetch_add(value, std::memory_order_relaxed);
+        return;
+    }
+
+    static qint64 value(Counter counter)
+    {
+        return state().counters[counter].load(std::memory_order_relaxed);
+    }
+
+    static qint64 now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count() + 1;
+    }
+
+    static void observe(Phase phase, qint64 nsecs)
+    {
+        Histogram &Target = state().histograms[phase];
+        int bucket = 0;
+        while(bucket < BucketCount && nsecs > bucketBound(bucket)) {
+            ++bucket;
+        }
+        Target.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        Target.sum.fetch_add(nsecs, std::memory_order_relaxed);
+        return;
+    }
+
+    static void observeSince(Phase phase, qint64 begin)
+    {
+        if(begin != 0) {
+            observe(phase, now() - begin);
+        }
+        return;
+    }
+
+    static void reset()
+    {
+        State &Metrics = state();
+        for(int counter = 0; counter < COUNTER_COUNT ; ++counter) {
+            Metrics.counters[counter].store(0, std::memory_order_relaxed);
+        }
+        for(int phase = 0; phase < PHASE_COUNT ; ++phase) {
+            for(int bucket = 0; bucket <= BucketCount ; ++bucket) {
+                Metrics.histograms[phase].buckets[bucket].store(0, std::memory_order_relaxed);
+            }
+            Metrics.histograms[phase].sum.store(0, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    /*
+     * Every value is read on its own , a scrape while a update runs
+     * may see a bucket a little ahead of the sum.
+    */
+    static QByteArray toPrometheus()
+    {
+        static const struct {
+            const char *name,
+                  *labels,
+                  *help;
+        } Counters[COUNTER_COUNT] = {
+            { "qinstallerbridge_downloaded_bytes_total", "", "Bytes received by the downloader." },
+            { "qinstallerbridge_cached_bytes_total", "source=\"resume\"", "Bytes which did not have to be downloaded or written." },
+            { "qinstallerbridge_cached_bytes_total", "source=\"unchanged\"", "" },
+            { "qinstallerbridge_download_retries_total", "", "Paused downloads which were resumed." },
+            { "qinstallerbridge_download_timeouts_total", "", "Downloads without progress for the timeout time." },
+            { "qinstallerbridge_download_errors_total", "", "Network errors of the downloader." },
+            { "qinstallerbridge_checksum_failures_total", "", "Metas, archives and deltas whose SHA1 did not match." },
+            { "qinstallerbridge_extracted_files_total", "", "Regular files taken out of archives." },
+            { "qinstallerbridge_extracted_bytes_total", "", "Bytes of the regular files taken out of archives." },
+            { "qinstallerbridge_update_checks_total", "", "Updates.xml files checked." },
+            { "qinstallerbridge_packages_installed_total", "", "Packages installed." }
+        };
+        static const char *Phases[PHASE_COUNT] = {
+            "check", "probe", "transfer", "verify", "delta_apply", "extract", "install_package"
+        };
+
+        State &Metrics = state();
+        QByteArray Text;
+        Text.reserve(8192);
+        const char *Previous = "";
+        for(int counter = 0; counter < COUNTER_COUNT ; ++counter) {
+            if(qstrcmp(Previous, Counters[counter].name) != 0) {
+                Text += QByteArray("# HELP ") + Counters[counter].name + " " + Counters[counter].help + "\n";
+                Text += QByteArray("# TYPE ") + Counters[counter].name + " counter\n";
+                Previous = Counters[counter].name;
+            }
+            Text += Counters[counter].name;
+            if(*Counters[counter].labels) {
+                Text += QByteArray("{") + Counters[counter].labels + "}";
+            }
+            Text += " " + QByteArray::number(Metrics.counters[counter].load(std::memory_order_relaxed)) + "\n";
+        }
+
+        Text += "# HELP qinstallerbridge_phase_seconds Seconds a phase took , per package , archive or file.\n"
+                "# TYPE qinstallerbridge_phase_seconds histogram\n";
+        for(int phase = 0; phase < PHASE_COUNT ; ++phase) {
+            const Histogram &From = Metrics.histograms[phase];
+            const QByteArray Label = QByteArray("phase=\"") + Phases[phase] + "\"";
+            quint64 count = 0;
+            for(int bucket = 0; bucket <= BucketCount ; ++bucket) {
+                count += From.buckets[bucket].load(std::memory_order_relaxed);
+                const QByteArray Bound = (bucket < BucketCount) ?
+                                         QByteArray::number(bucketBound(bucket) / 1e9, 'g', 6) : QByteArray("+Inf");
+                Text += "qinstallerbridge_phase_seconds_bucket{" + Label + ",le=\"" + Bound + "\"} " +
+                        QByteArray::number(count) + "\n";
+            }
+            Text += "qinstallerbridge_phase_seconds_sum{" + Label + "} " +
+                    QByteArray::number(From.sum.load(std::memory_order_relaxed) / 1e9, 'g', 12) + "\n";
+            Text += "qinstallerbridge_phase_seconds_count{" + Label + "} " + QByteArray::number(count) + "\n";
+        }
+        return Text;
+    }
+
+private:
+    static const int BucketCount = 14;
+
+    // Upper bounds in nanoseconds , from 5 ms to 5 minutes.
+    static qint64 bucketBound(int bucket)
+    {
+        static const qint64 Bounds[BucketCount] = {
+            5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000,
+            1000000000, 2500000000LL, 5000000000LL, 10000000000LL, 30000000000LL, 60000000000LL, 300000000000LL
+        };
+        return Bounds[bucket];
+    }
+
+    struct Histogram {
+        std::atomic<quint64> buckets[BucketCount + 1]; // The last is +Inf.
+        std::atomic<qint64> sum; // Nanoseconds.
+    };
+
+    // Zero initialized , it has static storage.
+    struct State {
+        std::atomic<qint64> counters[COUNTER_COUNT];
+        Histogram histograms[PHASE_COUNT];
+    };
+
+    static State &state()
+    {
+        static State Metrics;
+        return Metrics;
+    }
+}; // Class QInstallerBridgeMetrics Ends
+
+#if defined(QINSTALLER_BRIDGE_NO_METRICS)
+#define QIB_METRIC_ADD(counter, value) do { (void)sizeof(value); } while(0)
+#define QIB_METRIC_NOW() qint64(0)
+#define QIB_METRIC_OBSERVE(phase, begin) do { (void)sizeof(begin); } while(0)
+#else
+#define QIB_METRIC_ADD(counter, value) QInstallerBridgeMetrics::add(QInstallerBridgeMetrics::counter, value)
+#define QIB_METRIC_NOW() QInstallerBridgeMetrics::now()
+#define QIB_METRIC_OBSERVE(phase, begin) QInstallerBridgeMetrics::observeSince(QInstallerBridgeMetrics::phase, begin)
+#endif
+#endif // QINSTALLER_BRIDGE_METRICS_HPP_INCLUDED
@@ -0,0 +1,171 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Antony jr
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ *  @filename		: QInstallerBridgeMetricsEndpoint.hpp
+ *  @description	: A optional scrape endpoint for QInstallerBridgeMetrics ,
+ *  			  the only part of the metrics which needs QtNetwork.
+ *  @tag		: v0.0.4
+ * -----------------------------------------------------------------------------
+*/
+#if !defined(QINSTALLER_BRIDGE_METRICS_ENDPOINT_HPP_INCLUDED)
+#define QINSTALLER_BRIDGE_METRICS_ENDPOINT_HPP_INCLUDED
+#include <QtCore>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <memory>
+#include "QInstallerBridgeMetrics.hpp"
+
+/*
+ * Class QInstallerBridgeMetricsEndpoint
+ * -------------------------------------
+ *
+ *  Serves QInstallerBridgeMetrics::toPrometheus() to a scraper , one
+ *  endpoint for the process. Kept apart so the metrics need no QtNetwork.
+ *
+ *  Static Methods:
+ *	quint16 start(quint16 port ,
+ *		      const QHostAddress&)	- Serves GET /metrics on its own thread , the
+ *						  loopback by default and a free port for 0.
+ *						  Returns the port , 0 if it cannot listen.
+ *	void stop()
+*/
+class QInstallerBridgeMetricsEndpoint
+{
+public:
+    static quint16 start(quint16 port = 0, const QHostAddress& address = QHostAddress(QHostAddress::LocalHost))
+    {
+        QMutexLocker Locker(&mutex());
+        std::unique_ptr<Listener> &Running = running();
+        if(Running) {
+            return Running->port;
+        }
+        std::unique_ptr<Listener> Server(new Listener(port, address));
+        Server->start();
+        Server->ready.acquire();
+        if(Server->port == 0) {
+            Server->wait(); // It is over , it could not listen.
+            return 0;
+        }
+        Running = std::move(Server);
+        return Running->port;
+    }
+
+    static void stop()
+    {
+        QMutexLocker Locker(&mutex());
+        running().reset();
+        return;
+    }
+
+private:
+    /*
+     * A response per connection , then it is closed. Only GET /metrics
+     * is answered , everything else is a 404.
+    */
+    class Listener : public QThread
+    {
+    public:
+        Listener(quint16 port, const QHostAddress& address)
+            : port(port),
+              address(address)
+        {
+            return;
+        }
+
+        ~Listener()
+        {
+            quit();
+            wait();
+        }
+
+        quint16 port;
+        QSemaphore ready;
+
+    protected:
+        void run() override
+        {
+            QTcpServer Server;
+            if(!Server.listen(address, port)) {
+                port = 0;
+                ready.release();
+                return;
+            }
+            port = Server.serverPort();
+            QObject::connect(&Server, &QTcpServer::newConnection, &Server, [&Server]() {
+                while(QTcpSocket *Socket = Server.nextPendingConnection()) {
+                    QObject::connect(Socket, &QTcpSocket::readyRead, Socket, [Socket]() {
+                        if(Socket->state() != QAbstractSocket::ConnectedState) {
+                            return; // Answered already.
+                        }
+                        if(!Socket->canReadLine()) {
+                            if(Socket->bytesAvailable() > 8192) {
+                                Socket->abort();
+                            }
+                            return;
+                        }
+                        const QList<QByteArray> Request = Socket->readLine().trimmed().split(' ');
+                        const bool Found = Request.value(0) == "GET" &&
+                                           Request.value(1).split('?').value(0) == "/metrics";
+                        const QByteArray Body = Found ? QInstallerBridgeMetrics::toPrometheus() : QByteArray("Not Found\n");
+                        Socket->write(QByteArray("HTTP/1.1 ") + (Found ? "200 OK" : "404 Not Found") + "\r\n"
+                                      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                      "Content-Length: " + QByteArray::number(Body.size()) + "\r\n"
+                                      "Connection: close\r\n\r\n" + Body);
+                        Socket->disconnectFromHost();
+                    });
+                    QObject::connect(Socket, &QTcpSocket::disconnected, Socket, &QObject::deleteLater);
+                }
+            });
+            ready.release();
+            exec();
+            return;
+        }
+
+    private:
+        QHostAddress address;
+    };
+
+    static QMutex &mutex()
+    {
+        static QMutex Mutex;
+        return Mutex;
+    }
+
+    static std::unique_ptr<Listener> &running()
+    {
+        static std::unique_ptr<Listener> Running;
+        return Running;
+    }
+}; // Class QInstallerBridgeMetricsEndpoint Ends
+#endif // QINSTALLER_BRIDGE_METRICS_ENDPOINT_HPP_INCLUDED
@@ -0,0 +1,390 @@
+/*
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Antony jr
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * -----------------------------------------------------------------------------
+ *
+ *  @filename		: QInstallerBridgeTrace.hpp
+ *  @description	: Spans of the phases of a update , recorded by the bridge ,
+ *  			  the downloader and the extractor into a lock free ring
+ *  			  and exported as Chrome trace events.
+ *  @tag		: v0.0.4
+ * -----------------------------------------------------------------------------
+*/
+#if !defined(QINSTALLER_BRIDGE_TRACE_HPP_INCLUDED)
+#define QINSTALLER_BRIDGE_TRACE_HPP_INCLUDED
+#include <QtCore>
+#include <atomic>
+#include <string.h>
+
+/*
+ * Class QInstallerBridgeTrace
+ * ---------------------------
+ *
+ *  One ring of spans for the whole process , every thread writes into it
+ *  without a lock. A span is a phase (a string literal) , a subject (the
+ *  package , file or URL , cut to 63 bytes) , the thread , its begin and
+ *  end in nanoseconds of a monotonic clock and the bytes it moved. Once the
+ *  ring is full the oldest spans are overwritten.
+ *
+ *  Tracing is off until setEnabled(true) , then the ring is allocated. While
+ *  it is off a span costs one relaxed atomic load. The enables are counted ,
+ *  so every setEnabled(true) needs its own setEnabled(false) and one user
+ *  turning tracing off does not turn it off for the others. Define
+ *  QINSTALLER_BRIDGE_NO_TRACE to compile all of it out.
+ *
+ *  Static Methods:
+ *	void setEnabled(bool)			- Adds or drops a user , recording while there
+ *						  is at least one.
+ *	bool isEnabled()
+ *	void setCapacity(int)			- Spans kept , rounded up to a power of two ,
+ *						  default is 16384. Only before the first
+ *						  setEnabled(true).
+ *	qint64 now()				- Begins a span , 0 while tracing is off.
+ *	void record(const char* ,
+ *		    const QString& ,
+ *		    qint64 begin ,
+ *		    qint64 bytes)		- Ends a span begun with now().
+ *	quint64 position()			- Where the next span goes , for spans().
+ *	QVector<Span> spans(quint64 *cursor)	- The spans from *cursor on which are still
+ *						  in the ring , *cursor is moved past them.
+ *						  A span written while it is read is skipped.
+ *	void clear()				- spans() starts after the spans so far.
+ *	QByteArray toChromeTrace(const QVector<Span>&) - Trace event JSON for chrome://tracing
+ *						  or Perfetto , one complete event per span
+ *						  and the names of the threads.
+ *	bool exportChromeTrace(const QString&)	- Writes all spans in the ring as that.
+ *
+ *  Macros:
+ *	QIB_TRACE_BEGIN()			- now().
+ *	QIB_TRACE_END(phase , subject ,
+ *		      begin , bytes)		- record() , the subject is only evaluated
+ *						  if the span was begun.
+ *	QIB_TRACE_SCOPE(phase , subject)	- A span until the end of the scope.
+ *
+ *  QArchive and QEasyDownloader do not include this header , the bridge
+ *  gives them hooks (their setInstrumentation()) which call the first two.
+*/
+class QInstallerBridgeTrace
+{
+public:
+    static const int SubjectSize = 64;
+    static const int DefaultCapacity = 16384;
+
+    struct Span {
+        const char *phase = NULL;
+        char subject[SubjectSize] = { 0 };
+        quint32 threadId = 0;
+        qint64 begin = 0,
+               end = 0,
+               bytes = 0;
+    };
+
+    class Scope
+    {
+    public:
+        Scope(const char *phase, const QString& subject)
+            : Phase(phase),
+              Begin(now())
+        {
+            if(Begin != 0) {
+                Subject = subject;
+            }
+            return;
+        }
+
+        void setBytes(qint64 bytes)
+        {
+            Bytes = bytes;
+            return;
+        }
+
+        ~Scope()
+        {
+            if(Begin != 0) {
+                record(Phase, Subject, Begin, Bytes);
+            }
+        }
+
+    private:
+        const char *Phase;
+        const qint64 Begin;
+        qint64 Bytes = 0;
+        QString Subject;
+    };
+
+    static void setEnabled(bool ch)
+    {
+        State &Trace = state();
+        QMutexLocker Locker(&Trace.mutex);
+        if(ch && Trace.ring.load(std::memory_order_relaxed) == NULL) {
+            quint64 Capacity = 1;
+            while(Capacity < quint64(qMax(1, Trace.capacity))) {
+                Capacity <<= 1;
+            }
+            Trace.mask = Capacity - 1;
+            // Never freed , a writer may still hold it after setEnabled(false).
+            Trace.ring.store(new Slot[Capacity](), std::memory_order_release);
+        }
+        if(ch) {
+            ++Trace.users;
+        } else if(Trace.users > 0) {
+            --Trace.users;
+        }
+        Trace.enabled.store(Trace.users > 0, std::memory_order_relaxed);
+        return;
+    }
+
+    static bool isEnabled()
+    {
+        return state().enabled.load(std::memory_order_relaxed);
+    }
+
+    static void setCapacity(int capacity)
+    {
+        State &Trace = state();
+        QMutexLocker Locker(&Trace.mutex);
+        Trace.capacity = capacity;
+        return;
+    }
+
+    static qint64 now()
+    {
+        State &Trace = state();
+        if(!Trace.enabled.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        return Trace.clock.nsecsElapsed() + 1; // 0 is "not traced".
+    }
+
+    static void record(const char *phase, const QString& subject, qint64 begin, qint64 bytes)
+    {
+        State &Trace = state();
+        Slot *Slots = Trace.ring.load(std::memory_order_acquire);
+        if(Slots == NULL || begin == 0 || !Trace.enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        Span Value;
+        Value.phase = phase;
+        Value.threadId = threadId();
+        Value.begin = begin;
+        Value.end = Trace.clock.nsecsElapsed() + 1;
+        Value.bytes = bytes;
+        const QByteArray Subject = subject.toUtf8();
+        int size = qMin(Subject.size(), SubjectSize - 1);
+        while(size > 0 && size < Subject.size() && (uchar(Subject.at(size)) & 0xc0) == 0x80) {
+            --size; // Not in the middle of a character.
+        }
+        memcpy(Value.subject, Subject.constData(), size);
+
+        /*
+         * A seqlock per slot , odd while it is written. A reader
+         * takes the span only if the sequence is the same after.
+        */
+        const quint64 Index = Trace.head.fetch_add(1, std::memory_order_relaxed);
+        Slot &Target = Slots[Index & Trace.mask];
+        Target.sequence.store(2 * Index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        Target.span = Value;
+        Target.sequence.store(2 * Index + 2, std::memory_order_release);
+        return;
+    }
+
+    static quint64 position()
+    {
+        return state().head.load(std::memory_order_acquire);
+    }
+
+    static QVector<Span> spans(quint64 *cursor)
+    {
+        State &Trace = state();
+        QVector<Span> Result;
+        Slot *Slots = Trace.ring.load(std::memory_order_acquire);
+        const quint64 Head = Trace.head.load(std::memory_order_acquire);
+        if(Slots == NULL) {
+            *cursor = Head;
+            return Result;
+        }
+
+        quint64 first = qMax(*cursor, Trace.floor.load(std::memory_order_relaxed));
+        if(first > Head) {
+            first = Head;
+        }
+        if(Head - first > Trace.mask + 1) {
+            first = Head - (Trace.mask + 1); // Overwritten.
+        }
+        Result.reserve(int(Head - first));
+        for(quint64 index = first; index < Head ; ++index) {
+            Slot &From = Slots[index & Trace.mask];
+            const quint64 Sequence = From.sequence.load(std::memory_order_acquire);
+            if(Sequence != 2 * index + 2) {
+                continue;
+            }
+            Span Copy = From.span;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(From.sequence.load(std::memory_order_relaxed) != Sequence) {
+                continue;
+            }
+            Result.append(Copy);
+        }
+        *cursor = Head;
+        return Result;
+    }
+
+    static void clear()
+    {
+        State &Trace = state();
+        Trace.floor.store(Trace.head.load(std::memory_order_acquire), std::memory_order_relaxed);
+        return;
+    }
+
+    static QByteArray toChromeTrace(const QVector<Span>& spans)
+    {
+        const qint64 Pid = QCoreApplication::applicationPid();
+        QJsonArray Events;
+
+        State &Trace = state();
+        Trace.mutex.lock();
+        const QHash<quint32, QString> Names = Trace.threadNames;
+        Trace.mutex.unlock();
+        for(auto thread = Names.constBegin(); thread != Names.constEnd() ; ++thread) {
+            QJsonObject Name;
+            Name["name"] = "thread_name";
+            Name["ph"] = "M";
+            Name["pid"] = Pid;
+            Name["tid"] = qint64(thread.key());
+            Name["args"] = QJsonObject { { "name", thread.value() } };
+            Events.append(Name);
+        }
+
+        for(auto span : spans) {
+            QJsonObject Event;
+            Event["name"] = QString::fromLatin1(span.phase);
+            Event["cat"] = "QInstallerBridge";
+            Event["ph"] = "X";
+            Event["pid"] = Pid;
+            Event["tid"] = qint64(span.threadId);
+            Event["ts"] = span.begin / 1000.0; // Microseconds.
+            Event["dur"] = (span.end - span.begin) / 1000.0;
+            Event["args"] = QJsonObject { { "subject", QString::fromUtf8(span.subject) },
+                { "bytes", span.bytes }
+            };
+            Events.append(Event);
+        }
+
+        QJsonObject Document;
+        Document["traceEvents"] = Events;
+        Document["displayTimeUnit"] = "ms";
+        return QJsonDocument(Document).toJson(QJsonDocument::Compact);
+    }
+
+    static bool exportChromeTrace(const QString& fileName)
+    {
+        quint64 Cursor = 0;
+        QSaveFile File(fileName);
+        if(!File.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        File.write(toChromeTrace(spans(&Cursor)));
+        return File.commit();
+    }
+
+private:
+    struct Slot {
+        std::atomic<quint64> sequence;
+        Span span;
+    };
+
+    struct State {
+        State()
+        {
+            clock.start();
+        }
+
+        std::atomic<bool> enabled { false };
+        std::atomic<Slot*> ring { nullptr };
+        std::atomic<quint64> head { 0 },
+            floor { 0 };
+        quint64 mask = 0;
+        int capacity = DefaultCapacity,
+            users = 0; // setEnabled(true) not yet undone.
+        QElapsedTimer clock;
+        QMutex mutex; // setEnabled() and the thread names.
+        QHash<quint32, QString> threadNames;
+    };
+
+    static State &state()
+    {
+        static State Trace;
+        return Trace;
+    }
+
+    /*
+     * Small ids in the order the threads first record , the name of
+     * the thread is kept for the trace.
+    */
+    static quint32 threadId()
+    {
+        static std::atomic<quint32> Next(1);
+        thread_local quint32 Id = 0;
+        if(Id == 0) {
+            Id = Next.fetch_add(1, std::memory_order_relaxed);
+            QThread *Thread = QThread::currentThread();
+            QString Name = (Thread != NULL) ? Thread->objectName() : QString();
+            if(Name.isEmpty()) {
+                Name = "Thread " + QString::number(Id);
+            }
+            State &Trace = state();
+            QMutexLocker Locker(&Trace.mutex);
+            Trace.threadNames.insert(Id, Name);
+        }
+        return Id;
+    }
+}; // Class QInstallerBridgeTrace Ends
+
+Q_DECLARE_METATYPE(QInstallerBridgeTrace::Span)
+
+#if defined(QINSTALLER_BRIDGE_NO_TRACE)
+#define QIB_TRACE_BEGIN() qint64(0)
+#define QIB_TRACE_END(phase, subject, begin, bytes) do { (void)sizeof(begin); } while(0)
+#define QIB_TRACE_SCOPE(phase, subject) do { } while(0)
+#else
+#define QIB_TRACE_BEGIN() QInstallerBridgeTrace::now()
+#define QIB_TRACE_END(phase, subject, begin, bytes) \
+    do { \
+        const qint64 QibTraceBegin = (begin); \
+        if(QibTraceBegin != 0) { \
+            QInstallerBridgeTrace::record(phase, subject, QibTraceBegin, bytes); \
+        } \
+    } while(0)
+#define QIB_TRACE_SCOPE(phase, subject) QInstallerBridgeTrace::Scope QibTraceScope(phase, subject)
+#endif
+#endif // QINSTALLER_BRIDGE_TRACE_HPP_INCLUDED
@@ -0,0 +1,9 @@
+TEMPLATE = subdirs
+SUBDIRS += gui_thread_busy \
+           extraction_throughput \
+           extraction_allocations \
+           compression_formats \
+           decompression_formats \
+           e2e_update \
+           xml_processing \
+           downloader_faults
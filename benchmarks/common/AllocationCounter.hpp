@@ -0,0 +1,128 @@
+/*
+ * Counts the heap allocations of the whole process by replacing malloc
+ * and friends , they forward to the glibc allocator.
+ *
+ * Include it in exactly one source file of a benchmark , it defines the
+ * allocator functions. Everything that allocates goes through them ,
+ * operator new , Qt and libarchive included. Only glibc can be hooked ,
+ * elsewhere isAvailable() is false and the counts stay zero.
+ *
+ *   AllocationCounter::start();
+ *   ... work ...
+ *   quint64 allocations = AllocationCounter::stop();
+ *
+ * A thread which calls ignoreThisThread() is never counted , like the one
+ * which runs the event loop while the work happens on other threads.
+*/
+#if !defined(ALLOCATION_COUNTER_HPP_INCLUDED)
+#define ALLOCATION_COUNTER_HPP_INCLUDED
+#include <atomic>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+namespace AllocationCounter
+{
+// Constant initialized , so the allocator can count before main().
+static std::atomic<unsigned long long> Allocations(0);
+static std::atomic<bool> Counting(false);
+static thread_local bool Ignored = false;
+
+inline void count()
+{
+    if(Counting.load(std::memory_order_relaxed) && !Ignored) {
+        Allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return;
+}
+
+inline bool isAvailable()
+{
+#if defined(__GLIBC__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline void ignoreThisThread()
+{
+    Ignored = true;
+    return;
+}
+
+inline void start()
+{
+    Allocations.store(0);
+    Counting.store(true);
+    return;
+}
+
+inline unsigned long long stop()
+{
+    Counting.store(false);
+    return Allocations.load();
+}
+} // AllocationCounter Namespace Ends
+
+#if defined(__GLIBC__)
+/*
+ * The exception specification has to be the one of the glibc
+ * declarations , hence __THROW.
+*/
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size) __THROW
+{
+    AllocationCounter::count();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) __THROW
+{
+    AllocationCounter::count();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) __THROW
+{
+    AllocationCounter::count();
+    return __libc_realloc(pointer, size);
+}
+
+void *memalign(size_t alignment, size_t size) __THROW
+{
+    AllocationCounter::count();
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) __THROW
+{
+    AllocationCounter::count();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size) __THROW
+{
+    AllocationCounter::count();
+    void *memory = __libc_memalign(alignment, size);
+    if(memory == NULL) {
+        return ENOMEM;
+    }
+    *pointer = memory;
+    return 0;
+}
+
+void free(void *pointer) __THROW
+{
+    __libc_free(pointer);
+    return;
+}
+}
+#endif
+#endif // ALLOCATION_COUNTER_HPP_INCLUDED
@@ -0,0 +1,71 @@
+/*
+ * Synthetic package trees and archives for the benchmarks.
+ *
+ *   makeCorpus(dir , files , fileSize , zeros) - writes files of pseudo random
+ *       text , 256 per directory , returns the bytes written or -1.
+ *   compress(archive , dir , base) - compresses dir with QArchive::Compressor , the
+ *       format follows the name of the archive. With a base the paths are stored
+ *       relative to it , else as they are.
+*/
+#if !defined(BENCHMARK_CORPUS_HPP_INCLUDED)
+#define BENCHMARK_CORPUS_HPP_INCLUDED
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include "../../QArchive/QArchive.hpp"
+
+inline qint64 makeCorpus(const QString& dir, int files, qint64 fileSize, bool zeros)
+{
+    static const char Alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789 \n";
+    QByteArray Chunk(65536, Qt::Uninitialized);
+    qint64 total = 0;
+
+    for(int file = 0; file < files ; ++file) {
+        QString SubDir = dir + "/d" + QString::number(file / 256);
+        QDir().mkpath(SubDir);
+
+        QFile Output(SubDir + "/f" + QString::number(file));
+        if(!Output.open(QIODevice::WriteOnly)) {
+            return -1;
+        }
+
+        // Cheap pseudo random text , compresses like source code does.
+        quint32 seed = file * 2654435761u + 1;
+        for(qint64 written = 0; written < fileSize; written += Chunk.size()) {
+            // A sparse file , only every 16th chunk has data.
+            if(zeros && (written / Chunk.size()) % 16) {
+                Output.write(QByteArray(qMin<qint64>(Chunk.size(), fileSize - written), '\0'));
+                continue;
+            }
+            for(int byte = 0; byte < Chunk.size() ; ++byte) {
+                seed = seed * 1103515245u + 12345u;
+                Chunk[byte] = Alphabet[(seed >> 16) % (sizeof(Alphabet) - 1)];
+            }
+            Output.write(Chunk.constData(), qMin<qint64>(Chunk.size(), fileSize - written));
+        }
+        total += fileSize;
+    }
+    return total;
+}
+
+inline bool compress(const QString& archive, const QString& dir, const QString& base = QString())
+{
+    QArchive::Compressor Compressor(archive, dir);
+    QEventLoop Loop;
+    bool ok = false;
+
+    Compressor.setBaseDirectory(base);
+    QObject::connect(&Compressor, &QArchive::Compressor::finished, &Loop, [&]() {
+        ok = true;
+        Loop.quit();
+    });
+    QObject::connect(&Compressor, &QArchive::Compressor::error, &Loop, [&](short code, const QString& what) {
+        (void)code;
+        (void)what;
+        Loop.quit();
+    });
+    Compressor.start();
+    Loop.exec();
+    return ok;
+}
+#endif // BENCHMARK_CORPUS_HPP_INCLUDED
@@ -0,0 +1,419 @@
+/*
+ * A HTTP server for a repo on the disk , so the benchmarks measure the
+ * bridge and not the internet.
+ *
+ *   LocalRepoServer Server(repoDir);
+ *   if(!Server.startServer()) { ... }
+ *   QInstallerBridge Bridge(Server.url() , ...);
+ *
+ * It serves GET and HEAD with keep alive and byte ranges (Range: bytes=a-b ,
+ * a- and -n) from its own thread , the files are streamed in chunks so big
+ * archives never sit in the memory. The thread keeps count of the requests ,
+ * the bytes sent and its own CPU time , so a benchmark can take the server
+ * out of the numbers of the process.
+ *
+ * A FaultProfile makes it a bad server , the same way on every run :
+ *   latencyMs       - every response waits this long before its status line.
+ *   bytesPerSecond  - every response is paced to this rate , 0 for no cap.
+ *   dropAfterBytes  - a body is cut after this many bytes , the connection is
+ *                     closed then. A ranged request makes the next bytes.
+ *   noAcceptRanges  - no Accept-Ranges header and the Range header is ignored.
+ *   errorBurst      - the first N requests of every path get a 503.
+ *   stallAfterBytes ,
+ *   stallMs         - the body stops for stallMs after every stallAfterBytes ,
+ *                     like a slowloris server.
+ * setFaultProfile() also forgets the requests counted for errorBurst.
+*/
+#if !defined(LOCAL_REPO_SERVER_HPP_INCLUDED)
+#define LOCAL_REPO_SERVER_HPP_INCLUDED
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QHostAddress>
+#include <QMutex>
+#include <QSemaphore>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <memory>
+#if defined(Q_OS_UNIX)
+#include <time.h>
+#endif
+
+struct FaultProfile {
+    int latencyMs = 0;
+    qint64 bytesPerSecond = 0;
+    qint64 dropAfterBytes = 0;
+    bool noAcceptRanges = false;
+    int errorBurst = 0;
+    qint64 stallAfterBytes = 0;
+    int stallMs = 0;
+};
+
+class LocalRepoServer : public QThread
+{
+public:
+    explicit LocalRepoServer(const QString& root)
+        : rootDir(QDir(root).absolutePath())
+    {
+        return;
+    }
+
+    ~LocalRepoServer()
+    {
+        quit();
+        wait();
+        return;
+    }
+
+    // Blocks until the server listens on a free port of the loopback.
+    bool startServer()
+    {
+        start();
+        ready.acquire();
+        return (listenPort != 0);
+    }
+
+    QString url() const
+    {
+        return "http://127.0.0.1:" + QString::number(listenPort);
+    }
+
+    qint64 bytesServed() const
+    {
+        return bytesSent.load();
+    }
+
+    int requestsServed() const
+    {
+        return requests.load();
+    }
+
+    // CPU time of the server thread , only on Unix.
+    qint64 cpuNsecs() const
+    {
+        return cpuTime.load();
+    }
+
+    // Takes effect with the next request.
+    void setFaultProfile(const FaultProfile& profile)
+    {
+        QMutexLocker Locker(&faultMutex);
+        faults = profile;
+        pathRequests.clear();
+        return;
+    }
+
+    // Cut bodies , stalls and 503s sent so far.
+    int faultsInjected() const
+    {
+        return injected.load();
+    }
+
+protected:
+    void run() override
+    {
+        HttpServer Server(this);
+        if(!Server.listen(QHostAddress::LocalHost, 0)) {
+            ready.release();
+            return;
+        }
+        listenPort = Server.serverPort();
+        ready.release();
+        exec();
+        return;
+    }
+
+private:
+    struct Connection {
+        QByteArray request;
+        QFile file;
+        qint64 remaining = 0,
+               sent = 0, // Of the body being sent.
+               nextStall = 0;
+        QElapsedTimer started;
+        FaultProfile faults;
+        bool keepAlive = true,
+             busy = false, // A response is on its way.
+             waiting = false; // The body waits for a timer.
+    };
+
+    class HttpServer : public QTcpServer
+    {
+    public:
+        explicit HttpServer(LocalRepoServer *owner)
+            : server(owner)
+        {
+            return;
+        }
+
+    protected:
+        void incomingConnection(qintptr descriptor) override
+        {
+            QTcpSocket *Socket = new QTcpSocket(this);
+            if(!Socket->setSocketDescriptor(descriptor)) {
+                delete Socket;
+                return;
+            }
+            auto State = std::make_shared<Connection>();
+            LocalRepoServer *Owner = server;
+            connect(Socket, &QTcpSocket::readyRead, Socket, [Owner, Socket, State]() {
+                State->request += Socket->readAll();
+                Owner->serveRequests(Socket, State.get());
+            });
+            connect(Socket, &QTcpSocket::bytesWritten, Socket, [Owner, Socket, State]() {
+                Owner->sendBody(Socket, State.get());
+            });
+            connect(Socket, &QTcpSocket::disconnected, Socket, &QObject::deleteLater);
+            return;
+        }
+
+    private:
+        LocalRepoServer *server;
+    };
+
+    static const qint64 ChunkSize = 262144; // 256 KiB
+    static const qint64 SendBuffer = 1048576; // 1 MiB queued in the socket at most.
+
+    /*
+     * Requests are answered one after another , a pipelined request
+     * waits in the buffer until the body before it is sent.
+    */
+    void serveRequests(QTcpSocket *socket, Connection *state)
+    {
+        int end;
+        while(!state->busy && socket->state() == QAbstractSocket::ConnectedState &&
+              (end = state->request.indexOf("\r\n\r\n")) >= 0) {
+            const QByteArray Header = state->request.left(end);
+            state->request.remove(0, end + 4);
+            state->busy = true;
+            faultMutex.lock();
+            state->faults = faults;
+            faultMutex.unlock();
+            if(state->faults.latencyMs > 0) {
+                QTimer::singleShot(state->faults.latencyMs, socket, [this, socket, state, Header]() {
+                    answer(socket, state, Header);
+                });
+                break;
+            }
+            answer(socket, state, Header);
+        }
+        touchCpuTime();
+        return;
+    }
+
+    void answer(QTcpSocket *socket, Connection *state, const QByteArray& header)
+    {
+        const QList<QByteArray> Lines = header.split('\n');
+        const QList<QByteArray> RequestLine = Lines.value(0).trimmed().split(' ');
+        const QByteArray Method = RequestLine.value(0),
+                         Version = RequestLine.value(2);
+        QByteArray Range;
+        state->keepAlive = (Version == "HTTP/1.1");
+        for(int line = 1; line < Lines.size() ; ++line) {
+            const int Colon = Lines.at(line).indexOf(':');
+            const QByteArray Name = Lines.at(line).left(Colon).trimmed().toLower(),
+                             Value = Lines.at(line).mid(Colon + 1).trimmed();
+            if(Name == "range") {
+                Range = Value;
+            } else if(Name == "connection") {
+                state->keepAlive = (Value.toLower() == "keep-alive") ||
+                                   (state->keepAlive && Value.toLower() != "close");
+            }
+        }
+        requests.fetchAndAddRelaxed(1);
+
+        if(Method != "GET" && Method != "HEAD") {
+            sendStatus(socket, state, "405 Method Not Allowed");
+            return;
+        }
+        QString Path = QUrl::fromPercentEncoding(RequestLine.value(1).split('?').value(0));
+        Path = QDir::cleanPath(rootDir + "/" + Path);
+        if(!Path.startsWith(rootDir + "/") && Path != rootDir) {
+            sendStatus(socket, state, "403 Forbidden");
+            return;
+        }
+        if(state->faults.errorBurst > 0) {
+            faultMutex.lock();
+            const int Seen = pathRequests[Path]++;
+            faultMutex.unlock();
+            if(Seen < state->faults.errorBurst) {
+                injected.fetchAndAddRelaxed(1);
+                sendStatus(socket, state, "503 Service Unavailable");
+                return;
+            }
+        }
+        if(state->faults.noAcceptRanges) {
+            Range.clear();
+        }
+        state->file.setFileName(Path);
+        if(!QFileInfo(Path).isFile() || !state->file.open(QIODevice::ReadOnly)) {
+            sendStatus(socket, state, "404 Not Found");
+            return;
+        }
+
+        const qint64 Size = state->file.size();
+        qint64 first = 0,
+               last = Size - 1;
+        QByteArray Status = "200 OK";
+        if(Range.startsWith("bytes=")) {
+            const QList<QByteArray> Bounds = Range.mid(6).split(',').value(0).split('-');
+            if(Bounds.value(0).isEmpty()) { // The last n bytes.
+                first = qMax<qint64>(0, Size - Bounds.value(1).toLongLong());
+            } else {
+                first = Bounds.value(0).toLongLong();
+                if(!Bounds.value(1).isEmpty()) {
+                    last = qMin(last, Bounds.value(1).toLongLong());
+                }
+            }
+            if(first >= Size || first > last) {
+                state->file.close();
+                sendStatus(socket, state, "416 Range Not Satisfiable",
+                           "Content-Range: bytes */" + QByteArray::number(Size) + "\r\n");
+                return;
+            }
+            Status = "206 Partial Content";
+        }
+
+        QByteArray Response = "HTTP/1.1 " + Status + "\r\n"
+                              "Content-Type: application/octet-stream\r\n"
+                              "Content-Length: " + QByteArray::number(last - first + 1) + "\r\n";
+        if(!state->faults.noAcceptRanges) {
+            Response += "Accept-Ranges: bytes\r\n";
+        }
+        if(Status.startsWith("206")) {
+            Response += "Content-Range: bytes " + QByteArray::number(first) + "-" + QByteArray::number(last) +
+                        "/" + QByteArray::number(Size) + "\r\n";
+        }
+        Response += state->keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        socket->write(Response);
+
+        if(Method == "HEAD" || last < first) {
+            state->file.close();
+            finishResponse(socket, state);
+            return;
+        }
+        state->file.seek(first);
+        state->remaining = last - first + 1;
+        state->sent = 0;
+        state->nextStall = state->faults.stallAfterBytes;
+        state->started.start();
+        sendBody(socket, state);
+        return;
+    }
+
+    void sendStatus(QTcpSocket *socket, Connection *state, const QByteArray& status,
+                    const QByteArray& headers = QByteArray())
+    {
+        socket->write("HTTP/1.1 " + status + "\r\nContent-Length: 0\r\n" + headers +
+                      (state->keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n"));
+        finishResponse(socket, state);
+        return;
+    }
+
+    void sendBody(QTcpSocket *socket, Connection *state)
+    {
+        const FaultProfile &Faults = state->faults;
+        while(state->file.isOpen() && !state->waiting && state->remaining > 0 &&
+              socket->bytesToWrite() < SendBuffer) {
+            qint64 budget = qMin(ChunkSize, state->remaining);
+            if(Faults.dropAfterBytes > 0) {
+                if(state->sent >= Faults.dropAfterBytes) {
+                    // Only once all of it left , so the client got what we count.
+                    if(socket->bytesToWrite() == 0) {
+                        injected.fetchAndAddRelaxed(1);
+                        state->file.close();
+                        socket->disconnectFromHost();
+                    }
+                    break;
+                }
+                budget = qMin(budget, Faults.dropAfterBytes - state->sent);
+            }
+            if(Faults.stallAfterBytes > 0 && Faults.stallMs > 0) {
+                if(state->sent >= state->nextStall) {
+                    injected.fetchAndAddRelaxed(1);
+                    state->nextStall += Faults.stallAfterBytes;
+                    waitFor(socket, state, Faults.stallMs);
+                    break;
+                }
+                budget = qMin(budget, state->nextStall - state->sent);
+            }
+            if(Faults.bytesPerSecond > 0) {
+                // A 10 ms head start , else the first chunk would always wait.
+                const qint64 Allowed = Faults.bytesPerSecond * (state->started.elapsed() + 10) / 1000 - state->sent;
+                if(Allowed <= 0) {
+                    waitFor(socket, state, 10);
+                    break;
+                }
+                budget = qMin(budget, Allowed);
+            }
+
+            const QByteArray Chunk = state->file.read(budget);
+            if(Chunk.isEmpty()) {
+                // The file shrank , the client sees a short body.
+                state->file.close();
+                socket->disconnectFromHost();
+                break;
+            }
+            socket->write(Chunk);
+            state->remaining -= Chunk.size();
+            state->sent += Chunk.size();
+            bytesSent.fetchAndAddRelaxed(Chunk.size());
+        }
+        if(state->file.isOpen() && state->remaining == 0) {
+            state->file.close();
+            finishResponse(socket, state);
+        }
+        touchCpuTime();
+        return;
+    }
+
+    void waitFor(QTcpSocket *socket, Connection *state, int msecs)
+    {
+        state->waiting = true;
+        QTimer::singleShot(msecs, socket, [this, socket, state]() {
+            state->waiting = false;
+            sendBody(socket, state);
+        });
+        return;
+    }
+
+    void finishResponse(QTcpSocket *socket, Connection *state)
+    {
+        state->busy = false;
+        if(!state->keepAlive) {
+            socket->disconnectFromHost();
+            return;
+        }
+        if(!state->request.isEmpty()) {
+            serveRequests(socket, state);
+        }
+        return;
+    }
+
+    void touchCpuTime()
+    {
+#if defined(Q_OS_UNIX)
+        struct timespec Now;
+        if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &Now) == 0) {
+            cpuTime.store(qint64(Now.tv_sec) * 1000000000 + Now.tv_nsec);
+        }
+#endif
+        return;
+    }
+
+    const QString rootDir;
+    QSemaphore ready;
+    quint16 listenPort = 0;
+    QAtomicInteger<qint64> bytesSent,
+                           cpuTime;
+    QAtomicInt requests,
+               injected;
+    QMutex faultMutex;
+    FaultProfile faults;
+    QHash<QString, int> pathRequests;
+};
+#endif // LOCAL_REPO_SERVER_HPP_INCLUDED
@@ -0,0 +1,157 @@
+/*
+ * A synthetic repo of the Qt Installer Framework and the components.xml
+ * of a install which is one version behind it.
+ *
+ *   RepoShape Shape;
+ *   Shape.packages = 20;
+ *   makeSyntheticRepo(repoDir , workDir , componentsXml , Shape , &payloadBytes);
+ *
+ * Every package com.benchmark.p<N> has a {Version}meta.7z , a content archive
+ * of Shape.files files with Shape.fileSize bytes each and its .sha1. The files
+ * are stored under p<N>/ , so the packages never write the same path. The repo
+ * has version 1.0.1 of every package , the components.xml 1.0.0 , so all of
+ * them are updates. A package depends on the one before it when
+ * Shape.dependencies is set.
+*/
+#if !defined(BENCHMARK_SYNTHETIC_REPO_HPP_INCLUDED)
+#define BENCHMARK_SYNTHETIC_REPO_HPP_INCLUDED
+#include <QCryptographicHash>
+#include <QXmlStreamWriter>
+#include "Corpus.hpp"
+
+struct RepoShape {
+    int packages = 20;
+    int files = 200;
+    qint64 fileSize = 16384;
+    QString suffix = ".tar.gz";
+    bool dependencies = false;
+};
+
+inline QString syntheticPackageName(int package)
+{
+    return "com.benchmark.p" + QString::number(package);
+}
+
+inline QByteArray syntheticFileSha1(const QString& fileName)
+{
+    QFile File(fileName);
+    QCryptographicHash Hash(QCryptographicHash::Sha1);
+    if(!File.open(QIODevice::ReadOnly) || !Hash.addData(&File)) {
+        return QByteArray();
+    }
+    return Hash.result().toHex();
+}
+
+/*
+ * The Updates.xml alone , for the benchmarks which only parse it.
+ * metaSha1 is the SHA1 every package claims for its meta.7z.
+*/
+inline bool writeSyntheticUpdatesXml(const QString& fileName, const RepoShape& shape, const QByteArray& metaSha1)
+{
+    QFile File(fileName);
+    if(!File.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    QXmlStreamWriter Writer(&File);
+    Writer.setAutoFormatting(true);
+    Writer.writeStartDocument();
+    Writer.writeStartElement("Updates");
+    Writer.writeTextElement("ApplicationName", "{AnyApplication}");
+    Writer.writeTextElement("ApplicationVersion", "1.0.0");
+    Writer.writeTextElement("Checksum", "true");
+    for(int package = 0; package < shape.packages ; ++package) {
+        Writer.writeStartElement("PackageUpdate");
+        Writer.writeTextElement("Name", syntheticPackageName(package));
+        Writer.writeTextElement("DisplayName", "Benchmark package " + QString::number(package));
+        Writer.writeTextElement("Description", "A synthetic package of the benchmarks.");
+        Writer.writeTextElement("Version", "1.0.1");
+        Writer.writeTextElement("ReleaseDate", "2018-01-01");
+        if(shape.dependencies && package > 0) {
+            Writer.writeTextElement("Dependencies", syntheticPackageName(package - 1));
+        }
+        Writer.writeTextElement("DownloadableArchives", "content" + shape.suffix);
+        Writer.writeTextElement("SHA1", QString::fromLatin1(metaSha1));
+        Writer.writeEndElement();
+    }
+    Writer.writeEndElement();
+    Writer.writeEndDocument();
+    return !Writer.hasError();
+}
+
+inline bool writeSyntheticComponentsXml(const QString& fileName, const RepoShape& shape)
+{
+    QFile File(fileName);
+    if(!File.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    QXmlStreamWriter Writer(&File);
+    Writer.setAutoFormatting(true);
+    Writer.writeStartElement("Packages");
+    Writer.writeTextElement("ApplicationName", "Benchmark");
+    Writer.writeTextElement("ApplicationVersion", "1.0.0");
+    for(int package = 0; package < shape.packages ; ++package) {
+        Writer.writeStartElement("Package");
+        Writer.writeTextElement("Name", syntheticPackageName(package));
+        Writer.writeTextElement("Title", "Benchmark package " + QString::number(package));
+        Writer.writeTextElement("Description", "A synthetic package of the benchmarks.");
+        Writer.writeTextElement("Version", "1.0.0");
+        Writer.writeTextElement("InstallDate", "2018-01-01");
+        Writer.writeEndElement();
+    }
+    Writer.writeEndElement();
+    return !Writer.hasError();
+}
+
+/*
+ * Every meta.7z is the same , so it is compressed once. payloadBytes gets
+ * the bytes of all files , archiveBytes (if given) the size of all content
+ * archives.
+*/
+inline bool makeSyntheticRepo(const QString& repo, const QString& work, const QString& components,
+                              const RepoShape& shape, qint64 *payloadBytes, qint64 *archiveBytes = NULL)
+{
+    const QString MetaDir = work + "/meta",
+                  Meta = work + "/meta.7z";
+    QDir().mkpath(MetaDir);
+    QFile PackageXml(MetaDir + "/package.xml");
+    if(!PackageXml.open(QIODevice::WriteOnly) ||
+       PackageXml.write("<Package><Version>1.0.1</Version></Package>\n") < 0) {
+        return false;
+    }
+    PackageXml.close();
+    if(!compress(Meta, MetaDir, MetaDir)) {
+        return false;
+    }
+    const QByteArray MetaSha1 = syntheticFileSha1(Meta);
+
+    *payloadBytes = 0;
+    if(archiveBytes != NULL) {
+        *archiveBytes = 0;
+    }
+    for(int package = 0; package < shape.packages ; ++package) {
+        const QString Name = syntheticPackageName(package),
+                      PackageDir = repo + "/" + Name,
+                      Tree = work + "/trees/p" + QString::number(package),
+                      Archive = PackageDir + "/1.0.1content" + shape.suffix;
+        QDir().mkpath(PackageDir);
+
+        const qint64 Written = makeCorpus(Tree, shape.files, shape.fileSize, false);
+        if(Written < 0 || !compress(Archive, Tree, work + "/trees") ||
+           !QFile::copy(Meta, PackageDir + "/1.0.1meta.7z")) {
+            return false;
+        }
+        QFile Checksum(Archive + ".sha1");
+        if(!Checksum.open(QIODevice::WriteOnly) || Checksum.write(syntheticFileSha1(Archive)) < 0) {
+            return false;
+        }
+        QDir(Tree).removeRecursively();
+
+        *payloadBytes += Written;
+        if(archiveBytes != NULL) {
+            *archiveBytes += QFileInfo(Archive).size();
+        }
+    }
+    return writeSyntheticUpdatesXml(repo + "/Updates.xml", shape, MetaSha1) &&
+           writeSyntheticComponentsXml(components, shape);
+}
+#endif // BENCHMARK_SYNTHETIC_REPO_HPP_INCLUDED
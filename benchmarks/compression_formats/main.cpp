@@ -0,0 +1,154 @@
+/*
+ * Measures the throughput and the ratio of QArchive::Compressor for every
+ * archive format , with one thread and with more.
+ *
+ * Usage: compression_formats [--files N] [--file-size BYTES] [--threads N]
+ *                            [--level N] [--repeat N] [--tree DIR]
+ *                            [--external-filters]
+ *
+ * Without --tree a synthetic tree is generated , pseudo random text which
+ * compresses like source code does. Give a real build tree with --tree to
+ * see the ratio of real payloads. Every format is run with a single thread
+ * and with --threads (default QThread::idealThreadCount()) , the fastest of
+ * --repeat runs is reported as a JSON line. With --external-filters the
+ * threaded gzip and bzip2 runs go through pigz or pbzip2 , "external_filter"
+ * tells if they did. Without them the threaded runs are the same as the
+ * single ones.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "../common/Corpus.hpp"
+
+struct Format {
+    QString name;
+    QString suffix;
+    const char *externalFilter;
+};
+
+static qint64 compressOnce(const QString& archive, const QString& tree, int threads, int level,
+                           bool externalFilters, QString *failure)
+{
+    QFile::remove(archive);
+    QArchive::Compressor Compressor(archive, tree);
+    QEventLoop Loop;
+
+    Compressor.setThreads(threads);
+    Compressor.setCompressionLevel(level);
+    Compressor.setExternalFilters(externalFilters);
+    QObject::connect(&Compressor, &QArchive::Compressor::finished, &Loop, &QEventLoop::quit);
+    QObject::connect(&Compressor, &QArchive::Compressor::error, &Loop, [&](short code, const QString& what) {
+        *failure = QString::number(code) + " :: " + what;
+        Loop.quit();
+    });
+
+    QElapsedTimer Timer;
+    Timer.start();
+    Compressor.start();
+    Loop.exec();
+    return Timer.nsecsElapsed();
+}
+
+static qint64 treeBytes(const QString& tree)
+{
+    qint64 total = 0;
+    QDirIterator Files(tree, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while(Files.hasNext()) {
+        Files.next();
+        total += Files.fileInfo().size();
+    }
+    return total;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser Parser;
+    Parser.addHelpOption();
+    QCommandLineOption FilesOption("files", "Number of files in the synthetic tree.", "N", "2000");
+    QCommandLineOption SizeOption("file-size", "Size of every synthetic file in bytes.", "BYTES", "65536");
+    QCommandLineOption ThreadsOption("threads", "Threads of the threaded runs.", "N",
+                                     QString::number(QThread::idealThreadCount()));
+    QCommandLineOption LevelOption("level", "Compression level , -1 for the default of every format.", "N", "-1");
+    QCommandLineOption RepeatOption("repeat", "Runs per setup , the fastest is reported.", "N", "3");
+    QCommandLineOption TreeOption("tree", "Compress this directory instead of a synthetic tree.", "DIR");
+    QCommandLineOption ExternalOption("external-filters", "Pipe threaded gzip and bzip2 through pigz and pbzip2.");
+    Parser.addOption(FilesOption);
+    Parser.addOption(SizeOption);
+    Parser.addOption(ThreadsOption);
+    Parser.addOption(LevelOption);
+    Parser.addOption(RepeatOption);
+    Parser.addOption(TreeOption);
+    Parser.addOption(ExternalOption);
+    Parser.process(app);
+
+    QVector<Format> Formats;
+    Formats.push_back({ "gzip", ".tar.gz", "pigz" });
+    Formats.push_back({ "bzip2", ".tar.bz2", "pbzip2" });
+    Formats.push_back({ "xz", ".tar.xz", NULL });
+    Formats.push_back({ "zip", ".zip", NULL });
+    Formats.push_back({ "7z", ".7z", NULL });
+
+    QTemporaryDir Work;
+    QString Tree = Parser.value(TreeOption);
+    if(Tree.isEmpty()) {
+        Tree = Work.path() + "/corpus";
+        if(makeCorpus(Tree, Parser.value(FilesOption).toInt(), Parser.value(SizeOption).toLongLong(), false) < 0) {
+            out << "Cannot create the synthetic tree!\n";
+            return 1;
+        }
+    }
+
+    const qint64 RawBytes = treeBytes(Tree);
+    const int Threads = qMax(1, Parser.value(ThreadsOption).toInt()),
+              Level = Parser.value(LevelOption).toInt(),
+              Repeat = qMax(1, Parser.value(RepeatOption).toInt());
+    const bool External = Parser.isSet(ExternalOption);
+    QVector<int> ThreadCounts;
+    ThreadCounts << 1;
+    if(Threads > 1) {
+        ThreadCounts << Threads;
+    }
+    bool Failed = false;
+
+    for(int format = 0; format < Formats.size() ; ++format) {
+        const QString Archive = Work.path() + "/archive" + Formats.at(format).suffix;
+        for(int threads = 0; threads < ThreadCounts.size() ; ++threads) {
+            qint64 Best = -1;
+            QString Failure;
+            for(int run = 0; run < Repeat && Failure.isEmpty() ; ++run) {
+                qint64 Elapsed = compressOnce(Archive, Tree, ThreadCounts.at(threads), Level, External, &Failure);
+                if(Best < 0 || Elapsed < Best) {
+                    Best = Elapsed;
+                }
+            }
+
+            const double Seconds = Best / 1e9;
+            const qint64 ArchiveBytes = QFileInfo(Archive).size();
+            QJsonObject Result;
+            Result["format"] = Formats.at(format).name;
+            Result["threads"] = ThreadCounts.at(threads);
+            Result["level"] = Level;
+            Result["external_filter"] = (External && ThreadCounts.at(threads) > 1 && Formats.at(format).externalFilter != NULL &&
+                                         !QStandardPaths::findExecutable(Formats.at(format).externalFilter).isEmpty());
+            Result["seconds"] = Seconds;
+            Result["raw_mib_per_s"] = RawBytes / 1048576.0 / Seconds;
+            Result["archive_bytes"] = ArchiveBytes;
+            Result["ratio"] = (ArchiveBytes > 0) ? double(RawBytes) / ArchiveBytes : 0;
+            if(!Failure.isEmpty()) {
+                Result["error"] = Failure;
+                Failed = true;
+            }
+            out << QJsonDocument(Result).toJson(QJsonDocument::Compact) << "\n";
+            out.flush();
+        }
+    }
+    return Failed ? 1 : 0;
+}
@@ -0,0 +1,7 @@
+TEMPLATE=app
+TARGET=decompression_formats
+LIBS += -larchive
+QT+=core concurrent
+SOURCES += main.cpp
+HEADERS += ../../QArchive/QArchive.hpp \
+           ../common/Corpus.hpp
@@ -0,0 +1,163 @@
+/*
+ * Measures how fast QArchive::Extractor installs the same tree from every
+ * archive format , zstd and lz4 against the gzip , bzip2 , xz and 7z
+ * payloads the repos ship today.
+ *
+ * Usage: decompression_formats [--files N] [--file-size BYTES] [--repeat N]
+ *                              [--tree DIR]
+ *
+ * Without --tree two synthetic package trees are used :
+ *   small-files - 20000 files of 4 KiB , like a tree of scripts and assets.
+ *   large-files - 64 files of 4 MiB , like a tree of libraries.
+ * Giving --files or --file-size runs a single custom tree instead , --tree
+ * uses a real package tree. Every archive is made once with the default
+ * level and then extracted --repeat times with the fast writer , the
+ * fastest run is reported as a JSON line. A format the libarchive at hand
+ * cannot write is reported with "skipped".
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "../common/Corpus.hpp"
+
+struct Format {
+    QString name;
+    QString suffix;
+};
+
+struct Tree {
+    QString name;
+    int files;
+    qint64 fileSize;
+};
+
+static qint64 extractOnce(const QString& archive, QString *failure)
+{
+    QTemporaryDir Destination;
+    QArchive::Extractor Extractor;
+    QEventLoop Loop;
+
+    Extractor.addArchive(archive);
+    Extractor.setDestination(Destination.path());
+    Extractor.setWriteFlags(QArchive::FAST_WRITE & ~QArchive::SYNC_WRITE);
+
+    QObject::connect(&Extractor, &QArchive::Extractor::finished, &Loop, &QEventLoop::quit);
+    QObject::connect(&Extractor, &QArchive::Extractor::error, &Loop, [&](short code, const QString& what) {
+        *failure = QString::number(code) + " :: " + what;
+        Loop.quit();
+    });
+
+    QElapsedTimer Timer;
+    Timer.start();
+    Extractor.start();
+    Loop.exec();
+    return Timer.nsecsElapsed();
+}
+
+static qint64 treeBytes(const QString& tree)
+{
+    qint64 total = 0;
+    QDirIterator Files(tree, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while(Files.hasNext()) {
+        Files.next();
+        total += Files.fileInfo().size();
+    }
+    return total;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser Parser;
+    Parser.addHelpOption();
+    QCommandLineOption FilesOption("files", "Number of files in the synthetic tree.", "N", "2000");
+    QCommandLineOption SizeOption("file-size", "Size of every synthetic file in bytes.", "BYTES", "65536");
+    QCommandLineOption RepeatOption("repeat", "Runs per format , the fastest is reported.", "N", "3");
+    QCommandLineOption TreeOption("tree", "Use this package tree instead of a synthetic one.", "DIR");
+    Parser.addOption(FilesOption);
+    Parser.addOption(SizeOption);
+    Parser.addOption(RepeatOption);
+    Parser.addOption(TreeOption);
+    Parser.process(app);
+
+    QVector<Format> Formats;
+    Formats.push_back({ "gzip", ".tar.gz" });
+    Formats.push_back({ "bzip2", ".tar.bz2" });
+    Formats.push_back({ "xz", ".tar.xz" });
+    Formats.push_back({ "7z", ".7z" });
+    Formats.push_back({ "zstd", ".tar.zst" });
+    Formats.push_back({ "lz4", ".tar.lz4" });
+
+    QVector<Tree> Trees;
+    if(Parser.isSet(FilesOption) || Parser.isSet(SizeOption)) {
+        Trees.push_back({ "custom", Parser.value(FilesOption).toInt(), Parser.value(SizeOption).toLongLong() });
+    } else {
+        Trees.push_back({ "small-files", 20000, 4096 });
+        Trees.push_back({ "large-files", 64, 4194304 });
+    }
+    if(Parser.isSet(TreeOption)) {
+        Trees.clear();
+        Trees.push_back({ "given", -1, -1 });
+    }
+
+    const int Repeat = qMax(1, Parser.value(RepeatOption).toInt());
+    bool Failed = false;
+
+    for(int tree = 0; tree < Trees.size() ; ++tree) {
+        QTemporaryDir Work;
+        QString Dir = Parser.value(TreeOption);
+        if(Dir.isEmpty()) {
+            Dir = Work.path() + "/corpus";
+            if(makeCorpus(Dir, Trees.at(tree).files, Trees.at(tree).fileSize, false) < 0) {
+                out << "Cannot create the synthetic tree!\n";
+                return 1;
+            }
+        }
+        const qint64 RawBytes = treeBytes(Dir);
+
+        for(int format = 0; format < Formats.size() ; ++format) {
+            const QString Archive = Work.path() + "/archive" + Formats.at(format).suffix;
+            QJsonObject Result;
+            Result["tree"] = Trees.at(tree).name;
+            Result["format"] = Formats.at(format).name;
+
+            if(!compress(Archive, Dir)) {
+                Result["skipped"] = QString("cannot write the format");
+                out << QJsonDocument(Result).toJson(QJsonDocument::Compact) << "\n";
+                out.flush();
+                continue;
+            }
+
+            qint64 Best = -1;
+            QString Failure;
+            for(int run = 0; run < Repeat && Failure.isEmpty() ; ++run) {
+                qint64 Elapsed = extractOnce(Archive, &Failure);
+                if(Best < 0 || Elapsed < Best) {
+                    Best = Elapsed;
+                }
+            }
+
+            const double Seconds = Best / 1e9;
+            const qint64 ArchiveBytes = QFileInfo(Archive).size();
+            Result["seconds"] = Seconds;
+            Result["raw_mib_per_s"] = RawBytes / 1048576.0 / Seconds;
+            Result["archive_mib_per_s"] = ArchiveBytes / 1048576.0 / Seconds;
+            Result["ratio"] = (ArchiveBytes > 0) ? double(RawBytes) / ArchiveBytes : 0;
+            if(!Failure.isEmpty()) {
+                Result["error"] = Failure;
+                Failed = true;
+            }
+            out << QJsonDocument(Result).toJson(QJsonDocument::Compact) << "\n";
+            out.flush();
+            QFile::remove(Archive);
+        }
+    }
+    return Failed ? 1 : 0;
+}
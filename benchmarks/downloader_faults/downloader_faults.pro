@@ -0,0 +1,8 @@
+TEMPLATE=app
+TARGET=downloader_faults
+LIBS += -larchive
+QT+=core network
+SOURCES += main.cpp
+HEADERS += ../../QEasyDownloader/QEasyDownloader.hpp \
+	   ../common/Corpus.hpp \
+	   ../common/LocalRepoServer.hpp
@@ -0,0 +1,377 @@
+/*
+ * Downloads a set of files with QEasyDownloader from a local server which
+ * injects faults , once for every fault profile , and reports how long it
+ * took and how many bytes had to be sent again.
+ *
+ * Usage: downloader_faults [--files N] [--file-size BYTES] [--timeout MS]
+ *                          [--backoff MS] [--max-retries N] [--max-rounds N]
+ *                          [--stall-timeout MS] [--deadline MS]
+ *                          [--profiles NAME,NAME,...]
+ *
+ * The profiles
+ *   none             - a good server , the baseline.
+ *   latency          - 200 ms before every response.
+ *   bandwidth        - 8 MiB/s for every response.
+ *   drops            - every body is cut after 256 KiB.
+ *   no-ranges        - no Accept-Ranges , nothing else.
+ *   no-ranges-drops  - both , a resume has to start over.
+ *   5xx-burst        - the first two requests of every file get a 503.
+ *   slowloris        - the body stops for --timeout + 1 s after every 256 KiB.
+ *
+ * The downloader leaves the recovery to its user , it only emits Error and
+ * Timeout. This does what a user of it does : a Error or Timeout in the body
+ * of a file pauses it and resumes it after --backoff , at most --max-retries
+ * times per file. A Error in the probe of a file cannot be resumed , that is
+ * only counted. Once a round ends , because the queue is done , a file ran
+ * out of retries or nothing moved for --stall-timeout , the files which are
+ * not complete are queued again with a new downloader , at most --max-rounds
+ * times.
+ *
+ * A JSON line per profile with the seconds , the rounds , retries , errors and
+ * timeouts , the files complete , corrupt (wrong content) and missing , the
+ * bytes served , the payload and what was served more than the payload as
+ * redownloaded_bytes. The aborted probe of every file is in there too , so the
+ * none profile is what a fault adds to.
+ * The exit code is 1 if the none profile does not download everything.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "../../QEasyDownloader/QEasyDownloader.hpp"
+#include "../common/Corpus.hpp"
+#include "../common/LocalRepoServer.hpp"
+
+struct Profile {
+    QString name;
+    FaultProfile faults;
+};
+
+struct Options {
+    int timeout = 2000;
+    int backoff = 200;
+    int maxRetries = 50;
+    int maxRounds = 5;
+    int stallTimeout = 15000;
+    int deadline = 120000;
+};
+
+struct Outcome {
+    int rounds = 0;
+    int retries = 0;
+    int errors = 0;
+    int timeouts = 0;
+    int probeFailures = 0;
+    int stalledRounds = 0;
+    bool deadline = false;
+};
+
+static QByteArray fileSha1(const QString& path)
+{
+    QFile File(path);
+    QCryptographicHash Hash(QCryptographicHash::Sha1);
+    if(!File.open(QIODevice::ReadOnly) || !Hash.addData(&File)) {
+        return QByteArray();
+    }
+    return Hash.result();
+}
+
+static Outcome downloadAll(const QString& url, const QStringList& files, const QHash<QString, qint64>& sizes,
+                           const QString& destination, const Options& options)
+{
+    Outcome Result;
+    QElapsedTimer Clock;
+    Clock.start();
+
+    auto complete = [&](const QString& fileName) {
+        return QFileInfo(fileName).size() == sizes.value(fileName, -1);
+    };
+
+    QStringList Pending;
+    for(auto file : files) {
+        Pending << destination + "/" + file;
+        QDir().mkpath(QFileInfo(Pending.last()).absolutePath());
+    }
+
+    while(!Pending.isEmpty() && Result.rounds < options.maxRounds) {
+        if(Clock.elapsed() > options.deadline) {
+            Result.deadline = true;
+            break;
+        }
+        ++Result.rounds;
+
+        QEventLoop Loop;
+        QEasyDownloader *Downloader = new QEasyDownloader;
+        QHash<QString, int> FileRetries;
+        QString Current; // The file in its body , empty while a file is probed.
+        bool Recovering = false;
+        QElapsedTimer Idle;
+        QTimer Watchdog;
+
+        Downloader->setTimeoutTime(options.timeout);
+        Downloader->ResumeDownloads(true);
+
+        auto recover = [&](const QString& fileName) {
+            if(Recovering) {
+                return;
+            }
+            if(fileName != Current) {
+                // Pause() in the probe would leave the downloader without a file.
+                ++Result.probeFailures;
+                return;
+            }
+            // A complete file still stuck means its finish was lost , start over.
+            if(complete(fileName) || ++FileRetries[fileName] > options.maxRetries) {
+                Loop.quit();
+                return;
+            }
+            ++Result.retries;
+            Recovering = true;
+            Downloader->Pause();
+            QTimer::singleShot(options.backoff, &Loop, [&]() {
+                Recovering = false;
+                Idle.restart();
+                Downloader->Resume();
+            });
+        };
+
+        QObject::connect(Downloader, &QEasyDownloader::DownloadProgress, &Loop,
+        [&](qint64 received, qint64 total, int percent, double speed, const QString& unit,
+            const QUrl& from, const QString& fileName) {
+            (void)received;
+            (void)total;
+            (void)percent;
+            (void)speed;
+            (void)unit;
+            (void)from;
+            Current = fileName;
+            Idle.restart();
+        });
+        QObject::connect(Downloader, &QEasyDownloader::DownloadFinished, &Loop,
+        [&](const QUrl& from, const QString& fileName) {
+            (void)from;
+            (void)fileName;
+            Current.clear();
+            Idle.restart();
+        });
+        QObject::connect(Downloader, &QEasyDownloader::Error, &Loop,
+        [&](QNetworkReply::NetworkError code, const QUrl& from, const QString& fileName) {
+            (void)code;
+            (void)from;
+            ++Result.errors;
+            recover(fileName);
+        });
+        QObject::connect(Downloader, &QEasyDownloader::Timeout, &Loop, [&](const QUrl& from, const QString& fileName) {
+            (void)from;
+            ++Result.timeouts;
+            recover(fileName);
+        });
+        QObject::connect(Downloader, &QEasyDownloader::Finished, &Loop, &QEventLoop::quit);
+        QObject::connect(&Watchdog, &QTimer::timeout, &Loop, [&]() {
+            if(Recovering) {
+                return;
+            }
+            if(Idle.elapsed() > options.stallTimeout) {
+                ++Result.stalledRounds;
+                Loop.quit();
+            } else if(Clock.elapsed() > options.deadline) {
+                Result.deadline = true;
+                Loop.quit();
+            }
+        });
+
+        Idle.start();
+        Watchdog.start(100);
+        for(auto fileName : Pending) {
+            Downloader->Download(url + "/" + QDir(destination).relativeFilePath(fileName), fileName);
+        }
+        Loop.exec();
+        Watchdog.stop();
+
+        // Flushes the partial file , the next round resumes it.
+        if(!Current.isEmpty() && !Recovering) {
+            Downloader->Pause();
+        }
+        delete Downloader;
+
+        QStringList Left;
+        for(auto fileName : Pending) {
+            if(!complete(fileName)) {
+                Left << fileName;
+            }
+        }
+        Pending = Left;
+    }
+    return Result;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser Parser;
+    Parser.addHelpOption();
+    QCommandLineOption FilesOption("files", "Files to download.", "N", "8");
+    QCommandLineOption SizeOption("file-size", "Size of every file in bytes.", "BYTES", "1048576");
+    QCommandLineOption TimeoutOption("timeout", "Timeout of the downloader.", "MS", "2000");
+    QCommandLineOption BackoffOption("backoff", "Wait before a paused file is resumed.", "MS", "200");
+    QCommandLineOption RetriesOption("max-retries", "Resumes of a file in a round.", "N", "50");
+    QCommandLineOption RoundsOption("max-rounds", "Downloaders per profile.", "N", "5");
+    QCommandLineOption StallOption("stall-timeout", "End a round after this long without progress.", "MS", "15000");
+    QCommandLineOption DeadlineOption("deadline", "Give up a profile after this long.", "MS", "120000");
+    QCommandLineOption ProfilesOption("profiles", "Fault profiles to run.", "NAMES");
+    Parser.addOption(FilesOption);
+    Parser.addOption(SizeOption);
+    Parser.addOption(TimeoutOption);
+    Parser.addOption(BackoffOption);
+    Parser.addOption(RetriesOption);
+    Parser.addOption(RoundsOption);
+    Parser.addOption(StallOption);
+    Parser.addOption(DeadlineOption);
+    Parser.addOption(ProfilesOption);
+    Parser.process(app);
+
+    Options Settings;
+    Settings.timeout = qMax(100, Parser.value(TimeoutOption).toInt());
+    Settings.backoff = qMax(0, Parser.value(BackoffOption).toInt());
+    Settings.maxRetries = qMax(0, Parser.value(RetriesOption).toInt());
+    Settings.maxRounds = qMax(1, Parser.value(RoundsOption).toInt());
+    Settings.stallTimeout = qMax(Settings.timeout, Parser.value(StallOption).toInt());
+    Settings.deadline = qMax(1000, Parser.value(DeadlineOption).toInt());
+
+    QVector<Profile> Profiles;
+    Profiles.push_back({ "none", FaultProfile() });
+    {
+        Profile Latency { "latency", FaultProfile() };
+        Latency.faults.latencyMs = 200;
+        Profiles.push_back(Latency);
+
+        Profile Bandwidth { "bandwidth", FaultProfile() };
+        Bandwidth.faults.bytesPerSecond = 8 * 1048576;
+        Profiles.push_back(Bandwidth);
+
+        Profile Drops { "drops", FaultProfile() };
+        Drops.faults.dropAfterBytes = 262144;
+        Profiles.push_back(Drops);
+
+        Profile NoRanges { "no-ranges", FaultProfile() };
+        NoRanges.faults.noAcceptRanges = true;
+        Profiles.push_back(NoRanges);
+
+        Profile NoRangesDrops { "no-ranges-drops", FaultProfile() };
+        NoRangesDrops.faults.noAcceptRanges = true;
+        NoRangesDrops.faults.dropAfterBytes = 262144;
+        Profiles.push_back(NoRangesDrops);
+
+        Profile Burst { "5xx-burst", FaultProfile() };
+        Burst.faults.errorBurst = 2;
+        Profiles.push_back(Burst);
+
+        Profile Slowloris { "slowloris", FaultProfile() };
+        Slowloris.faults.stallAfterBytes = 262144;
+        Slowloris.faults.stallMs = Settings.timeout + 1000;
+        Profiles.push_back(Slowloris);
+    }
+    if(Parser.isSet(ProfilesOption)) {
+        const QStringList Names = Parser.value(ProfilesOption).split(',', QString::SkipEmptyParts);
+        QVector<Profile> Selected;
+        for(auto profile : Profiles) {
+            if(Names.contains(profile.name)) {
+                Selected.push_back(profile);
+            }
+        }
+        Profiles = Selected;
+    }
+
+    const int Files = qMax(1, Parser.value(FilesOption).toInt());
+    const qint64 FileSize = qMax<qint64>(1, Parser.value(SizeOption).toLongLong());
+
+    QTemporaryDir Work;
+    const QString Served = Work.path() + "/served";
+    if(makeCorpus(Served, Files, FileSize, false) < 0) {
+        out << "Cannot create the files to serve!\n";
+        return 1;
+    }
+    QStringList Names;
+    QHash<QString, QByteArray> Digests;
+    for(int file = 0; file < Files ; ++file) {
+        const QString Name = "d" + QString::number(file / 256) + "/f" + QString::number(file);
+        Names << Name;
+        Digests.insert(Name, fileSha1(Served + "/" + Name));
+    }
+
+    LocalRepoServer Server(Served);
+    if(!Server.startServer()) {
+        out << "Cannot start the server!\n";
+        return 1;
+    }
+
+    bool Failed = false;
+    for(auto profile : Profiles) {
+        const QString Destination = Work.path() + "/" + profile.name;
+        QHash<QString, qint64> Sizes;
+        for(auto name : Names) {
+            Sizes.insert(Destination + "/" + name, FileSize);
+        }
+
+        Server.setFaultProfile(profile.faults);
+        const qint64 ServedBefore = Server.bytesServed();
+        const int RequestsBefore = Server.requestsServed(),
+                  FaultsBefore = Server.faultsInjected();
+        QElapsedTimer Clock;
+        Clock.start();
+        Outcome Result = downloadAll(Server.url(), Names, Sizes, Destination, Settings);
+        const double Seconds = Clock.nsecsElapsed() / 1e9;
+
+        int Complete = 0,
+            Corrupt = 0,
+            Missing = 0;
+        for(auto name : Names) {
+            const QString Path = Destination + "/" + name;
+            if(!QFileInfo(Path).exists()) {
+                ++Missing;
+            } else if(fileSha1(Path) != Digests.value(name)) {
+                ++Corrupt;
+            } else {
+                ++Complete;
+            }
+        }
+        const qint64 ServedBytes = Server.bytesServed() - ServedBefore,
+                     PayloadBytes = FileSize * Files;
+
+        QJsonObject Json;
+        Json["profile"] = profile.name;
+        Json["seconds"] = Seconds;
+        Json["rounds"] = Result.rounds;
+        Json["retries"] = Result.retries;
+        Json["errors"] = Result.errors;
+        Json["timeouts"] = Result.timeouts;
+        Json["probe_failures"] = Result.probeFailures;
+        Json["stalled_rounds"] = Result.stalledRounds;
+        Json["faults_injected"] = Server.faultsInjected() - FaultsBefore;
+        Json["requests"] = Server.requestsServed() - RequestsBefore;
+        Json["files"] = Files;
+        Json["complete"] = Complete;
+        Json["corrupt"] = Corrupt;
+        Json["missing"] = Missing;
+        Json["served_bytes"] = ServedBytes;
+        Json["payload_bytes"] = PayloadBytes;
+        Json["redownloaded_bytes"] = ServedBytes - PayloadBytes;
+        if(Result.deadline) {
+            Json["error"] = "deadline reached";
+        }
+        if(profile.name == "none" && Complete != Files) {
+            Failed = true;
+        }
+        out << QJsonDocument(Json).toJson(QJsonDocument::Compact) << "\n";
+        out.flush();
+    }
+    return Failed ? 1 : 0;
+}
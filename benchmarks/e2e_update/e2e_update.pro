@@ -0,0 +1,11 @@
+TEMPLATE=app
+TARGET=e2e_update
+LIBS += -larchive
+QT+=core network xml concurrent
+SOURCES += main.cpp
+HEADERS += ../../QInstallerBridge.hpp \
+	   ../../QArchive/QArchive.hpp \
+	   ../../QEasyDownloader/QEasyDownloader.hpp \
+	   ../common/Corpus.hpp \
+	   ../common/LocalRepoServer.hpp \
+	   ../common/SyntheticRepo.hpp
@@ -0,0 +1,228 @@
+/*
+ * Runs a whole update , check -> download -> install , against a synthetic
+ * repo served from this process and reports every phase.
+ *
+ * Usage: e2e_update [--packages N] [--files N] [--file-size BYTES]
+ *                   [--format SUFFIX] [--dependencies] [--worker-thread]
+ *                   [--streaming] [--runs N] [--trace FILE]
+ *
+ * The repo is made once , every run installs it into a fresh directory.
+ * For every run a JSON line with the phases
+ *   check    - CheckForUpdates() until updatesList().
+ *   download - DownloadUpdates() until updatesDownloaded().
+ *   install  - InstallUpdates() until updatesInstalled().
+ * each with its wall time , the CPU time of the process without the server
+ * thread , the peak RSS of the process so far and for download and install
+ * the bytes and the throughput. With --streaming the archives are extracted
+ * while they download , so most of the install shows in the download phase.
+ * With --trace the phases of every package are traced and written to FILE
+ * as Chrome trace events once all runs are done.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "../../QInstallerBridge.hpp"
+#include "../common/LocalRepoServer.hpp"
+#include "../common/SyntheticRepo.hpp"
+#if defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+struct Sample {
+    qint64 wall = 0;
+    qint64 cpu = 0;
+    qint64 serverCpu = 0;
+    qint64 serverBytes = 0;
+};
+
+static qint64 processCpuNsecs()
+{
+#if defined(Q_OS_UNIX)
+    struct timespec Now;
+    if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &Now) == 0) {
+        return qint64(Now.tv_sec) * 1000000000 + Now.tv_nsec;
+    }
+#endif
+    return 0;
+}
+
+// In KiB , the peak of the whole process up to now.
+static qint64 peakRssKib()
+{
+#if defined(Q_OS_UNIX)
+    struct rusage Usage;
+    if(getrusage(RUSAGE_SELF, &Usage) == 0) {
+#if defined(Q_OS_MACOS)
+        return Usage.ru_maxrss / 1024;
+#else
+        return Usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
+
+static Sample sample(const QElapsedTimer& clock, const LocalRepoServer& server)
+{
+    Sample Now;
+    Now.wall = clock.nsecsElapsed();
+    Now.cpu = processCpuNsecs();
+    Now.serverCpu = server.cpuNsecs();
+    Now.serverBytes = server.bytesServed();
+    return Now;
+}
+
+static QJsonObject phase(const Sample& begin, const Sample& end, qint64 bytes)
+{
+    const double Seconds = (end.wall - begin.wall) / 1e9;
+    QJsonObject Phase;
+    Phase["wall_ms"] = Seconds * 1e3;
+    Phase["cpu_ms"] = ((end.cpu - begin.cpu) - (end.serverCpu - begin.serverCpu)) / 1e6;
+    Phase["peak_rss_kib"] = peakRssKib();
+    if(bytes >= 0) {
+        Phase["bytes"] = bytes;
+        Phase["mib_per_s"] = (Seconds > 0) ? bytes / 1048576.0 / Seconds : 0;
+    }
+    return Phase;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser Parser;
+    Parser.addHelpOption();
+    QCommandLineOption PackagesOption("packages", "Packages in the repo.", "N", "20");
+    QCommandLineOption FilesOption("files", "Files in every package.", "N", "200");
+    QCommandLineOption SizeOption("file-size", "Size of every file in bytes.", "BYTES", "16384");
+    QCommandLineOption FormatOption("format", "Suffix of the content archives.", "SUFFIX", ".tar.gz");
+    QCommandLineOption DependenciesOption("dependencies", "Every package depends on the one before it.");
+    QCommandLineOption WorkerOption("worker-thread", "Run the bridge on its own thread.");
+    QCommandLineOption StreamingOption("streaming", "Extract the archives while they download , needs --worker-thread.");
+    QCommandLineOption RunsOption("runs", "Updates to run.", "N", "3");
+    QCommandLineOption TraceOption("trace", "Write a Chrome trace of the phases.", "FILE");
+    Parser.addOption(PackagesOption);
+    Parser.addOption(FilesOption);
+    Parser.addOption(SizeOption);
+    Parser.addOption(FormatOption);
+    Parser.addOption(DependenciesOption);
+    Parser.addOption(WorkerOption);
+    Parser.addOption(StreamingOption);
+    Parser.addOption(RunsOption);
+    Parser.addOption(TraceOption);
+    Parser.process(app);
+
+    RepoShape Shape;
+    Shape.packages = qMax(1, Parser.value(PackagesOption).toInt());
+    Shape.files = qMax(1, Parser.value(FilesOption).toInt());
+    Shape.fileSize = Parser.value(SizeOption).toLongLong();
+    Shape.suffix = Parser.value(FormatOption);
+    Shape.dependencies = Parser.isSet(DependenciesOption);
+
+    QTemporaryDir Work;
+    const QString Repo = Work.path() + "/repo",
+                  Components = Work.path() + "/components.xml";
+    qint64 PayloadBytes = 0,
+           ArchiveBytes = 0;
+    if(!makeSyntheticRepo(Repo, Work.path() + "/work", Components, Shape, &PayloadBytes, &ArchiveBytes)) {
+        out << "Cannot create the synthetic repo!\n";
+        return 1;
+    }
+
+    LocalRepoServer Server(Repo);
+    if(!Server.startServer()) {
+        out << "Cannot start the repo server!\n";
+        return 1;
+    }
+
+    const int Runs = qMax(1, Parser.value(RunsOption).toInt());
+    bool Failed = false;
+    for(int run = 0; run < Runs ; ++run) {
+        QTemporaryDir InstallDir;
+        const QString LocalComponents = InstallDir.path() + "/components.xml";
+        QFile::copy(Components, LocalComponents);
+
+        auto Bridge = new QInstallerBridge(Server.url(), LocalComponents, InstallDir.path(), false);
+        Bridge->setStreamingInstall(Parser.isSet(StreamingOption));
+        Bridge->setTracing(Parser.isSet(TraceOption));
+        if(Parser.isSet(WorkerOption) && !Bridge->moveToWorkerThread()) {
+            out << "Cannot move the bridge to a worker thread!\n";
+            return 1;
+        }
+
+        QEventLoop Loop;
+        QElapsedTimer Clock;
+        Sample Started, Checked, Downloaded, Installed;
+        QString Failure;
+        qint64 BytesWritten = 0;
+        int Updates = 0;
+
+        QObject::connect(Bridge, &QInstallerBridge::updatesList, &Loop,
+        [&](const QVector<QInstallerBridge::PackageUpdate>& list) {
+            Checked = sample(Clock, Server);
+            Updates = list.size();
+            if(list.isEmpty()) {
+                Failure = "no updates found";
+                Loop.quit();
+                return;
+            }
+            Bridge->DownloadUpdates();
+        });
+        QObject::connect(Bridge, &QInstallerBridge::updatesDownloaded, &Loop, [&]() {
+            Downloaded = sample(Clock, Server);
+            Bridge->InstallUpdates();
+        });
+        QObject::connect(Bridge, &QInstallerBridge::updatesWriteStatistics, &Loop, [&](qint64 written, qint64 skipped) {
+            (void)skipped;
+            BytesWritten = written;
+        });
+        QObject::connect(Bridge, &QInstallerBridge::updatesInstalled, &Loop, [&]() {
+            Installed = sample(Clock, Server);
+            Loop.quit();
+        });
+        QObject::connect(Bridge, &QInstallerBridge::error, &Loop, [&](short code, const QString& what) {
+            Failure = QString::number(code) + " :: " + what;
+            Loop.quit();
+        });
+
+        Clock.start();
+        Started = sample(Clock, Server);
+        Bridge->CheckForUpdates();
+        Loop.exec();
+        delete Bridge;
+
+        QJsonObject Result;
+        Result["run"] = run + 1;
+        Result["packages"] = Shape.packages;
+        Result["updates"] = Updates;
+        Result["files"] = Shape.packages * Shape.files;
+        Result["payload_bytes"] = PayloadBytes;
+        Result["archive_bytes"] = ArchiveBytes;
+        Result["format"] = Shape.suffix;
+        Result["worker_thread"] = Parser.isSet(WorkerOption);
+        Result["streaming"] = Parser.isSet(StreamingOption);
+        if(Failure.isEmpty()) {
+            Result["check"] = phase(Started, Checked, -1);
+            Result["download"] = phase(Checked, Downloaded, Downloaded.serverBytes - Checked.serverBytes);
+            Result["install"] = phase(Downloaded, Installed, BytesWritten);
+            Result["total_wall_ms"] = (Installed.wall - Started.wall) / 1e6;
+        } else {
+            Result["error"] = Failure;
+            Failed = true;
+        }
+        out << QJsonDocument(Result).toJson(QJsonDocument::Compact) << "\n";
+        out.flush();
+    }
+    if(Parser.isSet(TraceOption) && !QInstallerBridgeTrace::exportChromeTrace(Parser.value(TraceOption))) {
+        out << "Cannot write the trace!\n";
+        return 1;
+    }
+    return Failed ? 1 : 0;
+}
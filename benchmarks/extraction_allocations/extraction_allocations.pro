@@ -0,0 +1,8 @@
+TEMPLATE=app
+TARGET=extraction_allocations
+LIBS += -larchive
+QT+=core concurrent
+SOURCES += main.cpp
+HEADERS += ../../QArchive/QArchive.hpp \
+           ../common/AllocationCounter.hpp \
+           ../common/Corpus.hpp
@@ -0,0 +1,166 @@
+/*
+ * Counts the heap allocations QArchive::Extractor makes per archive entry.
+ *
+ * Usage: extraction_allocations [--small N] [--large N] [--file-size BYTES]
+ *                               [--max-per-entry X]
+ *
+ * Every setup extracts a synthetic tree of --small and of --large files ,
+ * the difference of the allocations divided by the difference of the
+ * entries is what a entry costs once the extraction runs , without the
+ * fixed cost of a run. Each run is done once before it is counted , so
+ * lazily created things do not count.
+ * With --max-per-entry the exit code is 1 if a setup needs more , that
+ * catches a allocation which slipped into the loop.
+ * Only the threads of the extractor are counted , the main thread runs
+ * the event loop which receives the progress signals.
+ *
+ * The counts are only there on glibc , see ../common/AllocationCounter.hpp.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "../common/AllocationCounter.hpp"
+#include "../common/Corpus.hpp"
+
+struct Setup {
+    QString name;
+    int writeFlags;
+    int archives;
+};
+
+struct Count {
+    unsigned long long allocations = 0;
+    qint64 entries = 0;
+};
+
+static Count extractOnce(const QStringList& archives, const Setup& setup, bool counted, QString *failure)
+{
+    QTemporaryDir Destination;
+    QArchive::Extractor Extractor;
+    QEventLoop Loop;
+    Count Result;
+
+    Extractor.addArchive(archives);
+    Extractor.setDestination(Destination.path());
+    Extractor.setMaxThreads(archives.size());
+    Extractor.setWriteFlags(setup.writeFlags);
+
+    QObject::connect(&Extractor, &QArchive::Extractor::progress, &Loop,
+    [&](qint64 entries, qint64 bytes, const QStringList& latest) {
+        (void)bytes;
+        (void)latest;
+        Result.entries = entries;
+    });
+    QObject::connect(&Extractor, &QArchive::Extractor::finished, &Loop, &QEventLoop::quit);
+    QObject::connect(&Extractor, &QArchive::Extractor::error, &Loop, [&](short code, const QString& what) {
+        *failure = QString::number(code) + " :: " + what;
+        Loop.quit();
+    });
+
+    if(counted) {
+        AllocationCounter::start();
+    }
+    Extractor.start();
+    Loop.exec();
+    if(counted) {
+        Result.allocations = AllocationCounter::stop();
+    }
+    return Result;
+}
+
+/*
+ * Two halves in two archives , so the setups with two archives
+ * run the path claims too.
+*/
+static QStringList makeArchives(const QString& dir, int files, qint64 fileSize, int archives)
+{
+    QStringList Archives;
+    for(int part = 0; part < archives ; ++part) {
+        QString Tree = dir + "/part" + QString::number(part);
+        QString Archive = dir + "/part" + QString::number(part) + ".tar.gz";
+        if(makeCorpus(Tree, files / archives, fileSize, false) < 0 || !compress(Archive, Tree)) {
+            return QStringList();
+        }
+        Archives << Archive;
+    }
+    return Archives;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser Parser;
+    Parser.addHelpOption();
+    QCommandLineOption SmallOption("small", "Files in the small tree.", "N", "2000");
+    QCommandLineOption LargeOption("large", "Files in the large tree.", "N", "20000");
+    QCommandLineOption SizeOption("file-size", "Size of every file in bytes.", "BYTES", "1024");
+    QCommandLineOption MaxOption("max-per-entry", "Fail if a setup allocates more per entry.", "X");
+    Parser.addOption(SmallOption);
+    Parser.addOption(LargeOption);
+    Parser.addOption(SizeOption);
+    Parser.addOption(MaxOption);
+    Parser.process(app);
+
+    if(!AllocationCounter::isAvailable()) {
+        out << "Allocations can only be counted with glibc!\n";
+        return 1;
+    }
+    AllocationCounter::ignoreThisThread();
+
+    QVector<Setup> Setups;
+    Setups.push_back({ "archive-write-disk", QArchive::DEFAULT_WRITE, 1 });
+    Setups.push_back({ "fast-writer", QArchive::FAST_WRITE & ~QArchive::SYNC_WRITE, 1 });
+    Setups.push_back({ "fast-writer-two-archives", QArchive::FAST_WRITE & ~QArchive::SYNC_WRITE, 2 });
+
+    const int Small = qMax(1, Parser.value(SmallOption).toInt()),
+              Large = qMax(Small + 1, Parser.value(LargeOption).toInt());
+    const qint64 FileSize = Parser.value(SizeOption).toLongLong();
+    const double Max = Parser.isSet(MaxOption) ? Parser.value(MaxOption).toDouble() : -1;
+    bool Failed = false;
+
+    QTemporaryDir Work;
+    for(int setup = 0; setup < Setups.size() ; ++setup) {
+        const int Archives = Setups.at(setup).archives;
+        const QString Dir = Work.path() + "/" + Setups.at(setup).name;
+        QStringList SmallArchives = makeArchives(Dir + "/small", Small, FileSize, Archives),
+                    LargeArchives = makeArchives(Dir + "/large", Large, FileSize, Archives);
+        if(SmallArchives.isEmpty() || LargeArchives.isEmpty()) {
+            out << "Cannot create the synthetic archives!\n";
+            return 1;
+        }
+
+        QString Failure;
+        extractOnce(SmallArchives, Setups.at(setup), false, &Failure);
+        Count SmallCount = extractOnce(SmallArchives, Setups.at(setup), true, &Failure);
+        extractOnce(LargeArchives, Setups.at(setup), false, &Failure);
+        Count LargeCount = extractOnce(LargeArchives, Setups.at(setup), true, &Failure);
+
+        const double PerEntry = (LargeCount.entries > SmallCount.entries) ?
+                                double(qint64(LargeCount.allocations) - qint64(SmallCount.allocations)) /
+                                (LargeCount.entries - SmallCount.entries) : 0;
+
+        QJsonObject Result;
+        Result["setup"] = Setups.at(setup).name;
+        Result["entries_small"] = SmallCount.entries;
+        Result["entries_large"] = LargeCount.entries;
+        Result["allocations_small"] = double(SmallCount.allocations);
+        Result["allocations_large"] = double(LargeCount.allocations);
+        Result["allocations_per_entry"] = PerEntry;
+        if(!Failure.isEmpty()) {
+            Result["error"] = Failure;
+            Failed = true;
+        } else if(Max >= 0 && PerEntry > Max) {
+            Result["error"] = QString("more than %1 allocations per entry").arg(Max);
+            Failed = true;
+        }
+        out << QJsonDocument(Result).toJson(QJsonDocument::Compact) << "\n";
+        out.flush();
+    }
+    return Failed ? 1 : 0;
+}
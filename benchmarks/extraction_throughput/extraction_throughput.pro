@@ -0,0 +1,13 @@
+TEMPLATE=app
+TARGET=extraction_throughput
+LIBS += -larchive
+QT+=core concurrent
+SOURCES += main.cpp
+HEADERS += ../../QArchive/QArchive.hpp \
+           ../common/Corpus.hpp
+
+# qmake CONFIG+=io_uring , needs liburing.
+io_uring {
+    DEFINES += QARCHIVE_USE_IO_URING
+    LIBS += -luring
+}
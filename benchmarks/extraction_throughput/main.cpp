@@ -0,0 +1,162 @@
+/*
+ * Measures the extraction throughput of QArchive::Extractor with
+ * different input and write settings.
+ *
+ * Usage: extraction_throughput [--files N] [--file-size BYTES] [--repeat N]
+ *                              [--archive PATH]
+ *
+ * Without --archive synthetic trees are generated and compressed with
+ * QArchive::Compressor , by default three shapes :
+ *   small-files  - 20000 files of 4 KiB , bound by the syscalls per file.
+ *   huge-files   - 4 files of 128 MiB , bound by the bandwidth.
+ *   sparse-files - 4 files of 128 MiB which are mostly zeros.
+ * Giving --files or --file-size runs a single custom shape instead.
+ * Built with CONFIG+=io_uring the io_uring writer is measured too , its
+ * files_per_s on the small-files shape is the number to look at.
+ * Every setup is run --repeat times and the fastest run is reported as a
+ * JSON line. The page cache is warm after the first run , so the numbers
+ * show the cost of the reads and writes and not of the disk , except for
+ * the setups that sync.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "../common/Corpus.hpp"
+
+struct Setup {
+    QString name;
+    int blockSize;
+    bool memoryMapping;
+    int writeFlags;
+};
+
+struct Shape {
+    QString name;
+    int files;
+    qint64 fileSize;
+    bool zeros;
+};
+
+static qint64 extractOnce(const QString& archive, const Setup& setup, QString *failure)
+{
+    QTemporaryDir Destination;
+    QArchive::Extractor Extractor;
+    QEventLoop Loop;
+
+    Extractor.addArchive(archive);
+    Extractor.setDestination(Destination.path());
+    Extractor.setBlockSize(setup.blockSize);
+    Extractor.setMemoryMapping(setup.memoryMapping);
+    Extractor.setWriteFlags(setup.writeFlags);
+
+    QObject::connect(&Extractor, &QArchive::Extractor::finished, &Loop, &QEventLoop::quit);
+    QObject::connect(&Extractor, &QArchive::Extractor::error, &Loop, [&](short code, const QString& what) {
+        *failure = QString::number(code) + " :: " + what;
+        Loop.quit();
+    });
+
+    QElapsedTimer Timer;
+    Timer.start();
+    Extractor.start();
+    Loop.exec();
+    return Timer.nsecsElapsed();
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser Parser;
+    Parser.addHelpOption();
+    QCommandLineOption FilesOption("files", "Number of files in the synthetic tree.", "N", "2000");
+    QCommandLineOption SizeOption("file-size", "Size of every synthetic file in bytes.", "BYTES", "65536");
+    QCommandLineOption RepeatOption("repeat", "Runs per setup , the fastest is reported.", "N", "3");
+    QCommandLineOption ArchiveOption("archive", "Use this archive instead of a synthetic one.", "PATH");
+    Parser.addOption(FilesOption);
+    Parser.addOption(SizeOption);
+    Parser.addOption(RepeatOption);
+    Parser.addOption(ArchiveOption);
+    Parser.process(app);
+
+    QVector<Setup> Setups;
+    Setups.push_back({ "read-10KiB", 10240, false, QArchive::DEFAULT_WRITE }); // The old behaviour.
+    Setups.push_back({ "read-1MiB", 1048576, false, QArchive::DEFAULT_WRITE });
+    Setups.push_back({ "mmap", 1048576, true, QArchive::DEFAULT_WRITE });
+    Setups.push_back({ "mmap-fast-writer", 1048576, true, QArchive::FAST_WRITE & ~QArchive::SYNC_WRITE });
+    Setups.push_back({ "mmap-sync", 1048576, true, QArchive::SYNC_WRITE });
+    Setups.push_back({ "mmap-fast-writer-sync", 1048576, true, QArchive::FAST_WRITE });
+#if defined(QARCHIVE_USE_IO_URING)
+    Setups.push_back({ "mmap-io-uring", 1048576, true,
+                       QArchive::IO_URING_WRITE | QArchive::BATCH_DIRECTORY_WRITE | QArchive::SKIP_METADATA_WRITE });
+    Setups.push_back({ "mmap-io-uring-times", 1048576, true,
+                       QArchive::IO_URING_WRITE | QArchive::BATCH_DIRECTORY_WRITE });
+#endif
+
+    QVector<Shape> Shapes;
+    if(Parser.isSet(FilesOption) || Parser.isSet(SizeOption)) {
+        Shapes.push_back({ "custom", Parser.value(FilesOption).toInt(), Parser.value(SizeOption).toLongLong(), false });
+    } else {
+        Shapes.push_back({ "small-files", 20000, 4096, false });
+        Shapes.push_back({ "huge-files", 4, 134217728, false });
+        Shapes.push_back({ "sparse-files", 4, 134217728, true });
+    }
+    if(Parser.isSet(ArchiveOption)) {
+        Shapes.clear();
+        Shapes.push_back({ "given", -1, -1, false });
+    }
+
+    const int Repeat = qMax(1, Parser.value(RepeatOption).toInt());
+    bool Failed = false;
+
+    for(int shape = 0; shape < Shapes.size() ; ++shape) {
+        QTemporaryDir Work;
+        QString Archive = Parser.value(ArchiveOption);
+        qint64 RawBytes = -1;
+        const int Files = Shapes.at(shape).files;
+
+        if(Archive.isEmpty()) {
+            RawBytes = makeCorpus(Work.path() + "/corpus", Files, Shapes.at(shape).fileSize, Shapes.at(shape).zeros);
+            Archive = Work.path() + "/corpus.tar.gz";
+            if(RawBytes < 0 || !compress(Archive, Work.path() + "/corpus")) {
+                out << "Cannot create the synthetic archive!\n";
+                return 1;
+            }
+        }
+
+        const qint64 ArchiveBytes = QFileInfo(Archive).size();
+        for(int setup = 0; setup < Setups.size() ; ++setup) {
+            qint64 Best = -1;
+            QString Failure;
+            for(int run = 0; run < Repeat && Failure.isEmpty() ; ++run) {
+                qint64 Elapsed = extractOnce(Archive, Setups.at(setup), &Failure);
+                if(Best < 0 || Elapsed < Best) {
+                    Best = Elapsed;
+                }
+            }
+
+            double Seconds = Best / 1e9;
+            QJsonObject Result;
+            Result["shape"] = Shapes.at(shape).name;
+            Result["setup"] = Setups.at(setup).name;
+            Result["seconds"] = Seconds;
+            Result["archive_mib_per_s"] = ArchiveBytes / 1048576.0 / Seconds;
+            if(RawBytes >= 0) {
+                Result["raw_mib_per_s"] = RawBytes / 1048576.0 / Seconds;
+                Result["files_per_s"] = Files / Seconds;
+            }
+            if(!Failure.isEmpty()) {
+                Result["error"] = Failure;
+                Failed = true;
+            }
+            out << QJsonDocument(Result).toJson(QJsonDocument::Compact) << "\n";
+            out.flush();
+        }
+    }
+    return Failed ? 1 : 0;
+}
@@ -0,0 +1,8 @@
+TEMPLATE=app
+TARGET=gui_thread_busy
+LIBS += -larchive
+QT+=core network xml concurrent
+SOURCES += main.cpp
+HEADERS += ../../QInstallerBridge.hpp \
+	   ../../QArchive/QArchive.hpp \
+	   ../../QEasyDownloader/QEasyDownloader.hpp
@@ -0,0 +1,135 @@
+/*
+ * Measures how long the main (GUI) thread is busy during a full update
+ * cycle , once with the bridge on the caller's thread and once with the
+ * bridge on its own worker thread.
+ *
+ * Usage: gui_thread_busy <repo url> <components.xml>
+ *
+ * The components.xml is copied to a temporary directory for every run
+ * and the updates are installed there , so the given file is untouched.
+*/
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "../../QInstallerBridge.hpp"
+
+/*
+ * Counts the time the main thread spends delivering events ,
+ * which is the time a GUI would be frozen.
+*/
+class BusyApplication : public QCoreApplication
+{
+public:
+    BusyApplication(int &argc, char **argv)
+        : QCoreApplication(argc, argv)
+    {
+        return;
+    }
+
+    bool notify(QObject *receiver, QEvent *event)
+    {
+        if(QThread::currentThread() != thread() || depth > 0) {
+            return QCoreApplication::notify(receiver, event);
+        }
+
+        QElapsedTimer Timer;
+        Timer.start();
+        ++depth;
+        bool ret = QCoreApplication::notify(receiver, event);
+        --depth;
+        busyTime += Timer.nsecsElapsed();
+        return ret;
+    }
+
+    qint64 busyTime = 0;
+    int depth = 0;
+};
+
+static QJsonObject runCycle(BusyApplication *app, bool threaded, const QString& repo, const QString& components)
+{
+    QJsonObject Result;
+    QTemporaryDir InstallDir;
+    QString LocalComponents = InstallDir.path() + "/components.xml";
+    QFile::copy(components, LocalComponents);
+
+    auto Bridge = new QInstallerBridge(repo, LocalComponents, InstallDir.path(), false);
+    if(threaded && !Bridge->moveToWorkerThread()) {
+        Result["error"] = QString("cannot move the bridge to a worker thread");
+        delete Bridge;
+        return Result;
+    }
+
+    QEventLoop Loop;
+    QString Failure;
+    int Packages = 0;
+
+    QObject::connect(Bridge, &QInstallerBridge::updatesList, &Loop,
+    [&](const QVector<QInstallerBridge::PackageUpdate>& list) {
+        Packages = list.size();
+        if(list.isEmpty()) {
+            Loop.quit();
+            return;
+        }
+        Bridge->DownloadUpdates();
+    });
+    QObject::connect(Bridge, &QInstallerBridge::updatesDownloaded, &Loop, [&]() {
+        Bridge->InstallUpdates();
+    });
+    QObject::connect(Bridge, &QInstallerBridge::updatesInstalled, &Loop, &QEventLoop::quit);
+    QObject::connect(Bridge, &QInstallerBridge::error, &Loop, [&](short code, const QString& what) {
+        Failure = QString::number(code) + " :: " + what;
+        Loop.quit();
+    });
+
+    QElapsedTimer Wall;
+    Wall.start();
+    qint64 BusyAtStart = app->busyTime;
+
+    // The direct call is GUI time too.
+    QElapsedTimer Direct;
+    Direct.start();
+    Bridge->CheckForUpdates();
+    qint64 DirectTime = Direct.nsecsElapsed();
+
+    Loop.exec();
+
+    qint64 WallTime = Wall.nsecsElapsed();
+    qint64 BusyTime = app->busyTime - BusyAtStart + DirectTime;
+    delete Bridge;
+
+    Result["mode"] = threaded ? QString("worker-thread") : QString("caller-thread");
+    Result["packages"] = Packages;
+    Result["wall_ms"] = WallTime / 1e6;
+    Result["gui_busy_ms"] = BusyTime / 1e6;
+    Result["gui_busy_percent"] = (WallTime > 0) ? (100.0 * BusyTime / WallTime) : 0.0;
+    if(!Failure.isEmpty()) {
+        Result["error"] = Failure;
+    }
+    return Result;
+}
+
+int main(int argc, char **argv)
+{
+    BusyApplication app(argc, argv);
+    QTextStream out(stdout);
+    if(app.arguments().size() < 3) {
+        out << "Usage: " << app.arguments().at(0) << " <repo url> <components.xml>\n";
+        return 1;
+    }
+
+    const QString Repo = app.arguments().at(1);
+    const QString Components = app.arguments().at(2);
+    bool Failed = false;
+
+    for(int threaded = 0; threaded < 2 ; ++threaded) {
+        QJsonObject Result = runCycle(&app, threaded, Repo, Components);
+        Failed |= Result.contains("error");
+        out << QJsonDocument(Result).toJson(QJsonDocument::Compact) << "\n";
+        out.flush();
+    }
+    return Failed ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * Measures the xml side of a update check and of a install at scale ,
+ * RepoSync() with the Updates.xml and the components.xml and RepoMergeXML()
+ * which writes a new version into the components.xml.
+ *
+ * Usage: xml_processing [--sizes N,N,...] [--repeat N] [--merge-calls N]
+ *
+ * For every size (default 100 , 10000 and 100000 packages) a Updates.xml
+ * and a components.xml one version behind it are generated , then
+ *   parse - RepoSync() against a components.xml without packages , that is
+ *           the Updates.xml parsed and nothing matched.
+ *   sync  - RepoSync() against the full components.xml , every package is
+ *           a update.
+ *   match - sync - parse , the comparing of the versions.
+ *   merge - RepoMergeXML() of one package , --merge-calls of them are run
+ *           and merge_all_ms is what a install of every package would cost.
+ * The slots are private , they are called through the meta object like the
+ * downloader does. Every number is the median of --repeat runs and comes
+ * with the heap allocations of the run , the output is one JSON line per
+ * size with sorted keys so it can be diffed in CI. The allocations are only
+ * counted with glibc.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include "../../QInstallerBridge.hpp"
+#include "../common/AllocationCounter.hpp"
+#include "../common/SyntheticRepo.hpp"
+
+struct Measure {
+    qint64 nsecs = 0;
+    unsigned long long allocations = 0;
+};
+
+static Measure median(QVector<Measure> runs)
+{
+    std::sort(runs.begin(), runs.end(), [](const Measure& a, const Measure& b) {
+        return a.nsecs < b.nsecs;
+    });
+    return runs.at(runs.size() / 2);
+}
+
+/*
+ * A fresh bridge for every run , RepoSync() adds to the updates
+ * found before and only CheckForUpdates() clears them.
+*/
+static Measure repoSync(const QString& updates, const QString& components, int *found, QString *failure)
+{
+    QInstallerBridge Bridge("http://127.0.0.1", components, QFileInfo(components).path(), false);
+    QObject::connect(&Bridge, &QInstallerBridge::updatesList, [found](const QVector<QInstallerBridge::PackageUpdate>& list) {
+        *found = list.size();
+    });
+    QObject::connect(&Bridge, &QInstallerBridge::error, [failure](short code, const QString& what) {
+        *failure = QString::number(code) + " :: " + what;
+    });
+
+    Measure Result;
+    QElapsedTimer Timer;
+    AllocationCounter::start();
+    Timer.start();
+    QMetaObject::invokeMethod(&Bridge, "RepoSync", Qt::DirectConnection, Q_ARG(QString, updates));
+    Result.nsecs = Timer.nsecsElapsed();
+    Result.allocations = AllocationCounter::stop();
+    return Result;
+}
+
+static Measure repoMerge(const QString& components, int package, QString *failure)
+{
+    QInstallerBridge Bridge("http://127.0.0.1", components, QFileInfo(components).path(), false);
+    QObject::connect(&Bridge, &QInstallerBridge::error, [failure](short code, const QString& what) {
+        *failure = QString::number(code) + " :: " + what;
+    });
+
+    Measure Result;
+    QElapsedTimer Timer;
+    AllocationCounter::start();
+    Timer.start();
+    QMetaObject::invokeMethod(&Bridge, "RepoMergeXML", Qt::DirectConnection,
+                              Q_ARG(QString, syntheticPackageName(package)), Q_ARG(QString, QString("1.0.1")));
+    Result.nsecs = Timer.nsecsElapsed();
+    Result.allocations = AllocationCounter::stop();
+    return Result;
+}
+
+static void store(QJsonObject *result, const QString& name, const Measure& measure)
+{
+    (*result)[name + "_ms"] = measure.nsecs / 1e6;
+    (*result)[name + "_allocations"] = double(measure.allocations);
+    return;
+}
+
+static QString readAll(const QString& fileName)
+{
+    QFile File(fileName);
+    File.open(QIODevice::ReadOnly);
+    return QString::fromUtf8(File.readAll());
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser Parser;
+    Parser.addHelpOption();
+    QCommandLineOption SizesOption("sizes", "Packages of every run , comma separated.", "N,N,...", "100,10000,100000");
+    QCommandLineOption RepeatOption("repeat", "Runs per measure , the median is reported.", "N", "5");
+    QCommandLineOption MergeOption("merge-calls", "RepoMergeXML() calls per size.", "N", "5");
+    Parser.addOption(SizesOption);
+    Parser.addOption(RepeatOption);
+    Parser.addOption(MergeOption);
+    Parser.process(app);
+
+    const int Repeat = qMax(1, Parser.value(RepeatOption).toInt()),
+              MergeCalls = qMax(1, Parser.value(MergeOption).toInt());
+    const QStringList Sizes = Parser.value(SizesOption).split(",", QString::SkipEmptyParts);
+    bool Failed = false;
+
+    for(int size = 0; size < Sizes.size() ; ++size) {
+        QTemporaryDir Work;
+        RepoShape Shape,
+                  Nothing;
+        Shape.packages = qMax(1, Sizes.at(size).trimmed().toInt());
+        Shape.dependencies = true;
+        Nothing.packages = 0;
+
+        const QString Components = Work.path() + "/components.xml",
+                      Empty = Work.path() + "/empty.xml";
+        if(!writeSyntheticUpdatesXml(Work.path() + "/Updates.xml", Shape, QByteArray(40, '0')) ||
+           !writeSyntheticComponentsXml(Components, Shape) ||
+           !writeSyntheticComponentsXml(Empty, Nothing)) {
+            out << "Cannot write the xml files!\n";
+            return 1;
+        }
+        const QString Updates = readAll(Work.path() + "/Updates.xml");
+
+        QString Failure;
+        int Found = 0,
+            Unused = 0;
+        QVector<Measure> Parse, Sync, Merge;
+        for(int run = 0; run < Repeat && Failure.isEmpty() ; ++run) {
+            Parse << repoSync(Updates, Empty, &Unused, &Failure);
+            Sync << repoSync(Updates, Components, &Found, &Failure);
+        }
+        // Every call rewrites the components.xml , so the merges come after the syncs.
+        for(int call = 0; call < MergeCalls && Failure.isEmpty() ; ++call) {
+            Merge << repoMerge(Components, call % Shape.packages, &Failure);
+        }
+
+        QJsonObject Result;
+        Result["packages"] = Shape.packages;
+        Result["updates_xml_bytes"] = Updates.toUtf8().size();
+        Result["updates_found"] = Found;
+        if(Failure.isEmpty()) {
+            const Measure ParseMedian = median(Parse),
+                          SyncMedian = median(Sync),
+                          MergeMedian = median(Merge);
+            Measure Match;
+            Match.nsecs = qMax<qint64>(0, SyncMedian.nsecs - ParseMedian.nsecs);
+            Match.allocations = (SyncMedian.allocations > ParseMedian.allocations) ?
+                                SyncMedian.allocations - ParseMedian.allocations : 0;
+            store(&Result, "parse", ParseMedian);
+            store(&Result, "sync", SyncMedian);
+            store(&Result, "match", Match);
+            store(&Result, "merge", MergeMedian);
+            Result["merge_all_ms"] = MergeMedian.nsecs / 1e6 * Found;
+        } else {
+            Result["error"] = Failure;
+            Failed = true;
+        }
+        Result["allocations_counted"] = AllocationCounter::isAvailable();
+        out << QJsonDocument(Result).toJson(QJsonDocument::Compact) << "\n";
+        out.flush();
+    }
+    return Failed ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+TEMPLATE=app
+TARGET=xml_processing
+LIBS += -larchive
+QT+=core network xml concurrent
+SOURCES += main.cpp
+HEADERS += ../../QInstallerBridge.hpp \
+	   ../../QArchive/QArchive.hpp \
+	   ../../QEasyDownloader/QEasyDownloader.hpp \
+	   ../common/AllocationCounter.hpp \
+	   ../common/Corpus.hpp \
+	   ../common/SyntheticRepo.hpp
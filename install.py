@@ -10,39 +10,48 @@ import requests
 from shutil import rmtree
 
 # Packages to install
+# QArchive and QEasyDownloader are shipped in-tree since the bridge
+# depends on API that upstream does not have.
 QInstallerBridge = {
         "username" : "antony-jr",
         "repo"     : "QInstallerBridge",
+        "name"     : "QInstallerBridge",
         "mkdir"    : "QInstallerBridge",
         "install"  : {
             "QInstallerBridge.hpp" : "QInstallerBridge/QInstallerBridge.hpp",
+            "QInstallerBridgeDelta.hpp" : "QInstallerBridge/QInstallerBridgeDelta.hpp",
+            "QInstallerBridgeTrace.hpp" : "QInstallerBridge/QInstallerBridgeTrace.hpp",
+            "QInstallerBridgeMetrics.hpp" : "QInstallerBridge/QInstallerBridgeMetrics.hpp",
+            "QInstallerBridgeMetricsEndpoint.hpp" : "QInstallerBridge/QInstallerBridgeMetricsEndpoint.hpp",
             "LICENSE"              : "QInstallerBridge/LICENSE"
         }
 }
 
 QArchive = {
         "username" : "antony-jr",
-        "repo"     : "QArchive",
+        "repo"     : "QInstallerBridge",
+        "name"     : "QArchive",
         "mkdir"    : "QInstallerBridge/QArchive",
         "install"  : {
-            "QArchive.hpp" : "QInstallerBridge/QArchive/QArchive.hpp",
-            "LICENSE"      : "QInstallerBridge/QArchive/LICENSE"
+            "QArchive/QArchive.hpp" : "QInstallerBridge/QArchive/QArchive.hpp",
+            "QArchive/LICENSE" : "QInstallerBridge/QArchive/LICENSE"
         }
 }
 
 QEasyDownloader = {
         "username" : "antony-jr",
-        "repo"     : "QEasyDownloader",
+        "repo"     : "QInstallerBridge",
+        "name"     : "QEasyDownloader",
         "mkdir"    : "QInstallerBridge/QEasyDownloader",
         "install"  : {
-            "QEasyDownloader.hpp" : "QInstallerBridge/QEasyDownloader/QEasyDownloader.hpp",
-            "LICENSE"      : "QInstallerBridge/QEasyDownloader/LICENSE"
+            "QEasyDownloader/QEasyDownloader.hpp" : "QInstallerBridge/QEasyDownloader/QEasyDownloader.hpp",
+            "QEasyDownloader/LICENSE" : "QInstallerBridge/QEasyDownloader/LICENSE"
         }
 }
 
 
 def installPackage(config):
-    print("Installing " + config["repo"])
+    print("Installing " + config["name"])
     print("Creating Directory " + config["mkdir"])
     if os.path.exists(config["mkdir"]):
         rmtree(config["mkdir"])
@@ -57,7 +66,7 @@ def installPackage(config):
             fp.write(it)
         fp.close()
 
-    print("Installed "+config["repo"] + ".")
+    print("Installed "+config["name"] + ".")
     return True
 
 if __name__ == "__main__":
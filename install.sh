@@ -16,9 +16,18 @@ if [ $isCurl ]
 		mkdir $packageName
 		cd $packageName
 		echo Downloading LICENSE and the latest files... 
-		curl -L https://git.io/vbdTI | bash # Install QArchive
-		curl -L https://git.io/vbdTW | bash # Install QEasyDownloader
+		# QArchive and QEasyDownloader are shipped in-tree since the bridge
+		# depends on API that upstream does not have.
+		mkdir QArchive QEasyDownloader
+		curl -L ${repoRawUrl}QArchive/QArchive.hpp --output QArchive/QArchive.hpp
+		curl -L ${repoRawUrl}QArchive/$license --output QArchive/$license
+		curl -L ${repoRawUrl}QEasyDownloader/QEasyDownloader.hpp --output QEasyDownloader/QEasyDownloader.hpp
+		curl -L ${repoRawUrl}QEasyDownloader/$license --output QEasyDownloader/$license
 		curl -L $repoRawUrl$packageName.hpp --output $packageName.hpp
+		curl -L ${repoRawUrl}${packageName}Delta.hpp --output ${packageName}Delta.hpp
+		curl -L ${repoRawUrl}${packageName}Trace.hpp --output ${packageName}Trace.hpp
+		curl -L ${repoRawUrl}${packageName}Metrics.hpp --output ${packageName}Metrics.hpp
+		curl -L ${repoRawUrl}${packageName}MetricsEndpoint.hpp --output ${packageName}MetricsEndpoint.hpp
 		curl -L $repoRawUrl$license --output $license
 		echo Installation complete!
 		echo Thank you for choosing $packageName
@@ -0,0 +1,8 @@
+TEMPLATE=app
+TARGET=delta_generator
+CONFIG += console
+LIBS += -larchive
+QT+=core concurrent
+SOURCES += main.cpp
+HEADERS += ../../QInstallerBridgeDelta.hpp \
+           ../../QArchive/QArchive.hpp
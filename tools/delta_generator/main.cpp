@@ -0,0 +1,180 @@
+/*
+ * Makes a delta archive between two versions of a package.
+ *
+ * Usage: delta_generator [--block-size N] <old package dir> <new package dir> <delta archive>
+ *
+ * Every file of the new package which is not the same in the old one is
+ * written to the delta archive , as a <path>.qibdelta delta against the
+ * old file when that is smaller and as it is otherwise. The archive format
+ * follows its name like with QArchive::Compressor , a <delta archive>.sha1
+ * is written next to it for the repo.
+ *
+ * In the Updates.xml of the repo :
+ *   <DeltaArchives BaseVersion="{old version}">{name of the delta archive}</DeltaArchives>
+ * the name is prefixed with the version like the DownloadableArchives.
+ *
+ * Links cannot be in a delta , a package whose links changed needs the
+ * full archives.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "../../QInstallerBridgeDelta.hpp"
+
+static bool readAll(const QString& fileName, QByteArray *data)
+{
+    QFile File(fileName);
+    if(!File.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    *data = File.readAll();
+    return (File.error() == QFileDevice::NoError);
+}
+
+static bool writeAll(const QString& fileName, const QByteArray& data, QFileDevice::Permissions permissions)
+{
+    QDir().mkpath(QFileInfo(fileName).path());
+    QFile File(fileName);
+    if(!File.open(QIODevice::WriteOnly | QIODevice::Truncate) || File.write(data) != data.size()) {
+        return false;
+    }
+    File.setPermissions(permissions);
+    return true;
+}
+
+/*
+ * The Compressor stores the paths as they are given , so it runs
+ * from inside the tree to get paths relative to the package.
+*/
+static bool compress(const QString& archive, const QString& dir, QString *failure)
+{
+    QStringList Nodes = QDir(dir).entryList(QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot);
+    QString Current = QDir::currentPath();
+    QDir::setCurrent(dir);
+
+    QArchive::Compressor Compressor(archive, Nodes);
+    QEventLoop Loop;
+    bool ok = false;
+    QObject::connect(&Compressor, &QArchive::Compressor::finished, &Loop, [&]() {
+        ok = true;
+        Loop.quit();
+    });
+    QObject::connect(&Compressor, &QArchive::Compressor::error, &Loop, [&](short code, const QString& what) {
+        *failure = QString::number(code) + " :: " + what;
+        Loop.quit();
+    });
+    Compressor.start();
+    Loop.exec();
+
+    QDir::setCurrent(Current);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser Parser;
+    Parser.addHelpOption();
+    QCommandLineOption BlockSizeOption("block-size", "Block size of the deltas in bytes.", "N",
+                                       QString::number(QInstallerBridgeDelta::DefaultBlockSize));
+    Parser.addOption(BlockSizeOption);
+    Parser.addPositionalArgument("old", "The directory of the installed version of the package.");
+    Parser.addPositionalArgument("new", "The directory of the new version of the package.");
+    Parser.addPositionalArgument("archive", "The delta archive to write.");
+    Parser.process(app);
+
+    if(Parser.positionalArguments().size() != 3) {
+        Parser.showHelp(1);
+    }
+    const QString OldDir = QDir(Parser.positionalArguments().at(0)).absolutePath(),
+                  NewDir = QDir(Parser.positionalArguments().at(1)).absolutePath(),
+                  Archive = QFileInfo(Parser.positionalArguments().at(2)).absoluteFilePath();
+    const int BlockSize = qMax(64, Parser.value(BlockSizeOption).toInt());
+
+    QTemporaryDir Work;
+    if(!Work.isValid()) {
+        out << "Cannot create a temporary directory!\n";
+        return 1;
+    }
+
+    int Unchanged = 0,
+        Deltas = 0,
+        Full = 0;
+    qint64 NewBytes = 0;
+    QDirIterator Files(NewDir, QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+    while(Files.hasNext()) {
+        const QString NewFile = Files.next();
+        const QString Relative = QDir(NewDir).relativeFilePath(NewFile);
+        const QFileInfo NewInfo = Files.fileInfo(),
+                        OldInfo(OldDir + "/" + Relative);
+
+        if(NewInfo.isSymLink()) {
+            out << "Cannot put the link " << Relative << " in a delta , use the full archives.\n";
+            return 1;
+        }
+
+        QByteArray Target, Base;
+        if(!readAll(NewFile, &Target)) {
+            out << "Cannot read " << NewFile << "\n";
+            return 1;
+        }
+        NewBytes += Target.size();
+
+        const bool hasBase = OldInfo.isFile() && !OldInfo.isSymLink() && readAll(OldInfo.filePath(), &Base);
+        if(hasBase && Base == Target && OldInfo.permissions() == NewInfo.permissions()) {
+            ++Unchanged;
+            continue;
+        }
+
+        bool written;
+        QByteArray Delta;
+        if(hasBase) {
+            Delta = QInstallerBridgeDelta::encode(Base, Target, BlockSize);
+        }
+        /*
+         * A delta keeps the permissions of the installed file ,
+         * so a file whose permissions changed goes as it is.
+        */
+        if(hasBase && Delta.size() < Target.size() && OldInfo.permissions() == NewInfo.permissions()) {
+            written = writeAll(Work.path() + "/" + Relative + QInstallerBridgeDelta::Suffix, Delta, NewInfo.permissions());
+            ++Deltas;
+        } else {
+            written = writeAll(Work.path() + "/" + Relative, Target, NewInfo.permissions());
+            ++Full;
+        }
+        if(!written) {
+            out << "Cannot write " << Relative << " to " << Work.path() << "\n";
+            return 1;
+        }
+    }
+
+    if(Deltas + Full == 0) {
+        out << "The packages are the same , no delta archive is needed.\n";
+        return 0;
+    }
+
+    QString Failure;
+    QFile::remove(Archive);
+    if(!compress(Archive, Work.path(), &Failure)) {
+        out << "Cannot create " << Archive << " :: " << Failure << "\n";
+        return 1;
+    }
+
+    QFile ArchiveFile(Archive),
+          ChecksumFile(Archive + ".sha1");
+    QCryptographicHash Hash(QCryptographicHash::Sha1);
+    if(!ArchiveFile.open(QIODevice::ReadOnly) || !Hash.addData(&ArchiveFile) ||
+       !ChecksumFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        out << "Cannot write " << ChecksumFile.fileName() << "\n";
+        return 1;
+    }
+    ChecksumFile.write(Hash.result().toHex());
+
+    out << "unchanged: " << Unchanged << " , deltas: " << Deltas << " , full: " << Full << "\n";
+    out << "new package: " << NewBytes << " bytes , delta archive: " << ArchiveFile.size() << " bytes\n";
+    return 0;
+}
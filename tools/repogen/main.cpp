@@ -0,0 +1,518 @@
+/*
+ * Generates a repo QInstallerBridge can update from , incrementally.
+ *
+ * Usage: repogen [--format SUFFIX] [--jobs N] [--threads N] [--level N]
+ *                [--external-filters] <packages dir> <repo dir>
+ *
+ * The packages dir is laid out like for the Qt Installer Framework :
+ *   <packages dir>/<name>/meta/package.xml - DisplayName , Description , Version ,
+ *                                            ReleaseDate and Dependencies.
+ *   <packages dir>/<name>/data/            - the files of the package.
+ * For every package the repo gets
+ *   <repo dir>/<name>/<version>meta.7z         - the meta directory , under <name>/
+ *                                                like archivegen lays it out.
+ *   <repo dir>/<name>/<version>content<SUFFIX> - the data directory , SUFFIX is
+ *                                                .7z by default , a tar suffix
+ *                                                lets the bridge stream it.
+ *   <repo dir>/<name>/<version>content<SUFFIX>.sha1
+ * and <repo dir>/Updates.xml lists all of them with the SHA1 of their meta.7z.
+ *
+ * The digest of every input tree is kept in <repo dir>/.repogen , a package
+ * is only compressed again if its tree , the format or the level changed or
+ * its files in the repo are gone or have another size. A file is only hashed
+ * again if its size or mtime changed , so a run over a unchanged repo only
+ * stats the trees.
+ * Up to --jobs archives are compressed at once , each with --threads.
+ * --external-filters lets gzip and bzip2 use pigz and pbzip2 for the threads.
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QtConcurrent>
+#include "../../QArchive/QArchive.hpp"
+
+struct FileDigest {
+    qint64 size = 0;
+    qint64 mtime = 0;
+    QByteArray sha1;
+};
+
+struct PackageState {
+    QString version;
+    QByteArray treeDigest;
+    QString archive;
+    QString metaSha1;
+    qint64 metaSize;
+    qint64 archiveSize;
+};
+
+struct Package {
+    QString name;
+    QString dir;
+    QString version;
+    QString displayName;
+    QString description;
+    QString releaseDate;
+    QString dependencies;
+    QString archive; // content<SUFFIX> , empty if there is no data.
+    QString metaSha1;
+    qint64 metaSize = -1;
+    qint64 archiveSize = -1;
+    QByteArray treeDigest;
+    QHash<QString, FileDigest> files; // Every file of the tree , by its absolute path.
+    QString failure;
+};
+
+struct Job {
+    int package;
+    bool meta;
+};
+
+static const quint32 StateMagic = 0x52504753; // "RPGS"
+static const quint8 StateVersion = 2;
+
+static QDataStream& operator<<(QDataStream& stream, const FileDigest& digest)
+{
+    return stream << digest.size << digest.mtime << digest.sha1;
+}
+
+static QDataStream& operator>>(QDataStream& stream, FileDigest& digest)
+{
+    return stream >> digest.size >> digest.mtime >> digest.sha1;
+}
+
+static QDataStream& operator<<(QDataStream& stream, const PackageState& state)
+{
+    return stream << state.version << state.treeDigest << state.archive << state.metaSha1
+                  << state.metaSize << state.archiveSize;
+}
+
+static QDataStream& operator>>(QDataStream& stream, PackageState& state)
+{
+    return stream >> state.version >> state.treeDigest >> state.archive >> state.metaSha1
+                  >> state.metaSize >> state.archiveSize;
+}
+
+/*
+ * A state which cannot be read is no state , everything
+ * is compressed again then.
+*/
+static void loadState(const QString& fileName, QHash<QString, PackageState> *packages,
+                      QHash<QString, FileDigest> *files)
+{
+    QFile File(fileName);
+    if(!File.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream Stream(&File);
+    Stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint8 version = 0;
+    Stream >> magic >> version;
+    if(magic != StateMagic || version != StateVersion) {
+        return;
+    }
+    Stream >> *packages >> *files;
+    if(Stream.status() != QDataStream::Ok) {
+        packages->clear();
+        files->clear();
+    }
+    return;
+}
+
+static bool saveState(const QString& fileName, const QHash<QString, PackageState>& packages,
+                      const QHash<QString, FileDigest>& files)
+{
+    QSaveFile File(fileName);
+    if(!File.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream Stream(&File);
+    Stream.setVersion(QDataStream::Qt_5_0);
+    Stream << StateMagic << StateVersion << packages << files;
+    return (Stream.status() == QDataStream::Ok && File.commit());
+}
+
+static bool fileSha1(const QString& fileName, QByteArray *sha1)
+{
+    QFile File(fileName);
+    QCryptographicHash Hash(QCryptographicHash::Sha1);
+    if(!File.open(QIODevice::ReadOnly) || !Hash.addData(&File)) {
+        return false;
+    }
+    *sha1 = Hash.result();
+    return true;
+}
+
+static bool readPackageXml(Package *package)
+{
+    QFile File(package->dir + "/meta/package.xml");
+    if(!File.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        package->failure = "cannot read " + File.fileName();
+        return false;
+    }
+    QXmlStreamReader XMLReader(&File);
+    while(!XMLReader.atEnd() && !XMLReader.hasError()) {
+        XMLReader.readNext();
+        if(!XMLReader.isStartElement()) {
+            continue;
+        }
+        QString Key = XMLReader.name().toString();
+        if(Key == "DisplayName") {
+            package->displayName = XMLReader.readElementText();
+        } else if(Key == "Description") {
+            package->description = XMLReader.readElementText();
+        } else if(Key == "Version") {
+            package->version = XMLReader.readElementText();
+        } else if(Key == "ReleaseDate") {
+            package->releaseDate = XMLReader.readElementText();
+        } else if(Key == "Dependencies") {
+            package->dependencies = XMLReader.readElementText();
+        }
+    }
+    if(XMLReader.hasError() || package->version.isEmpty()) {
+        package->failure = File.fileName() + " :: " + (XMLReader.hasError() ? XMLReader.errorString() : "no Version");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Every field goes in with its length , so the end of one field can
+ * never pass for the start of the next.
+*/
+static void addField(QCryptographicHash *hash, const QByteArray& field)
+{
+    hash->addData(QByteArray::number(field.size()) + ':');
+    hash->addData(field);
+    return;
+}
+
+/*
+ * The digest of the tree covers every path , its type , its permissions
+ * and its content , links by their target. Runs on the global pool , the
+ * cache of the last run is only read.
+*/
+static void digestPackage(Package *package, const QHash<QString, FileDigest>& cache, const QByteArray& settings)
+{
+    if(!readPackageXml(package)) {
+        return;
+    }
+
+    QStringList Paths;
+    QDirIterator Files(package->dir, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                       QDirIterator::Subdirectories);
+    while(Files.hasNext()) {
+        Paths << Files.next();
+    }
+    Paths.sort();
+
+    QCryptographicHash Tree(QCryptographicHash::Sha1);
+    addField(&Tree, settings);
+    addField(&Tree, package->version.toUtf8());
+    for(int path = 0; path < Paths.size() ; ++path) {
+        const QFileInfo Info(Paths.at(path));
+        addField(&Tree, QDir(package->dir).relativeFilePath(Paths.at(path)).toUtf8());
+        addField(&Tree, QByteArray::number(int(Info.permissions())));
+        if(Info.isSymLink()) {
+            addField(&Tree, "link");
+            addField(&Tree, Info.symLinkTarget().toUtf8());
+            continue;
+        }
+        if(!Info.isFile()) {
+            addField(&Tree, "directory");
+            continue;
+        }
+
+        FileDigest Digest = cache.value(Paths.at(path));
+        const qint64 MTime = Info.lastModified().toMSecsSinceEpoch();
+        if(Digest.sha1.isEmpty() || Digest.size != Info.size() || Digest.mtime != MTime) {
+            Digest.size = Info.size();
+            Digest.mtime = MTime;
+            if(!fileSha1(Paths.at(path), &Digest.sha1)) {
+                package->failure = "cannot read " + Paths.at(path);
+                return;
+            }
+        }
+        addField(&Tree, "file");
+        addField(&Tree, Digest.sha1);
+        package->files.insert(Paths.at(path), Digest);
+    }
+    package->treeDigest = Tree.result();
+    return;
+}
+
+static bool writeUpdatesXml(const QString& fileName, const QVector<Package>& packages)
+{
+    QSaveFile File(fileName);
+    if(!File.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QXmlStreamWriter XMLWriter(&File);
+    XMLWriter.setAutoFormatting(true);
+    XMLWriter.writeStartDocument();
+    XMLWriter.writeStartElement("Updates");
+    XMLWriter.writeTextElement("ApplicationName", "{AnyApplication}");
+    XMLWriter.writeTextElement("ApplicationVersion", "1.0.0");
+    XMLWriter.writeTextElement("Checksum", "true");
+    for(int item = 0; item < packages.size() ; ++item) {
+        const Package &Update = packages.at(item);
+        XMLWriter.writeStartElement("PackageUpdate");
+        XMLWriter.writeTextElement("Name", Update.name);
+        XMLWriter.writeTextElement("DisplayName", Update.displayName);
+        XMLWriter.writeTextElement("Description", Update.description);
+        XMLWriter.writeTextElement("Version", Update.version);
+        XMLWriter.writeTextElement("ReleaseDate", Update.releaseDate);
+        if(!Update.dependencies.isEmpty()) {
+            XMLWriter.writeTextElement("Dependencies", Update.dependencies);
+        }
+        XMLWriter.writeTextElement("DownloadableArchives", Update.archive);
+        XMLWriter.writeTextElement("SHA1", Update.metaSha1);
+        XMLWriter.writeEndElement();
+    }
+    XMLWriter.writeEndElement();
+    XMLWriter.writeEndDocument();
+    return (!XMLWriter.hasError() && File.commit());
+}
+
+static QString packageFile(const QString& repo, const QString& name, const QString& version, const QString& file)
+{
+    return repo + "/" + name + "/" + version + file;
+}
+
+// A archive cut short by a crash or touched by hand has another size.
+static bool isPresent(const QString& fileName, qint64 size)
+{
+    const QFileInfo Info(fileName);
+    return (Info.isFile() && Info.size() == size);
+}
+
+/*
+ * The files of a package which were in the repo and are no
+ * longer wanted , the old version or the old format.
+*/
+static void removeStale(const QString& repo, const QString& name, const PackageState& old, const Package *now)
+{
+    const bool sameVersion = (now != NULL && now->version == old.version);
+    if(!sameVersion) {
+        QFile::remove(packageFile(repo, name, old.version, "meta.7z"));
+    }
+    if(!old.archive.isEmpty() && (!sameVersion || now->archive != old.archive)) {
+        QFile::remove(packageFile(repo, name, old.version, old.archive));
+        QFile::remove(packageFile(repo, name, old.version, old.archive + ".sha1"));
+    }
+    if(now == NULL) {
+        QDir().rmdir(repo + "/" + name);
+    }
+    return;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser Parser;
+    Parser.addHelpOption();
+    QCommandLineOption FormatOption("format", "Suffix of the data archives , like .7z or .tar.zst.", "SUFFIX", ".7z");
+    QCommandLineOption JobsOption("jobs", "Archives compressed at once.", "N",
+                                  QString::number(QThread::idealThreadCount()));
+    QCommandLineOption ThreadsOption("threads", "Threads of every archive , see Compressor::setThreads().", "N", "1");
+    QCommandLineOption LevelOption("level", "Compression level , -1 for the default of the format.", "N", "-1");
+    QCommandLineOption ExternalOption("external-filters", "Pipe gzip and bzip2 through pigz and pbzip2 with --threads.");
+    Parser.addOption(FormatOption);
+    Parser.addOption(JobsOption);
+    Parser.addOption(ThreadsOption);
+    Parser.addOption(LevelOption);
+    Parser.addOption(ExternalOption);
+    Parser.addPositionalArgument("packages", "The directory of the packages.");
+    Parser.addPositionalArgument("repo", "The directory of the repo to update.");
+    Parser.process(app);
+
+    if(Parser.positionalArguments().size() != 2) {
+        Parser.showHelp(1);
+    }
+    const QString PackagesDir = QDir(Parser.positionalArguments().at(0)).absolutePath(),
+                  RepoDir = QDir(Parser.positionalArguments().at(1)).absolutePath(),
+                  StateFile = RepoDir + "/.repogen";
+    QString Suffix = Parser.value(FormatOption);
+    if(!Suffix.startsWith(".")) {
+        Suffix.prepend(".");
+    }
+    const int Jobs = qMax(1, Parser.value(JobsOption).toInt()),
+              Threads = qMax(0, Parser.value(ThreadsOption).toInt()),
+              Level = Parser.value(LevelOption).toInt();
+    const bool External = Parser.isSet(ExternalOption);
+    const QByteArray Settings = (Suffix + " " + QString::number(Level)).toUtf8();
+
+    QElapsedTimer Timer;
+    Timer.start();
+    if(!QDir().mkpath(RepoDir)) {
+        out << "Cannot create " << RepoDir << "\n";
+        return 1;
+    }
+
+    QHash<QString, PackageState> OldState;
+    QHash<QString, FileDigest> OldFiles;
+    loadState(StateFile, &OldState, &OldFiles);
+
+    QVector<Package> Packages;
+    QStringList Names = QDir(PackagesDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for(int name = 0; name < Names.size() ; ++name) {
+        Package Update;
+        Update.name = Names.at(name);
+        Update.dir = PackagesDir + "/" + Names.at(name);
+        Packages.push_back(Update);
+    }
+
+    // Stat and hash the trees , all packages at once.
+    QtConcurrent::blockingMap(Packages, [&OldFiles, &Settings](Package &package) {
+        digestPackage(&package, OldFiles, Settings);
+    });
+
+    QVector<Job> Queue;
+    for(int item = 0; item < Packages.size() ; ++item) {
+        Package &Update = Packages[item];
+        if(!Update.failure.isEmpty()) {
+            out << Update.name << " :: " << Update.failure << "\n";
+            return 1;
+        }
+        if(QDir(Update.dir + "/data").exists()) {
+            Update.archive = "content" + Suffix;
+        }
+
+        const PackageState Old = OldState.value(Update.name);
+        const bool Present = isPresent(packageFile(RepoDir, Update.name, Update.version, "meta.7z"), Old.metaSize) &&
+                             (Update.archive.isEmpty() ||
+                              (isPresent(packageFile(RepoDir, Update.name, Update.version, Update.archive),
+                                         Old.archiveSize) &&
+                               QFile::exists(packageFile(RepoDir, Update.name, Update.version, Update.archive + ".sha1"))));
+        if(Present && Old.treeDigest == Update.treeDigest && Old.archive == Update.archive) {
+            Update.metaSha1 = Old.metaSha1;
+            Update.metaSize = Old.metaSize;
+            Update.archiveSize = Old.archiveSize;
+            continue;
+        }
+
+        if(OldState.contains(Update.name)) {
+            removeStale(RepoDir, Update.name, Old, &Update);
+        }
+        QDir().mkpath(RepoDir + "/" + Update.name);
+        Queue.push_back({ item, true });
+        if(!Update.archive.isEmpty()) {
+            Queue.push_back({ item, false });
+        }
+    }
+
+    /*
+     * The Compressors run on their own threads , the event loop here
+     * only starts the next one when a job is done. They are deleted
+     * once the pool is done , a signal comes before their thread ends.
+    */
+    std::vector<std::unique_ptr<QArchive::Compressor>> Workers;
+    int next = 0,
+        running = 0;
+    bool Failed = false;
+    QEventLoop Loop;
+    std::function<void()> startJobs = [&]() {
+        while(!Failed && running < Jobs && next < Queue.size()) {
+            const Job Current = Queue.at(next++);
+            Package *Update = &Packages[Current.package];
+            const QString Source = Update->dir + (Current.meta ? "/meta" : "/data"),
+                          Target = packageFile(RepoDir, Update->name, Update->version,
+                                               Current.meta ? QString("meta.7z") : Update->archive),
+                          // Keeps the suffix , the format follows the name.
+                          Partial = QFileInfo(Target).path() + "/.part-" + QFileInfo(Target).fileName();
+
+            QFile::remove(Partial);
+            auto Worker = new QArchive::Compressor(Partial, Source);
+            Workers.push_back(std::unique_ptr<QArchive::Compressor>(Worker));
+            Worker->setBaseDirectory(Source);
+            if(Current.meta) {
+                Worker->setPathPrefix(Update->name);
+            }
+            Worker->setThreads(Threads);
+            Worker->setCompressionLevel(Level);
+            Worker->setExternalFilters(External);
+            ++running;
+
+            QObject::connect(Worker, &QArchive::Compressor::finished, &Loop, [&, Update, Current, Target, Partial]() {
+                QByteArray Sha1;
+                QFile::remove(Target);
+                if(!QFile::rename(Partial, Target) || !fileSha1(Target, &Sha1)) {
+                    out << "Cannot write " << Target << "\n";
+                    Failed = true;
+                } else if(Current.meta) {
+                    Update->metaSha1 = Sha1.toHex();
+                    Update->metaSize = QFileInfo(Target).size();
+                } else {
+                    Update->archiveSize = QFileInfo(Target).size();
+                    QSaveFile Checksum(Target + ".sha1");
+                    if(!Checksum.open(QIODevice::WriteOnly) || Checksum.write(Sha1.toHex()) < 0 || !Checksum.commit()) {
+                        out << "Cannot write " << Checksum.fileName() << "\n";
+                        Failed = true;
+                    }
+                }
+                --running;
+                startJobs();
+                if(running == 0) {
+                    Loop.quit();
+                }
+            });
+            QObject::connect(Worker, &QArchive::Compressor::error, &Loop, [&, Partial](short code, const QString& what) {
+                out << "Cannot compress " << Partial << " :: " << code << " :: " << what << "\n";
+                Failed = true;
+                QFile::remove(Partial);
+                --running;
+                if(running == 0) {
+                    Loop.quit();
+                }
+            });
+            Worker->start();
+        }
+        return;
+    };
+    startJobs();
+    if(running > 0) {
+        Loop.exec();
+    }
+    QThreadPool::globalInstance()->waitForDone();
+    Workers.clear();
+    if(Failed) {
+        return 1;
+    }
+
+    // Packages which are gone from the packages dir are gone from the repo.
+    QHash<QString, PackageState> NewState;
+    QHash<QString, FileDigest> NewFiles;
+    QSet<QString> Current;
+    for(int item = 0; item < Packages.size() ; ++item) {
+        const Package &Update = Packages.at(item);
+        Current.insert(Update.name);
+        NewState.insert(Update.name, { Update.version, Update.treeDigest, Update.archive, Update.metaSha1,
+                                       Update.metaSize, Update.archiveSize });
+        for(auto File = Update.files.constBegin(); File != Update.files.constEnd() ; ++File) {
+            NewFiles.insert(File.key(), File.value());
+        }
+    }
+    for(auto Old = OldState.constBegin(); Old != OldState.constEnd() ; ++Old) {
+        if(!Current.contains(Old.key())) {
+            removeStale(RepoDir, Old.key(), Old.value(), NULL);
+        }
+    }
+
+    if(!writeUpdatesXml(RepoDir + "/Updates.xml", Packages) || !saveState(StateFile, NewState, NewFiles)) {
+        out << "Cannot write " << RepoDir << "/Updates.xml\n";
+        return 1;
+    }
+
+    int Rebuilt = 0;
+    for(int job = 0; job < Queue.size() ; ++job) {
+        Rebuilt += Queue.at(job).meta ? 1 : 0;
+    }
+    out << "packages: " << Packages.size() << " , rebuilt: " << Rebuilt
+        << " , seconds: " << Timer.elapsed() / 1000.0 << "\n";
+    return 0;
+}
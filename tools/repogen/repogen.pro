@@ -0,0 +1,7 @@
+TEMPLATE=app
+TARGET=repogen
+CONFIG += console
+LIBS += -larchive
+QT+=core concurrent
+SOURCES += main.cpp
+HEADERS += ../../QArchive/QArchive.hpp